@@ -106,6 +106,9 @@ int main (int argc, char *argv[])
   Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper>
   (expName + ".routes", std::ios::out);
   d.PrintRoutingTableAllAt (Seconds (0), routingStream);
+  Ptr<OutputStreamWrapper> statsStream = Create<OutputStreamWrapper>
+  (expName + ".stats", std::ios::out);
+  Ipv4DSRRoutingHelper::PrintForwardingStatsAllAt (Seconds (20), statsStream);
 
   Simulator::Stop(Seconds(20));
   Simulator::Run();
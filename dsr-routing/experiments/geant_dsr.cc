@@ -187,6 +187,10 @@ int main (int argc, char *argv[])
   // ------------------------------------------------------------
   // -- Run the simulation
   // --------------------------------------------
+  Ptr<OutputStreamWrapper> statsStream = Create<OutputStreamWrapper>
+  (dir + ExpName + ".stats", std::ios::out);
+  Ipv4DSRRoutingHelper::PrintForwardingStatsAllAt (Seconds (20), statsStream);
+
   NS_LOG_INFO ("Run Simulation.");
   Simulator::Run ();
   Simulator::Destroy ();
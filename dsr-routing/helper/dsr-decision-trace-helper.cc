@@ -0,0 +1,199 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/callback.h"
+#include "ns3/node.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/dsr-router-interface.h"
+#include "ns3/ipv4-dsr-routing.h"
+#include "dsr-decision-trace-helper.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DsrDecisionTraceHelper");
+
+namespace {
+
+/**
+ * \brief Buffered writer of forwarding decisions, kept alive by the trace
+ * callbacks connected to it.
+ */
+class DecisionWriter : public SimpleRefCount<DecisionWriter>
+{
+public:
+  DecisionWriter (std::string filename, DsrDecisionTraceHelper::Format format, uint32_t bufferSize)
+    : m_format (format),
+      m_buffer (bufferSize)
+  {
+    if (bufferSize > 0)
+      {
+        m_os.rdbuf ()->pubsetbuf (&m_buffer[0], m_buffer.size ());
+      }
+    std::ios::openmode mode = std::ios::out | std::ios::trunc;
+    if (format == DsrDecisionTraceHelper::BINARY)
+      {
+        mode |= std::ios::binary;
+      }
+    m_os.open (filename.c_str (), mode);
+    NS_ABORT_MSG_UNLESS (m_os.is_open (), "DsrDecisionTraceHelper: cannot open " << filename);
+    if (format == DsrDecisionTraceHelper::CSV)
+      {
+        m_os << "time,node,destination,size,budget,flag,drop,cached,gateway,interface,lane,"
+             << "routes,fine,candidates,gateway:interface:distance";
+        for (uint32_t k = 0; k < DsrForwardingDecision::MAX_LANES; k++)
+          {
+            m_os << ":q" << k;
+          }
+        for (uint32_t k = 0; k < DsrForwardingDecision::MAX_LANES; k++)
+          {
+            m_os << ":w" << k;
+          }
+        m_os << '\n';
+      }
+  }
+
+  /**
+   * \brief Trace sink of the "ForwardingDecision" source.
+   * \param d the decision
+   */
+  void Write (const DsrForwardingDecision &d)
+  {
+    if (m_format == DsrDecisionTraceHelper::BINARY)
+      {
+        WriteBinary (d);
+        return;
+      }
+    m_os << d.time << ',' << d.node << ',' << Ipv4Address (d.destination) << ','
+         << d.packetSize << ',' << d.budget << ',' << uint32_t (d.flag) << ','
+         << uint32_t (d.dropReason) << ',' << uint32_t (d.fromFlowCache) << ','
+         << Ipv4Address (d.gateway) << ',' << d.interface << ',' << uint32_t (d.lane) << ','
+         << d.nRoutes << ',' << d.nFineRoutes << ',' << d.nCandidates << ',';
+    uint32_t n = std::min (d.nCandidates, DsrForwardingDecision::MAX_CANDIDATES);
+    for (uint32_t i = 0; i < n; i++)
+      {
+        const DsrForwardingDecision::Candidate &c = d.candidates[i];
+        m_os << (i == 0 ? "" : "|") << Ipv4Address (c.gateway) << ':' << c.interface << ':'
+             << c.distance;
+        for (uint32_t k = 0; k < DsrForwardingDecision::MAX_LANES; k++)
+          {
+            m_os << ':' << c.queueLength[k];
+          }
+        for (uint32_t k = 0; k < DsrForwardingDecision::MAX_LANES; k++)
+          {
+            m_os << ':' << c.weight[k];
+          }
+      }
+    m_os << '\n';
+  }
+
+private:
+  /**
+   * \brief Write a decision in the binary format of DsrDecisionTraceHelper.
+   * \param d the decision
+   */
+  void WriteBinary (const DsrForwardingDecision &d)
+  {
+    WriteLittleEndian (d.time, 8);
+    WriteLittleEndian (d.node, 4);
+    WriteLittleEndian (d.destination, 4);
+    WriteLittleEndian (d.packetSize, 4);
+    WriteLittleEndian (d.budget, 4);
+    WriteLittleEndian (d.flag, 1);
+    WriteLittleEndian (d.dropReason, 1);
+    WriteLittleEndian (d.fromFlowCache, 1);
+    WriteLittleEndian (d.lane, 1);
+    WriteLittleEndian (d.gateway, 4);
+    WriteLittleEndian (d.interface, 4);
+    WriteLittleEndian (d.nRoutes, 4);
+    WriteLittleEndian (d.nFineRoutes, 4);
+    WriteLittleEndian (d.nCandidates, 4);
+    // the candidates past nCandidates are left over from earlier decisions
+    static const DsrForwardingDecision::Candidate none = DsrForwardingDecision::Candidate ();
+    uint32_t n = std::min (d.nCandidates, DsrForwardingDecision::MAX_CANDIDATES);
+    for (uint32_t i = 0; i < DsrForwardingDecision::MAX_CANDIDATES; i++)
+      {
+        const DsrForwardingDecision::Candidate &c = i < n ? d.candidates[i] : none;
+        WriteLittleEndian (c.gateway, 4);
+        WriteLittleEndian (c.interface, 4);
+        WriteLittleEndian (c.distance, 4);
+        for (uint32_t k = 0; k < DsrForwardingDecision::MAX_LANES; k++)
+          {
+            WriteLittleEndian (c.queueLength[k], 4);
+          }
+        for (uint32_t k = 0; k < DsrForwardingDecision::MAX_LANES; k++)
+          {
+            uint64_t bits;
+            std::memcpy (&bits, &c.weight[k], sizeof (bits));
+            WriteLittleEndian (bits, 8);
+          }
+      }
+  }
+
+  /**
+   * \brief Write the low bytes of a value, least significant first.
+   * \param value the value
+   * \param size the number of bytes
+   */
+  void WriteLittleEndian (uint64_t value, uint32_t size)
+  {
+    for (uint32_t i = 0; i < size; i++)
+      {
+        m_os.put (static_cast<char> (value >> (8 * i)));
+      }
+  }
+
+  DsrDecisionTraceHelper::Format m_format; //!< file format
+  std::vector<char> m_buffer;              //!< stream buffer, declared before the stream
+  std::ofstream m_os;                      //!< output stream
+};
+
+} // anonymous namespace
+
+DsrDecisionTraceHelper::DsrDecisionTraceHelper ()
+  : m_format (CSV),
+    m_bufferSize (1 << 20)
+{
+}
+
+void
+DsrDecisionTraceHelper::SetFormat (Format format)
+{
+  m_format = format;
+}
+
+void
+DsrDecisionTraceHelper::SetBufferSize (uint32_t size)
+{
+  m_bufferSize = size;
+}
+
+void
+DsrDecisionTraceHelper::EnableDecisionTrace (std::string filename, NodeContainer nodes) const
+{
+  Ptr<DecisionWriter> writer = Create<DecisionWriter> (filename, m_format, m_bufferSize);
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+    {
+      Ptr<DSRRouter> router = (*i)->GetObject<DSRRouter> ();
+      if (router == 0 || router->GetRoutingProtocol () == 0)
+        {
+          NS_LOG_LOGIC ("Node " << (*i)->GetId () << " does not run DSR routing");
+          continue;
+        }
+      router->GetRoutingProtocol ()->TraceConnectWithoutContext ("ForwardingDecision",
+                                                                 MakeCallback (&DecisionWriter::Write, writer));
+    }
+}
+
+void
+DsrDecisionTraceHelper::EnableDecisionTraceAll (std::string filename) const
+{
+  EnableDecisionTrace (filename, NodeContainer::GetGlobal ());
+}
+
+} // namespace ns3
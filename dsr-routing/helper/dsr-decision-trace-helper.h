@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef DSR_DECISION_TRACE_HELPER_H
+#define DSR_DECISION_TRACE_HELPER_H
+
+#include <string>
+#include "ns3/node-container.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup dsr
+ * \brief A helper writing the "ForwardingDecision" trace of the DSR routing
+ * protocol of a set of nodes to a file.
+ *
+ * All the nodes enabled by one call share one buffered output stream, which
+ * is flushed when the routing protocols are disposed at the end of the
+ * simulation.  The CSV format has one line per decision.
+ *
+ * The binary format is a sequence of records of 528 bytes, one per
+ * decision, written field by field in little-endian byte order without
+ * padding: time (8 bytes), node, destination, size and budget (4 bytes
+ * each), flag, drop reason, flow cache and lane (1 byte each), gateway,
+ * interface, routes, fine routes and candidates (4 bytes each), then
+ * DsrForwardingDecision::MAX_CANDIDATES candidates of gateway, interface,
+ * distance and DsrForwardingDecision::MAX_LANES queue lengths (4 bytes
+ * each), followed by MAX_LANES weights (IEEE 754 doubles, 8 bytes each).
+ * The candidates past the number of candidates are zero.
+ */
+class DsrDecisionTraceHelper
+{
+public:
+  /// output file format
+  enum Format
+  {
+    CSV,
+    BINARY
+  };
+
+  DsrDecisionTraceHelper ();
+
+  /**
+   * \param format the format of the files opened by the next Enable calls
+   */
+  void SetFormat (Format format);
+
+  /**
+   * \param size the size, in bytes, of the output buffer of the next files
+   */
+  void SetBufferSize (uint32_t size);
+
+  /**
+   * \brief Write the forwarding decisions of some nodes to a file.
+   * \param filename the output file, truncated if it exists
+   * \param nodes the nodes; those without DSR routing are skipped
+   */
+  void EnableDecisionTrace (std::string filename, NodeContainer nodes) const;
+
+  /**
+   * \brief Write the forwarding decisions of every node to a file.
+   * \param filename the output file, truncated if it exists
+   */
+  void EnableDecisionTraceAll (std::string filename) const;
+
+private:
+  Format m_format;       //!< file format
+  uint32_t m_bufferSize; //!< output buffer size, in bytes
+};
+
+} // namespace ns3
+
+#endif /* DSR_DECISION_TRACE_HELPER_H */
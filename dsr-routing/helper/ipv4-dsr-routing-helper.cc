@@ -21,6 +21,8 @@
 #include "ns3/dsr-router-interface.h"
 #include "ns3/ipv4-dsr-routing.h"
 #include "ns3/ipv4-list-routing.h"
+#include "ns3/node-list.h"
+#include "ns3/simulator.h"
 #include "ns3/log.h"
 
 namespace ns3 {
@@ -71,5 +73,24 @@ Ipv4DSRRoutingHelper::RecomputeRoutingTables (void)
   DSRRouteManager::InitializeRoutes ();
 }
 
+void
+Ipv4DSRRoutingHelper::PrintForwardingStatsAllAt (Time printTime, Ptr<OutputStreamWrapper> stream)
+{
+  Simulator::Schedule (printTime, &Ipv4DSRRoutingHelper::PrintForwardingStatsAll, stream);
+}
+
+void
+Ipv4DSRRoutingHelper::PrintForwardingStatsAll (Ptr<OutputStreamWrapper> stream)
+{
+  for (uint32_t i = 0; i < NodeList::GetNNodes (); i++)
+    {
+      Ptr<DSRRouter> router = NodeList::GetNode (i)->GetObject<DSRRouter> ();
+      if (router != 0 && router->GetRoutingProtocol () != 0)
+        {
+          router->GetRoutingProtocol ()->PrintForwardingStats (stream);
+        }
+    }
+}
+
 
 } // namespace ns3
@@ -22,6 +22,8 @@
 
 #include "ns3/node-container.h"
 #include "ns3/ipv4-routing-helper.h"
+#include "ns3/nstime.h"
+#include "ns3/output-stream-wrapper.h"
 
 namespace ns3 {
 
@@ -84,7 +86,25 @@ public:
    *
    */
   static void RecomputeRoutingTables (void);
+
+  /**
+   * \brief Print the forwarding statistics of every node at a particular
+   * time.
+   *
+   * The statistics are the counters and histograms kept by each
+   * Ipv4DSRRouting: drops by reason, candidate routes per lookup, lane
+   * selections and sampled lookup latency.
+   *
+   * \param printTime the time at which the statistics are printed
+   * \param stream the output stream object to use
+   */
+  static void PrintForwardingStatsAllAt (Time printTime, Ptr<OutputStreamWrapper> stream);
 private:
+  /**
+   * \brief Print the forwarding statistics of every node.
+   * \param stream the output stream object to use
+   */
+  static void PrintForwardingStatsAll (Ptr<OutputStreamWrapper> stream);
   /**
    * \brief Assignment operator declared private and not implemented to disallow
    * assignment and prevent the compiler from happily inserting its own.
@@ -49,12 +49,17 @@ operator<< (std::ostream& os, const DSRVertex::VertexType& t)
 std::ostream& 
 operator<< (std::ostream& os, const DsrCandidateQueue& q)
 {
-  typedef DsrCandidateQueue::DsrCandidateList_t List_t;
-  typedef List_t::const_iterator CIter_t;
-  const DsrCandidateQueue::DsrCandidateList_t& list = q.m_candidates;
+  // print in priority order, not in heap order
+  std::vector<DSRVertex *> list;
+  list.reserve (q.m_candidates.size ());
+  for (uint32_t i = 0; i < q.m_candidates.size (); i++)
+    {
+      list.push_back (q.m_candidates[i].vertex);
+    }
+  std::stable_sort (list.begin (), list.end (), &DsrCandidateQueue::CompareDSRVertex);
 
   os << "*** CandidateQueue Begin (<id, distance, LSA-type>) ***" << std::endl;
-  for (CIter_t iter = list.begin (); iter != list.end (); iter++)
+  for (std::vector<DSRVertex *>::const_iterator iter = list.begin (); iter != list.end (); iter++)
     {
       os << "<" 
       << (*iter)->GetVertexId () << ", "
@@ -66,7 +71,9 @@ operator<< (std::ostream& os, const DsrCandidateQueue& q)
 }
 
 DsrCandidateQueue::DsrCandidateQueue()
-  : m_candidates ()
+  : m_candidates (),
+    m_index (),
+    m_sequence (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -81,24 +88,28 @@ void
 DsrCandidateQueue::Clear (void)
 {
   NS_LOG_FUNCTION (this);
-  while (!m_candidates.empty ())
+  for (DsrCandidateHeap_t::iterator i = m_candidates.begin (); i != m_candidates.end (); i++)
     {
-      DSRVertex *p = Pop ();
-      delete p;
-      p = 0;
+      delete i->vertex;
     }
+  m_candidates.clear ();
+  m_index.clear ();
+  m_sequence = 0;
 }
 
 void
 DsrCandidateQueue::Push (DSRVertex *vNew)
 {
   NS_LOG_FUNCTION (this << vNew);
+  NS_ASSERT_MSG (m_index.find (vNew->GetVertexId ().Get ()) == m_index.end (),
+                 "DsrCandidateQueue::Push (): vertex " << vNew->GetVertexId () << " already queued");
 
-  DsrCandidateList_t::iterator i = std::upper_bound (
-      m_candidates.begin (), m_candidates.end (), vNew,
-      &DsrCandidateQueue::CompareDSRVertex
-      );
-  m_candidates.insert (i, vNew);
+  Entry e;
+  e.vertex = vNew;
+  e.sequence = m_sequence++;
+  m_candidates.push_back (e);
+  m_index[vNew->GetVertexId ().Get ()] = m_candidates.size () - 1;
+  SiftUp (m_candidates.size () - 1);
 }
 
 DSRVertex *
@@ -110,8 +121,15 @@ DsrCandidateQueue::Pop (void)
       return 0;
     }
 
-  DSRVertex *v = m_candidates.front ();
-  m_candidates.pop_front ();
+  DSRVertex *v = m_candidates.front ().vertex;
+  m_index.erase (v->GetVertexId ().Get ());
+  Entry last = m_candidates.back ();
+  m_candidates.pop_back ();
+  if (!m_candidates.empty ())
+    {
+      Place (0, last);
+      SiftDown (0);
+    }
   return v;
 }
 
@@ -124,7 +142,7 @@ DsrCandidateQueue::Top (void) const
       return 0;
     }
 
-  return m_candidates.front ();
+  return m_candidates.front ().vertex;
 }
 
 bool
@@ -145,18 +163,24 @@ DSRVertex *
 DsrCandidateQueue::Find (const Ipv4Address addr) const
 {
   NS_LOG_FUNCTION (this);
-  DsrCandidateList_t::const_iterator i = m_candidates.begin ();
-
-  for (; i != m_candidates.end (); i++)
+  DsrCandidateIndex_t::const_iterator i = m_index.find (addr.Get ());
+  if (i == m_index.end ())
     {
-      DSRVertex *v = *i;
-      if (v->GetVertexId () == addr)
-        {
-          return v;
-        }
+      return 0;
     }
+  return m_candidates[i->second].vertex;
+}
 
-  return 0;
+void
+DsrCandidateQueue::DecreaseKey (DSRVertex *v)
+{
+  NS_LOG_FUNCTION (this << v);
+  DsrCandidateIndex_t::const_iterator i = m_index.find (v->GetVertexId ().Get ());
+  NS_ASSERT_MSG (i != m_index.end () && m_candidates[i->second].vertex == v,
+                 "DsrCandidateQueue::DecreaseKey (): vertex " << v->GetVertexId () << " not queued");
+  // rank it after its new peers, as a stable re-sort of a sorted list would
+  m_candidates[i->second].sequence = m_sequence++;
+  SiftUp (i->second);
 }
 
 void
@@ -164,11 +188,84 @@ DsrCandidateQueue::Reorder (void)
 {
   NS_LOG_FUNCTION (this);
 
-  m_candidates.sort (&DsrCandidateQueue::CompareDSRVertex);
+  for (uint32_t slot = m_candidates.size (); slot-- > 0; )
+    {
+      SiftDown (slot);
+    }
   NS_LOG_LOGIC ("After reordering the CandidateQueue");
   NS_LOG_LOGIC (*this);
 }
 
+bool
+DsrCandidateQueue::Before (uint32_t a, uint32_t b) const
+{
+  const Entry &ea = m_candidates[a];
+  const Entry &eb = m_candidates[b];
+  if (CompareDSRVertex (ea.vertex, eb.vertex))
+    {
+      return true;
+    }
+  if (CompareDSRVertex (eb.vertex, ea.vertex))
+    {
+      return false;
+    }
+  return ea.sequence < eb.sequence;
+}
+
+void
+DsrCandidateQueue::Place (uint32_t slot, const Entry &e)
+{
+  m_candidates[slot] = e;
+  m_index[e.vertex->GetVertexId ().Get ()] = slot;
+}
+
+void
+DsrCandidateQueue::SiftUp (uint32_t slot)
+{
+  while (slot > 0)
+    {
+      uint32_t parent = (slot - 1) / 4;
+      if (!Before (slot, parent))
+        {
+          break;
+        }
+      Entry e = m_candidates[slot];
+      Place (slot, m_candidates[parent]);
+      Place (parent, e);
+      slot = parent;
+    }
+}
+
+void
+DsrCandidateQueue::SiftDown (uint32_t slot)
+{
+  uint32_t n = m_candidates.size ();
+  while (true)
+    {
+      uint32_t first = 4 * slot + 1;
+      if (first >= n)
+        {
+          break;
+        }
+      uint32_t best = first;
+      for (uint32_t child = first + 1; child < first + 4 && child < n; child++)
+        {
+          if (Before (child, best))
+            {
+              best = child;
+            }
+        }
+      if (!Before (best, slot))
+        {
+          break;
+        }
+      Entry e = m_candidates[slot];
+      Place (slot, m_candidates[best]);
+      Place (best, e);
+      slot = best;
+    }
+}
+
 /*
  * In this implementation, DSRVertex follows the ordering where
  * a vertex is ranked first if its GetDistanceFromRoot () is smaller;
@@ -22,7 +22,8 @@
 #define DSR_CANDIDATE_QUEUE_H
 
 #include <stdint.h>
-#include <list>
+#include <vector>
+#include <unordered_map>
 #include "ns3/ipv4-address.h"
 
 namespace ns3 {
@@ -45,8 +46,13 @@ class DSRVertex;
  *
  * Although a STL priority_queue almost does what we want, the requirement
  * for a Find () operation, the dynamic nature of the data and the derived
- * requirement for a Reorder () operation led us to implement this simple 
+ * requirement for a DecreaseKey () operation led us to implement this
  * enhanced priority queue.
+ *
+ * The queue is an indexed 4-ary heap: Push, Pop and DecreaseKey cost
+ * O(log n) and Find costs one hash lookup.  Vertices of equal rank leave
+ * the queue in the order they were pushed, as with the sorted list this
+ * heap replaces, so the SPF results do not depend on the container.
  */
 class DsrCandidateQueue
 {
@@ -139,6 +145,18 @@ public:
  */
   DSRVertex* Find (const Ipv4Address addr) const;
 
+/**
+ * @brief Restore the priority of a vertex whose m_distanceFromRoot has
+ * just been lowered.
+ *
+ * The vertex ranks after the queued vertices of equal distance and type,
+ * as if it had just been pushed.
+ *
+ * @see DSRVertex
+ * @param v The vertex, which must be in the queue.
+ */
+  void DecreaseKey (DSRVertex *v);
+
 /**
  * @brief Reorders the Candidate Queue according to the priority scheme.
  * 
@@ -148,7 +166,8 @@ public:
  * increasing distance.
  *
  * This method is provided in case the values of m_distanceFromRoot change
- * during the routing calculations.
+ * during the routing calculations.  It rebuilds the whole heap; prefer
+ * DecreaseKey () when a single vertex changed.
  *
  * @see DSRVertex
  */
@@ -184,8 +203,42 @@ private:
  */
   static bool CompareDSRVertex (const DSRVertex* v1, const DSRVertex* v2);
 
-  typedef std::list<DSRVertex*> DsrCandidateList_t; //!< container of DSRVertex pointers
-  DsrCandidateList_t m_candidates;  //!< DSRVertex candidates
+  /// a heap slot: a vertex and its insertion rank
+  struct Entry
+  {
+    DSRVertex *vertex;  //!< the vertex
+    uint64_t sequence;  //!< insertion rank, breaking the ties of CompareDSRVertex
+  };
+
+  /**
+   * \param a first slot
+   * \param b second slot
+   * \return true if the vertex of slot a must be popped before that of slot b
+   */
+  bool Before (uint32_t a, uint32_t b) const;
+  /**
+   * \brief Store an entry in a slot and index it.
+   * \param slot the slot
+   * \param e the entry
+   */
+  void Place (uint32_t slot, const Entry &e);
+  /**
+   * \brief Move the entry of a slot towards the root until the heap holds.
+   * \param slot the slot
+   */
+  void SiftUp (uint32_t slot);
+  /**
+   * \brief Move the entry of a slot towards the leaves until the heap holds.
+   * \param slot the slot
+   */
+  void SiftDown (uint32_t slot);
+
+  typedef std::vector<Entry> DsrCandidateHeap_t; //!< container of heap slots
+  typedef std::unordered_map<uint32_t, uint32_t> DsrCandidateIndex_t; //!< vertex address to slot
+
+  DsrCandidateHeap_t m_candidates;  //!< DSRVertex candidates, as a 4-ary heap
+  DsrCandidateIndex_t m_index;      //!< slot of every candidate, by vertex address
+  uint64_t m_sequence;              //!< insertion rank of the next pushed vertex
 
   /**
    * \brief Stream insertion operator.
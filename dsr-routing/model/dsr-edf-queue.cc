@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+#include <algorithm>
+#include <limits>
+#include "ns3/log.h"
+#include "ns3/queue-size.h"
+#include "dsr-edf-queue.h"
+#include "dsr-meta-tag.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DsrEdfQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (DsrEdfQueue);
+
+TypeId
+DsrEdfQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DsrEdfQueue")
+    .SetParent<Queue<QueueDiscItem> > ()
+    .SetGroupName ("DsrRouting")
+    .AddConstructor<DsrEdfQueue> ()
+    .AddAttribute ("MaxSize",
+                   "The max queue size",
+                   QueueSizeValue (QueueSize ("100p")),
+                   MakeQueueSizeAccessor (&QueueBase::SetMaxSize,
+                                          &QueueBase::GetMaxSize),
+                   MakeQueueSizeChecker ())
+  ;
+  return tid;
+}
+
+DsrEdfQueue::DsrEdfQueue ()
+  : m_sequence (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DsrEdfQueue::~DsrEdfQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+int64_t
+DsrEdfQueue::GetDeadline (Ptr<const QueueDiscItem> item)
+{
+  DsrMetaTag metaTag;
+  if (!metaTag.PeekFrom (item->GetPacket ()))
+    {
+      return std::numeric_limits<int64_t>::max ();
+    }
+  return metaTag.GetTimestamp ().GetMicroSeconds () + metaTag.GetBudget ();
+}
+
+bool
+DsrEdfQueue::Enqueue (Ptr<QueueDiscItem> item)
+{
+  NS_LOG_FUNCTION (this << item);
+  if (!DoEnqueue (end (), item))
+    {
+      return false;
+    }
+  Entry entry;
+  entry.deadline = GetDeadline (item);
+  entry.sequence = m_sequence++;
+  entry.pos = end ();
+  --entry.pos;
+  m_heap.push_back (entry);
+  std::push_heap (m_heap.begin (), m_heap.end (), Later ());
+  NS_LOG_LOGIC ("Queued with deadline " << entry.deadline << ", " << m_heap.size () << " packets");
+  return true;
+}
+
+DsrEdfQueue::ConstIterator
+DsrEdfQueue::PopEarliest (void)
+{
+  NS_ASSERT (!m_heap.empty ());
+  std::pop_heap (m_heap.begin (), m_heap.end (), Later ());
+  ConstIterator pos = m_heap.back ().pos;
+  m_heap.pop_back ();
+  return pos;
+}
+
+Ptr<QueueDiscItem>
+DsrEdfQueue::Dequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_heap.empty ())
+    {
+      NS_LOG_LOGIC ("Queue empty");
+      return 0;
+    }
+  return DoDequeue (PopEarliest ());
+}
+
+Ptr<QueueDiscItem>
+DsrEdfQueue::Remove (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_heap.empty ())
+    {
+      NS_LOG_LOGIC ("Queue empty");
+      return 0;
+    }
+  return DoRemove (PopEarliest ());
+}
+
+Ptr<const QueueDiscItem>
+DsrEdfQueue::Peek (void) const
+{
+  NS_LOG_FUNCTION (this);
+  if (m_heap.empty ())
+    {
+      return 0;
+    }
+  return DoPeek (m_heap.front ().pos);
+}
+
+void
+DsrEdfQueue::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  // the base class clears the list the heap points into
+  m_heap.clear ();
+  Queue<QueueDiscItem>::DoDispose ();
+}
+
+} // namespace ns3
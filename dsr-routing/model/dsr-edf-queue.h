@@ -0,0 +1,110 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef DSR_EDF_QUEUE_H
+#define DSR_EDF_QUEUE_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/queue.h"
+#include "ns3/queue-item.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup dsr
+ *
+ * \brief A queue of QueueDiscItems served in earliest-deadline-first order.
+ *
+ * The deadline of a packet is the send time plus the delay budget of its
+ * DSR metadata (DsrMetaTag, or the legacy TimestampTag and BudgetTag).
+ * Packets without metadata come after every packet with a deadline.
+ * Packets with the same deadline leave in arrival order.
+ *
+ * The packets stay in the list of the Queue base class, so the size,
+ * accounting and trace sources are those of any other queue.  A binary
+ * heap of positions in that list picks the next packet.  Enqueue and
+ * Dequeue therefore cost O(log n).  The heap never holds more entries
+ * than the queue holds packets, and "MaxSize" bounds that number.
+ *
+ * Usable as the internal queue of a lane of DsrVirtualQueueDisc; see its
+ * "EdfLane" attribute.
+ */
+class DsrEdfQueue : public Queue<QueueDiscItem>
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  DsrEdfQueue ();
+  virtual ~DsrEdfQueue ();
+
+  virtual bool Enqueue (Ptr<QueueDiscItem> item);
+  virtual Ptr<QueueDiscItem> Dequeue (void);
+  virtual Ptr<QueueDiscItem> Remove (void);
+  virtual Ptr<const QueueDiscItem> Peek (void) const;
+
+  /**
+   * \brief Compute the deadline of a packet.
+   * \param item the packet
+   * \return the deadline in microseconds, or the largest int64_t value if
+   * the packet carries no DSR metadata
+   */
+  static int64_t GetDeadline (Ptr<const QueueDiscItem> item);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// a queued packet, in the heap
+  struct Entry
+  {
+    int64_t deadline;   //!< deadline, in microseconds
+    uint64_t sequence;  //!< arrival order, breaking ties
+    ConstIterator pos;  //!< position of the packet in the list
+  };
+
+  /// orders the heap so that its front is the earliest deadline
+  struct Later
+  {
+    /**
+     * \param a an entry
+     * \param b an entry
+     * \return true if a leaves after b
+     */
+    bool operator() (const Entry &a, const Entry &b) const
+    {
+      return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+    }
+  };
+
+  /**
+   * \brief Take the earliest deadline off the heap.
+   * \return the position of its packet in the list
+   */
+  ConstIterator PopEarliest (void);
+
+  std::vector<Entry> m_heap;  //!< the queued packets, earliest deadline first
+  uint64_t m_sequence;        //!< arrivals so far
+};
+
+} // namespace ns3
+
+#endif /* DSR_EDF_QUEUE_H */
@@ -0,0 +1,230 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include <iostream>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/global-value.h"
+#include "ns3/boolean.h"
+
+#include "dsr-meta-tag.h"
+#include "timestamp-tag.h"
+#include "budget-tag.h"
+#include "flag-tag.h"
+#include "priority-tag.h"
+
+namespace ns3 {
+
+static GlobalValue g_dsrLegacyPacketTags ("DsrLegacyPacketTags",
+                                          "Set to true to tag DSR packets with the separate TimestampTag, "
+                                          "BudgetTag, FlagTag and PriorityTag instead of one DsrMetaTag",
+                                          BooleanValue (false),
+                                          MakeBooleanChecker ());
+
+//----------------------------------------------------------------------
+//-- DsrMetaTag
+//------------------------------------------------------
+TypeId
+DsrMetaTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("DsrMetaTag")
+    .SetParent<Tag> ()
+    .AddConstructor<DsrMetaTag> ()
+    .AddAttribute ("Timestamp",
+                   "The time the packet was sent",
+                   EmptyAttributeValue (),
+                   MakeTimeAccessor (&DsrMetaTag::GetTimestamp),
+                   MakeTimeChecker ())
+    .AddAttribute ("Budget",
+                   "The delay budget of the packet in microseconds",
+                   EmptyAttributeValue (),
+                   MakeUintegerAccessor (&DsrMetaTag::GetBudget),
+                   MakeUintegerChecker <uint32_t> ())
+    .AddAttribute ("Lane",
+                   "The lane of the packet",
+                   EmptyAttributeValue (),
+                   MakeUintegerAccessor (&DsrMetaTag::GetLane),
+                   MakeUintegerChecker <uint32_t> ())
+  ;
+  return tid;
+}
+
+TypeId
+DsrMetaTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+DsrMetaTag::DsrMetaTag ()
+  : m_timestamp (0),
+    m_budget (0),
+    m_flag (false),
+    m_lane (99),
+    m_legacy (false)
+{
+}
+
+uint32_t
+DsrMetaTag::GetSerializedSize (void) const
+{
+  return 14;    // 8 + 4 + 1 + 1 bytes
+}
+
+void
+DsrMetaTag::Serialize (TagBuffer i) const
+{
+  i.WriteU64 (static_cast<uint64_t> (m_timestamp.GetNanoSeconds ()));
+  i.WriteU32 (m_budget);
+  i.WriteU8 (m_flag ? 1 : 0);
+  i.WriteU8 (m_lane);
+}
+
+void
+DsrMetaTag::Deserialize (TagBuffer i)
+{
+  m_timestamp = NanoSeconds (static_cast<int64_t> (i.ReadU64 ()));
+  m_budget = i.ReadU32 ();
+  m_flag = i.ReadU8 () != 0;
+  m_lane = i.ReadU8 ();
+  m_legacy = false;
+}
+
+void
+DsrMetaTag::Print (std::ostream &os) const
+{
+  os << "t=" << m_timestamp << " budget=" << m_budget
+     << " flag=" << m_flag << " lane=" << static_cast<uint32_t> (m_lane);
+}
+
+void
+DsrMetaTag::SetTimestamp (Time time)
+{
+  m_timestamp = time;
+}
+
+Time
+DsrMetaTag::GetTimestamp (void) const
+{
+  return m_timestamp;
+}
+
+void
+DsrMetaTag::SetBudget (uint32_t budget)
+{
+  m_budget = budget;
+}
+
+uint32_t
+DsrMetaTag::GetBudget (void) const
+{
+  return m_budget;
+}
+
+void
+DsrMetaTag::SetFlag (bool flag)
+{
+  m_flag = flag;
+}
+
+bool
+DsrMetaTag::GetFlag (void) const
+{
+  return m_flag;
+}
+
+void
+DsrMetaTag::SetLane (uint32_t lane)
+{
+  NS_ASSERT (lane <= 0xff);
+  m_lane = static_cast<uint8_t> (lane);
+}
+
+uint32_t
+DsrMetaTag::GetLane (void) const
+{
+  return m_lane;
+}
+
+bool
+DsrMetaTag::PeekFrom (Ptr<const Packet> p)
+{
+  if (p->PeekPacketTag (*this))
+    {
+      return true;
+    }
+
+  // legacy tag set
+  *this = DsrMetaTag ();
+  m_legacy = true;
+  BudgetTag budgetTag;
+  if (!p->PeekPacketTag (budgetTag))
+    {
+      return false;
+    }
+  m_budget = budgetTag.GetBudget ();
+  TimestampTag timestampTag;
+  if (p->PeekPacketTag (timestampTag))
+    {
+      m_timestamp = timestampTag.GetTimestamp ();
+    }
+  FlagTag flagTag;
+  if (p->PeekPacketTag (flagTag))
+    {
+      m_flag = flagTag.GetFlagTag ();
+    }
+  PriorityTag priorityTag;
+  if (p->PeekPacketTag (priorityTag))
+    {
+      SetLane (priorityTag.GetPriority ());
+    }
+  return true;
+}
+
+void
+DsrMetaTag::AddTo (Ptr<const Packet> p, bool legacy) const
+{
+  if (!legacy)
+    {
+      p->AddPacketTag (*this);
+      return;
+    }
+  TimestampTag timestampTag;
+  timestampTag.SetTimestamp (m_timestamp);
+  FlagTag flagTag;
+  flagTag.SetFlagTag (m_flag);
+  BudgetTag budgetTag;
+  budgetTag.SetBudget (m_budget);
+  PriorityTag priorityTag;
+  priorityTag.SetPriority (m_lane);
+  p->AddPacketTag (timestampTag);
+  p->AddPacketTag (flagTag);
+  p->AddPacketTag (budgetTag);
+  p->AddPacketTag (priorityTag);
+}
+
+void
+DsrMetaTag::UpdateLane (Ptr<Packet> p, uint32_t lane)
+{
+  SetLane (lane);
+  if (m_legacy)
+    {
+      PriorityTag priorityTag;
+      p->RemovePacketTag (priorityTag);
+      priorityTag.SetPriority (lane);
+      p->AddPacketTag (priorityTag);
+    }
+  else
+    {
+      p->ReplacePacketTag (*this);
+    }
+}
+
+bool
+DsrMetaTag::UseLegacyTags (void)
+{
+  BooleanValue legacy;
+  g_dsrLegacyPacketTags.GetValue (legacy);
+  return legacy.Get ();
+}
+
+}
@@ -0,0 +1,85 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DSR_META_TAG_H
+#define DSR_META_TAG_H
+
+#include "ns3/core-module.h"
+#include "ns3/nstime.h"
+#include "ns3/tag.h"
+#include "ns3/packet.h"
+
+namespace ns3 {
+
+/**
+ * \brief All the per-packet DSR metadata in one packet tag.
+ *
+ * Replaces the TimestampTag, BudgetTag, FlagTag and PriorityTag set, so a
+ * hop reads the metadata with one PeekPacketTag and updates the lane with
+ * one ReplacePacketTag.  The legacy tags are still understood when a packet
+ * carries them, and the applications write them instead of this tag when
+ * the "DsrLegacyPacketTags" global value is true.
+ */
+class DsrMetaTag : public Tag
+ {
+ public:
+   static TypeId GetTypeId (void);
+   virtual TypeId GetInstanceTypeId (void) const;
+   virtual uint32_t GetSerializedSize (void) const;
+   virtual void Serialize (TagBuffer i) const;
+   virtual void Deserialize (TagBuffer i);
+   virtual void Print (std::ostream &os) const;
+
+   DsrMetaTag ();
+
+   // these are our accessors to our tag structure
+   void SetTimestamp (Time time);
+   Time GetTimestamp (void) const;
+   void SetBudget (uint32_t budget);
+   uint32_t GetBudget (void) const;
+   void SetFlag (bool flag);
+   bool GetFlag (void) const;
+   void SetLane (uint32_t lane);
+   uint32_t GetLane (void) const;
+
+   /**
+    * \brief Read the DSR metadata of a packet.
+    *
+    * Looks for a DsrMetaTag first and falls back to the legacy tags.
+    *
+    * \param p the packet
+    * \return true if the packet carries DSR metadata (a DsrMetaTag or a
+    * BudgetTag)
+    */
+   bool PeekFrom (Ptr<const Packet> p);
+
+   /**
+    * \brief Attach the metadata to a packet, as a DsrMetaTag or as the
+    * four legacy tags.
+    * \param p the packet
+    * \param legacy true to write the legacy tags
+    */
+   void AddTo (Ptr<const Packet> p, bool legacy) const;
+
+   /**
+    * \brief Store a new lane in the packet, in the tag format read by
+    * PeekFrom.
+    * \param p the packet PeekFrom was called on
+    * \param lane the new lane
+    */
+   void UpdateLane (Ptr<Packet> p, uint32_t lane);
+
+   /**
+    * \return the value of the "DsrLegacyPacketTags" global value
+    */
+   static bool UseLegacyTags (void);
+
+ private:
+   Time m_timestamp;  //!< time the packet was sent
+   uint32_t m_budget; //!< delay budget in microseconds
+   bool m_flag;       //!< the packet belongs to the inspected flow
+   uint8_t m_lane;    //!< 0-fast, 1-slow, other-best effort
+   bool m_legacy;     //!< read from the legacy tags, not serialized
+ };
+
+}
+
+#endif /* DSR_META_TAG_H */
@@ -0,0 +1,217 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "dsr-prefix-trie.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DsrPrefixTrie");
+
+const uint32_t DsrPrefixTrie::NO_ID;
+const uint32_t DsrPrefixTrie::MAX_MATCHES;
+
+namespace {
+
+/**
+ * \param len a prefix length
+ * \return the mask with len leading one bits
+ */
+inline uint32_t
+MaskOf (uint8_t len)
+{
+  return len == 0 ? 0 : 0xffffffff << (32 - len);
+}
+
+/**
+ * \param key an address or prefix
+ * \param pos the bit position, 0 being the most significant bit
+ * \return the bit of key at position pos
+ */
+inline uint32_t
+BitAt (uint32_t key, uint8_t pos)
+{
+  return (key >> (31 - pos)) & 1;
+}
+
+/**
+ * \return the length of the prefix shared by (a, aLen) and (b, bLen)
+ */
+inline uint8_t
+CommonLength (uint32_t a, uint8_t aLen, uint32_t b, uint8_t bLen)
+{
+  uint8_t len = std::min (aLen, bLen);
+  uint32_t diff = a ^ b;
+  for (uint8_t i = 0; i < len; i++)
+    {
+      if (BitAt (diff, i))
+        {
+          return i;
+        }
+    }
+  return len;
+}
+
+} // anonymous namespace
+
+DsrPrefixTrie::Node::Node (uint32_t key, uint8_t len)
+  : m_key (key),
+    m_len (len),
+    m_id (NO_ID)
+{
+  m_child[0] = 0;
+  m_child[1] = 0;
+}
+
+DsrPrefixTrie::DsrPrefixTrie ()
+  : m_root (0, 0),
+    m_nPrefixes (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+DsrPrefixTrie::~DsrPrefixTrie ()
+{
+  NS_LOG_FUNCTION (this);
+  Clear ();
+}
+
+uint8_t
+DsrPrefixTrie::PrefixLength (Ipv4Mask mask)
+{
+  uint32_t bits = mask.Get ();
+  uint8_t len = 0;
+  while (len < 32 && BitAt (bits, len))
+    {
+      len++;
+    }
+  NS_ASSERT_MSG (bits == MaskOf (len), "DsrPrefixTrie: non-contiguous mask " << mask);
+  return len;
+}
+
+void
+DsrPrefixTrie::Insert (Ipv4Address network, Ipv4Mask mask, uint32_t id)
+{
+  NS_LOG_FUNCTION (this << network << mask << id);
+  uint8_t len = PrefixLength (mask);
+  uint32_t key = network.Get () & MaskOf (len);
+
+  Node *node = &m_root;
+  while (node->m_len != len)
+    {
+      Node *&slot = node->m_child[BitAt (key, node->m_len)];
+      Node *child = slot;
+      if (child == 0)
+        {
+          slot = new Node (key, len);
+          slot->m_id = id;
+          m_nPrefixes++;
+          return;
+        }
+      uint8_t common = CommonLength (key, len, child->m_key, child->m_len);
+      if (common == child->m_len)
+        {
+          node = child;
+          continue;
+        }
+      // the new prefix diverges inside the compressed path: split it
+      Node *branch = new Node (key & MaskOf (common), common);
+      branch->m_child[BitAt (child->m_key, common)] = child;
+      slot = branch;
+      if (common == len)
+        {
+          branch->m_id = id;
+        }
+      else
+        {
+          Node *leaf = new Node (key, len);
+          leaf->m_id = id;
+          branch->m_child[BitAt (key, common)] = leaf;
+        }
+      m_nPrefixes++;
+      return;
+    }
+  if (node->m_id == NO_ID)
+    {
+      m_nPrefixes++;
+    }
+  node->m_id = id;
+}
+
+void
+DsrPrefixTrie::DeleteSubtree (Node *node)
+{
+  if (node == 0)
+    {
+      return;
+    }
+  DeleteSubtree (node->m_child[0]);
+  DeleteSubtree (node->m_child[1]);
+  delete node;
+}
+
+void
+DsrPrefixTrie::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  DeleteSubtree (m_root.m_child[0]);
+  DeleteSubtree (m_root.m_child[1]);
+  m_root.m_child[0] = 0;
+  m_root.m_child[1] = 0;
+  m_root.m_id = NO_ID;
+  m_nPrefixes = 0;
+}
+
+uint32_t
+DsrPrefixTrie::Lookup (Ipv4Address dest, uint32_t ids[MAX_MATCHES]) const
+{
+  NS_LOG_FUNCTION (this << dest);
+  uint32_t addr = dest.Get ();
+  uint32_t matches[MAX_MATCHES];
+  uint32_t nMatches = 0;
+
+  const Node *node = &m_root;
+  while (node != 0 && (addr & MaskOf (node->m_len)) == node->m_key)
+    {
+      if (node->m_id != NO_ID)
+        {
+          matches[nMatches++] = node->m_id;
+        }
+      if (node->m_len == 32)
+        {
+          break;
+        }
+      node = node->m_child[BitAt (addr, node->m_len)];
+    }
+
+  // longest prefix first
+  for (uint32_t i = 0; i < nMatches; i++)
+    {
+      ids[i] = matches[nMatches - 1 - i];
+    }
+  return nMatches;
+}
+
+uint32_t
+DsrPrefixTrie::GetNPrefixes (void) const
+{
+  return m_nPrefixes;
+}
+
+} // namespace ns3
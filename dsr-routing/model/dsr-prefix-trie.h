@@ -0,0 +1,122 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef DSR_PREFIX_TRIE_H
+#define DSR_PREFIX_TRIE_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup dsr
+ *
+ * \brief Longest prefix match table for DSR network and AS external routes.
+ *
+ * The prefixes are stored in a path-compressed binary trie.  Every trie
+ * node holds the identifier the routing table gave to one exact prefix, so
+ * a lookup returns the identifiers of all the matching prefixes, longest
+ * first, and the routing table can still choose among the equal-cost (and
+ * unequal-cost) routes of each.
+ *
+ * A lookup walks at most 33 nodes whatever the number of stored prefixes.
+ */
+class DsrPrefixTrie
+{
+public:
+  /// identifier of a node holding no prefix
+  static const uint32_t NO_ID = 0xffffffff;
+  /// maximum number of prefixes matching one address
+  static const uint32_t MAX_MATCHES = 33;
+
+  DsrPrefixTrie ();
+  ~DsrPrefixTrie ();
+
+  /**
+   * \brief Insert a prefix.
+   * \param network the network address
+   * \param mask the network mask; it must be contiguous
+   * \param id the identifier of the prefix; a prefix inserted twice keeps
+   * the last one
+   */
+  void Insert (Ipv4Address network, Ipv4Mask mask, uint32_t id);
+
+  /**
+   * \brief Remove every prefix.
+   */
+  void Clear (void);
+
+  /**
+   * \brief Find the prefixes matching a destination.
+   * \param dest the destination address
+   * \param ids the array receiving the identifiers of the matching
+   * prefixes, longest first; it must hold MAX_MATCHES entries
+   * \return the number of matching prefixes
+   */
+  uint32_t Lookup (Ipv4Address dest, uint32_t ids[MAX_MATCHES]) const;
+
+  /**
+   * \return the number of prefixes stored
+   */
+  uint32_t GetNPrefixes (void) const;
+
+private:
+  /**
+   * \brief Copy construction is disallowed (not implemented): the trie owns
+   * its nodes.
+   * \param trie object to copy
+   */
+  DsrPrefixTrie (const DsrPrefixTrie &trie);
+  /**
+   * \brief Assignment is disallowed (not implemented): the trie owns its
+   * nodes.
+   * \param trie object to assign
+   * \return copied object
+   */
+  DsrPrefixTrie &operator= (const DsrPrefixTrie &trie);
+
+  /// a trie node; m_key holds the m_len most significant bits of the prefix
+  struct Node
+  {
+    Node (uint32_t key, uint8_t len);
+    uint32_t m_key;      //!< prefix bits, the remaining bits are zero
+    uint8_t m_len;       //!< prefix length
+    Node *m_child[2];    //!< children, selected by the bit after the prefix
+    uint32_t m_id;       //!< identifier of the prefix, or NO_ID for a branch node
+  };
+
+  /**
+   * \brief Delete a node and its whole subtree.
+   * \param node the node
+   */
+  static void DeleteSubtree (Node *node);
+
+  /**
+   * \param mask a network mask
+   * \return the number of leading one bits in the mask
+   */
+  static uint8_t PrefixLength (Ipv4Mask mask);
+
+  Node m_root;          //!< the zero-length prefix, never removed
+  uint32_t m_nPrefixes; //!< number of prefixes stored
+};
+
+} // Namespace ns3
+
+#endif /* DSR_PREFIX_TRIE_H */
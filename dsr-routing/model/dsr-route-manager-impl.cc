@@ -27,13 +27,21 @@
 #include <queue>
 #include <algorithm>
 #include <iostream>
+#include <thread>
+#include <atomic>
 #include "ns3/assert.h"
 #include "ns3/fatal-error.h"
 #include "ns3/log.h"
 #include "ns3/node-list.h"
+#include "ns3/simulator.h"
+#include "ns3/net-device.h"
+#include "ns3/channel.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/ipv4-list-routing.h"
+#include "ns3/global-value.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
 #include "dsr-router-interface.h"
 #include "dsr-route-manager-impl.h"
 #include "dsr-candidate-queue.h"
@@ -43,6 +51,34 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("DSRRouteManagerImpl");
 
+static GlobalValue g_dsrSpfPerRouter ("DsrSpfPerRouter",
+                                      "Set to true to run one SPF calculation per router and build the "
+                                      "routes through every neighbor from its tree, instead of one SPF "
+                                      "calculation per point-to-point link",
+                                      BooleanValue (false),
+                                      MakeBooleanChecker ());
+
+static GlobalValue g_dsrSpfGraph ("DsrSpfGraph",
+                                  "Set to true to run the SPF calculations over a compressed "
+                                  "snapshot of the LSDB instead of DSRVertex trees; the snapshot "
+                                  "is only used on point-to-point topologies",
+                                  BooleanValue (false),
+                                  MakeBooleanChecker ());
+
+static GlobalValue g_dsrSpfThreads ("DsrSpfThreads",
+                                    "Number of threads computing the SPF trees of the route build, "
+                                    "0 for one per hardware thread; only used with DsrSpfGraph",
+                                    UintegerValue (1),
+                                    MakeUintegerChecker<uint32_t> ());
+
+static GlobalValue g_dsrRouterRoutes ("DsrRouterRoutes",
+                                      "Set to true to install one host route per destination router, "
+                                      "towards its router ID, instead of one per point-to-point "
+                                      "interface address; the addresses of the routers then resolve "
+                                      "to their router ID through a map shared by every router",
+                                      BooleanValue (false),
+                                      MakeBooleanChecker ());
+
 /**
  * \brief Stream insertion operator.
  *
@@ -473,6 +509,16 @@ DSRRouteManagerLSDB::Insert (Ipv4Address addr, DSRRoutingLSA* lsa)
     }
 }
 
+void
+DSRRouteManagerLSDB::Replace (Ipv4Address addr, DSRRoutingLSA* lsa)
+{
+  NS_LOG_FUNCTION (this << addr << lsa);
+  LSDBMap_t::iterator i = m_database.find (addr);
+  NS_ASSERT_MSG (i != m_database.end (), "No LSA for " << addr);
+  delete i->second;
+  i->second = lsa;
+}
+
 DSRRoutingLSA*
 DSRRouteManagerLSDB::GetExtLSA (uint32_t index) const
 {
@@ -494,17 +540,25 @@ DSRRouteManagerLSDB::GetLSA (Ipv4Address addr) const
 //
 // Look up an LSA by its address.
 //
-  LSDBMap_t::const_iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
+  LSDBMap_t::const_iterator i = m_database.find (addr);
+  if (i != m_database.end ())
     {
-      if (i->first == addr)
-        {
-          return i->second;
-        }
+      return i->second;
     }
   return 0;
 }
 
+void
+DSRRouteManagerLSDB::GetLSAs (std::vector<DSRRoutingLSA*> &lsas) const
+{
+  NS_LOG_FUNCTION (this);
+  lsas.reserve (lsas.size () + m_database.size ());
+  for (LSDBMap_t::const_iterator i = m_database.begin (); i != m_database.end (); i++)
+    {
+      lsas.push_back (i->second);
+    }
+}
+
 DSRRoutingLSA*
 DSRRouteManagerLSDB::GetLSAByLinkData (Ipv4Address addr) const
 {
@@ -601,9 +655,20 @@ DSRRouteManagerNSDB::GetNumNetDevices () const
 //
 // ---------------------------------------------------------------------------
 
+DSRRouteManagerImpl::DsrSpfTree::DsrSpfTree ()
+  : stub (false)
+{
+}
+
 DSRRouteManagerImpl::DSRRouteManagerImpl () 
   :
-    m_spfroot (0)
+    m_spfroot (0),
+    m_spfTree (0),
+    m_keepSpfPaths (false),
+    m_routerRoutes (false),
+    m_updateTriggers (0),
+    m_nUpdateTriggers (0),
+    m_nUpdates (0)
 {
   NS_LOG_FUNCTION (this);
   m_lsdb = new DSRRouteManagerLSDB ();
@@ -622,6 +687,11 @@ void
 DSRRouteManagerImpl::DebugUseLsdb (DSRRouteManagerLSDB* lsdb)
 {
   NS_LOG_FUNCTION (this << lsdb);
+  m_spfGraph.Clear ();
+  ClearSpfPaths ();
+  m_addressIndex.clear ();
+  m_routerIndex.clear ();
+  Ipv4DSRRouting::ClearRouterAddresses ();
   if (m_lsdb)
     {
       delete m_lsdb;
@@ -643,19 +713,14 @@ DSRRouteManagerImpl::DeleteDSRRoutes ()
           continue;
         }
       Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
-      uint32_t j = 0;
-      uint32_t nRoutes = gr->GetNRoutes ();
       NS_LOG_LOGIC ("Deleting " << gr->GetNRoutes ()<< " routes from node " << node->GetId ());
-      // Each time we delete route 0, the route index shifts downward
-      // We can delete all routes if we delete the route numbered 0
-      // nRoutes times
-      for (j = 0; j < nRoutes; j++)
-        {
-          NS_LOG_LOGIC ("Deleting global route " << j << " from node " << node->GetId ());
-          gr->RemoveRoute (0);
-        }
-      NS_LOG_LOGIC ("Deleted " << j << " global routes from node "<< node->GetId ());
+      gr->ClearRoutes ();
     }
+  m_spfGraph.Clear ();
+  ClearSpfPaths ();
+  m_addressIndex.clear ();
+  m_routerIndex.clear ();
+  Ipv4DSRRouting::ClearRouterAddresses ();
   if (m_lsdb)
     {
       NS_LOG_LOGIC ("Deleting LSDB, creating new one");
@@ -720,6 +785,14 @@ DSRRouteManagerImpl::BuildDSRRoutingDatabase ()
           m_lsdb->Insert (lsa->GetLinkStateId (), lsa); 
         }
     }
+//
+// Snapshot the router graph once for all the SPF calculations.
+//
+  m_spfGraph.Clear ();
+  if (UseSpfGraph ())
+    {
+      m_spfGraph.Build (*m_lsdb);
+    }
 }
 
 //
@@ -763,6 +836,21 @@ DSRRouteManagerImpl::InitializeRoutes ()
 // Walk the list of nodes in the system.
 //
   NS_LOG_INFO ("About to start SPF calculation");
+  bool perRouter = SpfPerRouter ();
+  BuildNodeIndex ();
+//
+// The routes are written to tables the lookups do not see yet, and swapped
+// in once every router has its complete table.
+//
+  BeginRouteTables ();
+  if (m_spfGraph.IsUsable ())
+    {
+      InitializeGraphRoutes (perRouter);
+      CommitRouteTables ();
+      NS_LOG_INFO ("Finished DSR-SPF calculation");
+      return;
+    }
+  m_spfTrees.clear ();
   NodeList::Iterator listEnd = NodeList::End ();
   for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
     {
@@ -852,46 +940,992 @@ DSRRouteManagerImpl::InitializeRoutes ()
                   // std::cout << "The interface = " << Iface << std::endl;
                   // gr->AddHostRouteTo (linkRemote->GetLinkData (), linkRemote->GetLinkData (), Iface, l->GetMetric ());
 
-                  // todo
-                  for (NodeList::Iterator j = NodeList::Begin (); j != listEnd; j++)
-                    {
-                      Ptr<Node> nextNode = *j;
-                      Ptr<Ipv4> nextIpv4 = nextNode->GetObject<Ipv4> ();
-                      for (uint32_t iter =0; iter < nextIpv4->GetNInterfaces (); iter ++)
-                        {
-                          Ipv4InterfaceAddress ifc = nextIpv4->GetAddress (iter,0);
-                          Ipv4Address addr = ifc.GetLocal ();
-                          if (addr == linkRemote->GetLinkData ())
-                            {
-                              std::cout << "true" << std::endl;
-                              for (uint32_t nIfc = 1; nIfc < nextIpv4->GetNInterfaces (); nIfc ++)
-                                {
-                                  gr->AddHostRouteTo (nextIpv4->GetAddress (nIfc,0).GetLocal (), linkRemote->GetLinkData (), Iface, l->GetMetric ());
-                                }
-                            }
-                        }
-                    }   
-
-
-                  SPFCalculate (w_lsa->GetLinkStateId (), rtr->GetRouterId (), linkRemote, Iface);
+                  SPFAddAddressRoutes (gr, linkRemote->GetLinkData (), Iface, l->GetMetric ());
+
+
+                  if (perRouter)
+                    {
+                      SPFIntraAddNeighborTree (GetSpfTree (w_lsa->GetLinkStateId ()), gr,
+                                               linkRemote->GetLinkData (), Iface, linkRemote->GetMetric ());
+                    }
+                  else
+                    {
+                      SPFCalculate (w_lsa->GetLinkStateId (), rtr->GetRouterId (), linkRemote, Iface);
+                    }
+                }
+                else if (l->GetLinkType () == 
+                          DSRRoutingLinkRecord::TransitNetwork)
+                  {
+                    w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
+                    NS_ASSERT (w_lsa);
+                    NS_LOG_LOGIC ("Found a Transit record from " << 
+                                  v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
+                    SPFCalculate (w_lsa->GetLinkStateId (), rtr->GetRouterId (), l, i+1);
+                  }
+                else 
+                  {
+                    NS_ASSERT_MSG (0, "illegal Link Type");
+                  }
+                }
+          }
+    }
+  m_spfTrees.clear ();
+  CommitRouteTables ();
+  NS_LOG_INFO ("Finished DSR-SPF calculation");
+}
+
+void
+DSRRouteManagerImpl::BeginRouteTables (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::unordered_map<uint32_t, Ptr<Node> >::const_iterator i = m_routerIndex.begin ();
+       i != m_routerIndex.end (); i++)
+    {
+      i->second->GetObject<DSRRouter> ()->GetRoutingProtocol ()->BeginRouteTable ();
+    }
+}
+
+void
+DSRRouteManagerImpl::CommitRouteTables (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::unordered_map<uint32_t, Ptr<Node> >::const_iterator i = m_routerIndex.begin ();
+       i != m_routerIndex.end (); i++)
+    {
+      uint32_t nRoutes = i->second->GetObject<DSRRouter> ()->GetRoutingProtocol ()->CommitRouteTable ();
+      NS_LOG_LOGIC ("Node " << i->second->GetId () << " has " << nRoutes << " routes");
+    }
+}
+
+bool
+DSRRouteManagerImpl::SpfPerRouter (void)
+{
+  BooleanValue perRouter;
+  g_dsrSpfPerRouter.GetValue (perRouter);
+  return perRouter.Get ();
+}
+
+bool
+DSRRouteManagerImpl::UseSpfGraph (void)
+{
+  BooleanValue graph;
+  g_dsrSpfGraph.GetValue (graph);
+  return graph.Get ();
+}
+
+bool
+DSRRouteManagerImpl::RouterRoutes (void)
+{
+  BooleanValue routerRoutes;
+  g_dsrRouterRoutes.GetValue (routerRoutes);
+  return routerRoutes.Get ();
+}
+
+uint32_t
+DSRRouteManagerImpl::SpfThreads (void)
+{
+  UintegerValue threads;
+  g_dsrSpfThreads.GetValue (threads);
+  if (threads.Get () == 0)
+    {
+      return std::max (1u, std::thread::hardware_concurrency ());
+    }
+  return threads.Get ();
+}
+
+const DSRRouteManagerImpl::DsrSpfTree &
+DSRRouteManagerImpl::GetSpfTree (Ipv4Address root)
+{
+  NS_LOG_FUNCTION (this << root);
+  DsrSpfTrees::iterator i = m_spfTrees.find (root.Get ());
+  if (i != m_spfTrees.end ())
+    {
+      return i->second;
+    }
+//
+// The tree rooted at a neighbor only differs, for each router bordering it,
+// by the metric of the first link, so compute it once at distance 0.  The
+// stub, transit and external routes of the root are installed on the way.
+//
+  DsrSpfTree &tree = m_spfTrees[root.Get ()];
+  m_spfTree = &tree;
+  SPFCalculate (root, root, 0, 0);
+  m_spfTree = 0;
+  NS_LOG_LOGIC ("SPF tree of " << root << " reaches " << tree.routers.size () << " routers");
+  return tree;
+}
+
+bool
+DSRRouteManagerImpl::RespondToInterfaceEvents (void)
+{
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<DSRRouter> rtr = (*i)->GetObject<DSRRouter> ();
+      if (rtr == 0)
+        {
+          continue;
+        }
+      BooleanValue respond;
+      rtr->GetRoutingProtocol ()->GetAttribute ("RespondToInterfaceEvents", respond);
+      if (respond.Get ())
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+bool
+DSRRouteManagerImpl::SameLSA (const DSRRoutingLSA &a, const DSRRoutingLSA &b)
+{
+  if (a.GetLSType () != b.GetLSType ()
+      || a.GetLinkStateId () != b.GetLinkStateId ()
+      || a.GetAdvertisingRouter () != b.GetAdvertisingRouter ()
+      || a.GetNetworkLSANetworkMask () != b.GetNetworkLSANetworkMask ()
+      || a.GetNode () != b.GetNode ()
+      || a.GetNLinkRecords () != b.GetNLinkRecords ()
+      || a.GetNAttachedRouters () != b.GetNAttachedRouters ())
+    {
+      return false;
+    }
+  for (uint32_t i = 0; i < a.GetNLinkRecords (); i++)
+    {
+      DSRRoutingLinkRecord *la = a.GetLinkRecord (i);
+      DSRRoutingLinkRecord *lb = b.GetLinkRecord (i);
+      if (la->GetLinkType () != lb->GetLinkType ()
+          || la->GetLinkId () != lb->GetLinkId ()
+          || la->GetLinkData () != lb->GetLinkData ()
+          || la->GetMetric () != lb->GetMetric ())
+        {
+          return false;
+        }
+    }
+  for (uint32_t i = 0; i < a.GetNAttachedRouters (); i++)
+    {
+      if (a.GetAttachedRouter (i) != b.GetAttachedRouter (i))
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+DSRRouteManagerImpl::InitializeGraphRoutes (bool perRouter)
+{
+  NS_LOG_FUNCTION (this << perRouter);
+  uint32_t n = m_spfGraph.GetNVertices ();
+  m_spfPaths.assign (n, DsrSpfPaths ());
+  m_spfPathsReady.assign (n, 0);
+  m_spfPathsUses.assign (n, 0);
+  CountSpfCalls (m_spfCalls);
+  m_keepSpfPaths = RespondToInterfaceEvents ();
+//
+// The paths rooted at a router serve each link into it from this system,
+// and once the routes rooted at the router itself.  They are freed after
+// their last use, unless UpdateRoutes will need them.
+//
+  std::vector<uint32_t> roots;
+  for (uint32_t v = 0; v < n; v++)
+    {
+      if (NeedsSpfPaths (v))
+        {
+          m_spfPathsUses[v] = m_spfCalls[v] + 1;
+          roots.push_back (v);
+        }
+    }
+  uint32_t nThreads = SpfThreads ();
+  if (nThreads != 1)
+    {
+      SPFComputePaths (roots, nThreads);
+    }
+//
+// The per-link loop appends to the host routes of a router only while
+// visiting it, and to its network and external routes only from the SPF
+// calculations rooted at it, which all add the same routes.  Installing
+// both at once when visiting the router keeps the order of every list.
+//
+  uint32_t systemId = Simulator::GetSystemId ();
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<Node> node = *i;
+      Ptr<DSRRouter> rtr = node->GetObject<DSRRouter> ();
+      if (rtr == 0)
+        {
+          continue;
+        }
+      if (node->GetSystemId () == systemId)
+        {
+          SPFAddNeighborRoutes (node);
+        }
+      uint32_t v = m_spfGraph.GetVertex (rtr->GetRouterId ());
+      if (v != DsrSpfGraph::NO_VERTEX && m_spfCalls[v] > 0)
+        {
+          SPFAddRootRoutes (v, perRouter);
+        }
+    }
+  if (!m_keepSpfPaths)
+    {
+      ClearSpfPaths ();
+    }
+}
+
+void
+DSRRouteManagerImpl::CountSpfCalls (std::vector<uint32_t> &calls) const
+{
+  uint32_t n = m_spfGraph.GetNVertices ();
+  calls.assign (n, 0);
+  uint32_t systemId = Simulator::GetSystemId ();
+  for (uint32_t v = 0; v < n; v++)
+    {
+      if (m_spfGraph.GetLSA (v)->GetNode ()->GetSystemId () != systemId)
+        {
+          continue;
+        }
+      for (uint32_t e = m_spfGraph.GetEdgeBegin (v); e < m_spfGraph.GetEdgeEnd (v); e++)
+        {
+          calls[m_spfGraph.GetEdgeTarget (e)]++;
+        }
+    }
+}
+
+bool
+DSRRouteManagerImpl::NeedsSpfPaths (uint32_t v) const
+{
+  // the SPF stops at stub roots, which have a single link
+  return m_spfGraph.GetDegree (v) > 1 && m_spfCalls[v] > 0;
+}
+
+void
+DSRRouteManagerImpl::ClearSpfPaths (void)
+{
+  m_spfPaths.clear ();
+  m_spfPathsReady.clear ();
+  m_spfPathsUses.clear ();
+  m_spfCalls.clear ();
+  m_keepSpfPaths = false;
+}
+
+void
+DSRRouteManagerImpl::SPFComputePaths (const std::vector<uint32_t> &roots, uint32_t nThreads)
+{
+  NS_LOG_FUNCTION (this << roots.size () << nThreads);
+  nThreads = std::min<uint32_t> (nThreads, roots.size ());
+  NS_LOG_INFO ("Computing " << roots.size () << " SPF trees with " << nThreads << " threads");
+  if (nThreads <= 1)
+    {
+      for (std::vector<uint32_t>::const_iterator i = roots.begin (); i != roots.end (); i++)
+        {
+          NS_LOG_LOGIC ("SPF tree rooted at vertex " << *i);
+          m_spfGraph.Calculate (*i, m_spfResult);
+          DsrSpfGraph::Summarize (m_spfResult, m_spfPaths[*i]);
+          m_spfPathsReady[*i] = 1;
+        }
+      return;
+    }
+//
+// Every worker computes into its own DsrSpfResult and writes only the
+// paths of the roots it took, so nothing is shared but the read-only
+// graph and the root counter.  The routes are installed after the join, in
+// the serial order.
+//
+  std::atomic<uint32_t> next (0);
+  const DsrSpfGraph &graph = m_spfGraph;
+  std::vector<DsrSpfPaths> &paths = m_spfPaths;
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < nThreads; t++)
+    {
+      workers.push_back (std::thread ([&graph, &paths, &roots, &next] ()
+        {
+          DsrSpfResult result;
+          for (uint32_t i = next++; i < roots.size (); i = next++)
+            {
+              graph.Calculate (roots[i], result);
+              DsrSpfGraph::Summarize (result, paths[roots[i]]);
+            }
+        }));
+    }
+  for (std::vector<std::thread>::iterator i = workers.begin (); i != workers.end (); i++)
+    {
+      i->join ();
+    }
+  for (std::vector<uint32_t>::const_iterator i = roots.begin (); i != roots.end (); i++)
+    {
+      m_spfPathsReady[*i] = 1;
+    }
+}
+
+const DsrSpfPaths &
+DSRRouteManagerImpl::GetSpfPaths (uint32_t root)
+{
+  if (!m_spfPathsReady[root])
+    {
+      NS_LOG_LOGIC ("SPF tree rooted at vertex " << root);
+      m_spfGraph.Calculate (root, m_spfResult);
+      DsrSpfGraph::Summarize (m_spfResult, m_spfPaths[root]);
+      m_spfPathsReady[root] = 1;
+    }
+  return m_spfPaths[root];
+}
+
+void
+DSRRouteManagerImpl::ReleaseSpfPaths (uint32_t root)
+{
+  if (m_keepSpfPaths)
+    {
+      return;
+    }
+  NS_ASSERT (m_spfPathsUses[root] > 0);
+  if (--m_spfPathsUses[root] == 0)
+    {
+      m_spfPaths[root] = DsrSpfPaths ();
+      m_spfPathsReady[root] = 0;
+    }
+}
+
+void
+DSRRouteManagerImpl::BuildNodeIndex (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_addressIndex.clear ();
+  m_routerIndex.clear ();
+  Ipv4DSRRouting::ClearRouterAddresses ();
+  m_routerRoutes = RouterRoutes ();
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<Node> node = *i;
+      Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+      if (ipv4 != 0)
+        {
+          for (uint32_t j = 0; j < ipv4->GetNInterfaces (); j++)
+            {
+              if (ipv4->GetNAddresses (j) == 0)
+                {
+                  continue;
+                }
+              uint32_t addr = ipv4->GetAddress (j, 0).GetLocal ().Get ();
+              m_addressIndex[addr].push_back (node);
+            }
+        }
+      Ptr<DSRRouter> rtr = node->GetObject<DSRRouter> ();
+      if (rtr != 0)
+        {
+          // the first node wins, as in a walk of the node list
+          m_routerIndex.insert (std::make_pair (rtr->GetRouterId ().Get (), node));
+          if (m_routerRoutes)
+            {
+              // the addresses SPFAddAddressRoutes would give host routes to
+              for (uint32_t j = 1; j < ipv4->GetNInterfaces (); j++)
+                {
+                  if (ipv4->GetNAddresses (j) > 0)
+                    {
+                      Ipv4DSRRouting::AddRouterAddress (ipv4->GetAddress (j, 0).GetLocal (),
+                                                        rtr->GetRouterId ());
+                    }
+                }
+            }
+        }
+    }
+  NS_LOG_LOGIC ("Indexed " << m_addressIndex.size () << " addresses and " <<
+                m_routerIndex.size () << " routers");
+}
+
+Ptr<Node>
+DSRRouteManagerImpl::GetRouterNode (Ipv4Address routerId) const
+{
+  std::unordered_map<uint32_t, Ptr<Node> >::const_iterator i = m_routerIndex.find (routerId.Get ());
+  if (i == m_routerIndex.end ())
+    {
+      return 0;
+    }
+  return i->second;
+}
+
+void
+DSRRouteManagerImpl::SPFAddAddressRoutes (Ptr<Ipv4DSRRouting> gr, Ipv4Address linkData,
+                                          int32_t Iface, uint32_t metric)
+{
+  std::unordered_map<uint32_t, std::vector<Ptr<Node> > >::const_iterator i = m_addressIndex.find (linkData.Get ());
+  if (i == m_addressIndex.end ())
+    {
+      return;
+    }
+  for (std::vector<Ptr<Node> >::const_iterator j = i->second.begin (); j != i->second.end (); j++)
+    {
+      Ptr<DSRRouter> rtr = (*j)->GetObject<DSRRouter> ();
+      if (m_routerRoutes && rtr != 0)
+        {
+          NS_LOG_LOGIC ("Adding a host route to router " << rtr->GetRouterId ());
+          gr->AddHostRouteTo (rtr->GetRouterId (), linkData, Iface, metric);
+          continue;
+        }
+      Ptr<Ipv4> nextIpv4 = (*j)->GetObject<Ipv4> ();
+      NS_LOG_LOGIC ("Adding host routes to the addresses of node " << (*j)->GetId ());
+      for (uint32_t nIfc = 1; nIfc < nextIpv4->GetNInterfaces (); nIfc ++)
+        {
+          gr->AddHostRouteTo (nextIpv4->GetAddress (nIfc,0).GetLocal (), linkData, Iface, metric);
+        }
+    }
+}
+
+void
+DSRRouteManagerImpl::SPFAddRouterRoutes (Ptr<Ipv4DSRRouting> gr, DSRRoutingLSA *lsa,
+                                         Ipv4Address nextHop, uint32_t Iface, uint32_t distance)
+{
+  for (uint32_t j = 0; j < lsa->GetNLinkRecords (); ++j)
+    {
+      DSRRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != DSRRoutingLinkRecord::PointToPoint)
+        {
+          continue;
+        }
+      if (m_routerRoutes)
+        {
+          gr->AddHostRouteTo (lsa->GetLinkStateId (), nextHop, Iface, distance);
+          return;
+        }
+      gr->AddHostRouteTo (lr->GetLinkData (), nextHop, Iface, distance);
+    }
+}
+
+void
+DSRRouteManagerImpl::SPFAddNeighborRoutes (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (this << node->GetId ());
+  Ptr<DSRRouter> rtr = node->GetObject<DSRRouter> ();
+  NS_ASSERT (rtr);
+  Ptr<Ipv4DSRRouting> gr = rtr->GetRoutingProtocol ();
+  NS_ASSERT (gr);
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  Ipv4Address routerId = rtr->GetRouterId ();
+  DSRRoutingLSA *lsa = m_spfGraph.GetLSA (m_spfGraph.GetVertex (routerId));
+  for (uint32_t i = 0; i < lsa->GetNLinkRecords (); i++)
+    {
+      DSRRoutingLinkRecord *l = lsa->GetLinkRecord (i);
+      if (l->GetLinkType () != DSRRoutingLinkRecord::PointToPoint)
+        {
+          continue;
+        }
+      uint32_t w = m_spfGraph.GetVertex (l->GetLinkId ());
+      NS_ASSERT (w != DsrSpfGraph::NO_VERTEX);
+      // as SPFGetNextLink: the first record of <w> pointing back
+      DSRRoutingLSA *wLsa = m_spfGraph.GetLSA (w);
+      DSRRoutingLinkRecord *linkRemote = 0;
+      for (uint32_t k = 0; k < wLsa->GetNLinkRecords (); k++)
+        {
+          if (wLsa->GetLinkRecord (k)->GetLinkId () == routerId)
+            {
+              linkRemote = wLsa->GetLinkRecord (k);
+              break;
+            }
+        }
+      NS_ASSERT (linkRemote);
+      int32_t Iface = ipv4->GetInterfaceForAddress (l->GetLinkData ());
+
+      SPFAddAddressRoutes (gr, linkRemote->GetLinkData (), Iface, l->GetMetric ());
+
+      if (m_spfGraph.GetDegree (w) <= 1)
+        {
+          // the SPF stops at stub roots without adding routes
+          continue;
+        }
+      const DsrSpfPaths &paths = GetSpfPaths (w);
+      for (std::vector<uint32_t>::const_iterator u = paths.routers.begin (); u != paths.routers.end (); u++)
+        {
+          uint32_t distance = paths.distance[*u] + linkRemote->GetMetric ();
+          SPFAddRouterRoutes (gr, m_spfGraph.GetLSA (*u), linkRemote->GetLinkData (), Iface, distance);
+        }
+      ReleaseSpfPaths (w);
+    }
+}
+
+void
+DSRRouteManagerImpl::SPFAddRootRoutes (uint32_t root, bool perRouter)
+{
+  NS_LOG_FUNCTION (this << root << perRouter);
+  uint32_t copies = perRouter ? 1 : m_spfCalls[root];
+  DSRRoutingLSA *rlsa = m_spfGraph.GetLSA (root);
+  if (m_spfGraph.GetDegree (root) <= 1)
+    {
+//
+// A stub only gets a default route.  CheckForStubNode looks the outgoing
+// interface up through m_spfroot.
+//
+      m_spfroot = new DSRVertex (rlsa);
+      for (uint32_t c = 0; c < copies && NodeList::GetNNodes () > 0; c++)
+        {
+          CheckForStubNode (rlsa->GetLinkStateId ());
+        }
+      delete m_spfroot;
+      m_spfroot = 0;
+      return;
+    }
+
+  const DsrSpfPaths &paths = GetSpfPaths (root);
+  Ptr<DSRRouter> router = rlsa->GetNode ()->GetObject<DSRRouter> ();
+  NS_ASSERT (router);
+  Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
+  NS_ASSERT (gr);
+  for (uint32_t c = 0; c < copies; c++)
+    {
+//
+// Second stage, as SPFProcessStubs: the stub networks of the routers in
+// the depth-first order of the tree, through the exits of their router.
+//
+      for (uint32_t i = 0; i < paths.preorder.size (); i++)
+        {
+          DSRRoutingLSA *lsa = m_spfGraph.GetLSA (paths.preorder[i]);
+          for (uint32_t j = 0; j < lsa->GetNLinkRecords (); j++)
+            {
+              DSRRoutingLinkRecord *l = lsa->GetLinkRecord (j);
+              if (l->GetLinkType () != DSRRoutingLinkRecord::StubNetwork)
+                {
+                  continue;
+                }
+              Ipv4Mask tempmask (l->GetLinkData ().Get ());
+              Ipv4Address tempip = l->GetLinkId ().CombineMask (tempmask);
+              for (uint32_t e = paths.exitOffset[i]; e < paths.exitOffset[i + 1]; e++)
+                {
+                  const DsrSpfResult::Exit &exit = paths.exits[e];
+                  if (exit.second >= 0)
+                    {
+                      gr->AddNetworkRouteTo (tempip, tempmask, Ipv4Address (exit.first), exit.second);
+                    }
+                }
+            }
+        }
+//
+// As ProcessASExternals: the externals of the routers in the tree other
+// than the root.
+//
+      for (uint32_t i = 0; i < m_lsdb->GetNumExtLSAs (); i++)
+        {
+          DSRRoutingLSA *extlsa = m_lsdb->GetExtLSA (i);
+          uint32_t v = m_spfGraph.GetVertex (extlsa->GetAdvertisingRouter ());
+          std::vector<uint32_t>::const_iterator pos = std::find (paths.preorder.begin (), paths.preorder.end (), v);
+          if (pos == paths.preorder.end ())
+            {
+              continue;
+            }
+          uint32_t k = pos - paths.preorder.begin ();
+          Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
+          Ipv4Address tempip = extlsa->GetLinkStateId ().CombineMask (tempmask);
+          for (uint32_t e = paths.exitOffset[k]; e < paths.exitOffset[k + 1]; e++)
+            {
+              const DsrSpfResult::Exit &exit = paths.exits[e];
+              if (exit.second >= 0)
+                {
+                  gr->AddASExternalRouteTo (tempip, tempmask, Ipv4Address (exit.first), exit.second);
+                }
+            }
+        }
+    }
+  ReleaseSpfPaths (root);
+}
+
+void
+DSRRouteManagerImpl::UpdateRoutes (NodeContainer nodes)
+{
+  NS_LOG_FUNCTION (this);
+  if (UpdateGraphRoutes (nodes))
+    {
+      return;
+    }
+  NS_LOG_INFO ("Rebuilding all the routes");
+  DeleteDSRRoutes ();
+  BuildDSRRoutingDatabase ();
+  InitializeRoutes ();
+}
+
+void
+DSRRouteManagerImpl::ScheduleUpdate (Ptr<Node> node, Time delay, Time holdTime)
+{
+  NS_LOG_FUNCTION (this << node->GetId () << delay << holdTime);
+  m_nUpdateTriggers++;
+  m_updateTriggers++;
+  bool known = false;
+  for (NodeContainer::Iterator i = m_updateNodes.Begin (); i != m_updateNodes.End (); i++)
+    {
+      known = known || *i == node;
+    }
+  if (!known)
+    {
+      m_updateNodes.Add (node);
+    }
+  if (m_updateEvent.IsRunning ())
+    {
+      NS_LOG_LOGIC ("Merged into the pending update");
+      return;
+    }
+//
+// Open a window: wait for the other events of the change, but do not run
+// two updates closer than the hold time.
+//
+  Time start = Simulator::Now () + delay;
+  if (m_nUpdates > 0 && start < m_lastUpdate + holdTime)
+    {
+      start = m_lastUpdate + holdTime;
+    }
+  m_lastUpdate = start;
+  m_updateEvent = Simulator::Schedule (start - Simulator::Now (),
+                                       &DSRRouteManagerImpl::RunScheduledUpdate, this);
+}
+
+void
+DSRRouteManagerImpl::RunScheduledUpdate (void)
+{
+  NS_LOG_FUNCTION (this);
+  NodeContainer nodes = m_updateNodes;
+  uint32_t triggers = m_updateTriggers;
+  m_updateNodes = NodeContainer ();
+  m_updateTriggers = 0;
+  m_nUpdates++;
+  NS_LOG_INFO ("Route update serving " << triggers << " events on " << nodes.GetN () << " nodes");
+  UpdateRoutes (nodes);
+  // the node of the first event opened the window
+  Ptr<DSRRouter> router = nodes.Get (0)->GetObject<DSRRouter> ();
+  if (router != 0)
+    {
+      router->GetRoutingProtocol ()->NotifyRouteUpdate (triggers, nodes.GetN ());
+    }
+}
+
+uint64_t
+DSRRouteManagerImpl::GetNUpdateTriggers (void) const
+{
+  return m_nUpdateTriggers;
+}
+
+uint64_t
+DSRRouteManagerImpl::GetNUpdates (void) const
+{
+  return m_nUpdates;
+}
+
+bool
+DSRRouteManagerImpl::UpdateGraphRoutes (NodeContainer nodes)
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_keepSpfPaths || !m_spfGraph.IsUsable ())
+    {
+      return false;
+    }
+  BuildNodeIndex ();
+  uint32_t n = m_spfGraph.GetNVertices ();
+//
+// An interface or address change can only alter the LSAs of the node and
+// of the routers across its links.
+//
+  std::vector<uint8_t> event (n, 0);
+  std::vector<uint8_t> candidate (n, 0);
+  std::vector<Ptr<DSRRouter> > routers;
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); i++)
+    {
+      Ptr<Node> node = *i;
+      std::vector<Ptr<Node> > reached (1, node);
+      for (uint32_t d = 0; d < node->GetNDevices (); d++)
+        {
+          Ptr<Channel> ch = node->GetDevice (d)->GetChannel ();
+          if (ch == 0)
+            {
+              continue;
+            }
+          for (uint32_t k = 0; k < ch->GetNDevices (); k++)
+            {
+              reached.push_back (ch->GetDevice (k)->GetNode ());
+            }
+        }
+      for (std::vector<Ptr<Node> >::const_iterator j = reached.begin (); j != reached.end (); j++)
+        {
+          Ptr<DSRRouter> rtr = (*j)->GetObject<DSRRouter> ();
+          if (rtr == 0)
+            {
+              continue;
+            }
+          uint32_t v = m_spfGraph.GetVertex (rtr->GetRouterId ());
+          if (v == DsrSpfGraph::NO_VERTEX)
+            {
+              NS_LOG_LOGIC ("Router " << rtr->GetRouterId () << " is not in the graph");
+              return false;
+            }
+          if (*j == node)
+            {
+              event[v] = 1;
+            }
+          if (!candidate[v])
+            {
+              candidate[v] = 1;
+              routers.push_back (rtr);
+            }
+        }
+    }
+
+  std::vector<std::pair<uint32_t, DSRRoutingLSA *> > changed;
+  bool incremental = true;
+  for (std::vector<Ptr<DSRRouter> >::const_iterator i = routers.begin (); i != routers.end (); i++)
+    {
+      Ptr<DSRRouter> rtr = *i;
+      DSRRoutingLSA *routerLsa = 0;
+      std::vector<DSRRoutingLSA *> externals;
+      uint32_t numLSAs = rtr->DiscoverLSAs ();
+      for (uint32_t j = 0; j < numLSAs; j++)
+        {
+          DSRRoutingLSA *lsa = new DSRRoutingLSA ();
+          rtr->GetLSA (j, *lsa);
+          if (lsa->GetLSType () == DSRRoutingLSA::RouterLSA && routerLsa == 0)
+            {
+              routerLsa = lsa;
+            }
+          else if (lsa->GetLSType () == DSRRoutingLSA::ASExternalLSAs)
+            {
+              externals.push_back (lsa);
+            }
+          else
+            {
+              NS_LOG_LOGIC ("Router " << rtr->GetRouterId () << " now advertises a network LSA");
+              incremental = false;
+              delete lsa;
+            }
+        }
+      // the externals are kept as they are, the SPF paths do not cover them
+      uint32_t k = 0;
+      for (uint32_t e = 0; e < m_lsdb->GetNumExtLSAs (); e++)
+        {
+          DSRRoutingLSA *extlsa = m_lsdb->GetExtLSA (e);
+          if (extlsa->GetAdvertisingRouter () != rtr->GetRouterId ())
+            {
+              continue;
+            }
+          if (k >= externals.size () || !SameLSA (*extlsa, *externals[k]))
+            {
+              incremental = false;
+            }
+          k++;
+        }
+      if (k != externals.size () || routerLsa == 0)
+        {
+          incremental = false;
+        }
+      for (std::vector<DSRRoutingLSA *>::iterator j = externals.begin (); j != externals.end (); j++)
+        {
+          delete *j;
+        }
+      uint32_t v = m_spfGraph.GetVertex (rtr->GetRouterId ());
+      if (routerLsa != 0 && !SameLSA (*routerLsa, *m_spfGraph.GetLSA (v)))
+        {
+          changed.push_back (std::make_pair (v, routerLsa));
+        }
+      else
+        {
+          delete routerLsa;
+        }
+    }
+  if (!incremental)
+    {
+      for (uint32_t i = 0; i < changed.size (); i++)
+        {
+          delete changed[i].second;
+        }
+      return false;
+    }
+
+//
+// Swap the changed LSAs in and snapshot the graph again.  The copy of the
+// old graph is only read for its edges: Replace frees the LSAs it points to.
+//
+  DsrSpfGraph old = m_spfGraph;
+  std::vector<uint8_t> lsaChanged (n, 0);
+  for (uint32_t i = 0; i < changed.size (); i++)
+    {
+      lsaChanged[changed[i].first] = 1;
+      m_lsdb->Replace (changed[i].second->GetLinkStateId (), changed[i].second);
+    }
+  m_spfGraph.Build (*m_lsdb);
+  if (!m_spfGraph.IsUsable () || m_spfGraph.GetNVertices () != n)
+    {
+      return false;
+    }
+  std::vector<uint8_t> edgesChanged (n, 0);
+  std::vector<uint32_t> moved;
+  for (uint32_t v = 0; v < n; v++)
+    {
+      if (!m_spfGraph.SameEdges (old, v))
+        {
+          edgesChanged[v] = 1;
+          moved.push_back (v);
+        }
+    }
+
+//
+// A tree only changes if a moved edge leaves a router it reaches and either
+// was on a shortest path, so it may have made a parent, or now offers a path
+// no longer than the known one, so it may make one.  The other edges never
+// win a relaxation and leave the tree, down to the order of its equal-cost
+// candidates, as it was.
+//
+  const uint32_t unreachable = 0xffffffff;
+  std::vector<uint8_t> treeChanged (n, 0);
+  std::vector<uint32_t> affected;
+  for (uint32_t r = 0; r < n; r++)
+    {
+      if (!m_spfPathsReady[r])
+        {
+          continue;
+        }
+      const std::vector<uint32_t> &d = m_spfPaths[r].distance;
+      bool hit = edgesChanged[r];
+      for (std::vector<uint32_t>::const_iterator u = moved.begin (); !hit && u != moved.end (); u++)
+        {
+          if (d[*u] == unreachable)
+            {
+              continue;
+            }
+          for (uint32_t e = old.GetEdgeBegin (*u); !hit && e < old.GetEdgeEnd (*u); e++)
+            {
+              hit = d[*u] + old.GetEdgeMetric (e) == d[old.GetEdgeTarget (e)];
+            }
+          for (uint32_t e = m_spfGraph.GetEdgeBegin (*u); !hit && e < m_spfGraph.GetEdgeEnd (*u); e++)
+            {
+              uint32_t w = m_spfGraph.GetEdgeTarget (e);
+              hit = d[w] == unreachable || d[*u] + m_spfGraph.GetEdgeMetric (e) <= d[w];
+            }
+        }
+      if (hit)
+        {
+          affected.push_back (r);
+        }
+      // the routes of the tree also come from the LSAs of its routers
+      for (uint32_t i = 0; i < changed.size (); i++)
+        {
+          if (d[changed[i].first] != unreachable)
+            {
+              treeChanged[r] = 1;
+            }
+        }
+    }
+  std::vector<DsrSpfPaths> before (affected.size ());
+  for (uint32_t i = 0; i < affected.size (); i++)
+    {
+      std::swap (before[i], m_spfPaths[affected[i]]);
+    }
+  SPFComputePaths (affected, SpfThreads ());
+  for (uint32_t i = 0; i < affected.size (); i++)
+    {
+      const DsrSpfPaths &now = m_spfPaths[affected[i]];
+      if (now.routers != before[i].routers
+          || now.distance != before[i].distance
+          || now.preorder != before[i].preorder
+          || now.exitOffset != before[i].exitOffset
+          || now.exits != before[i].exits)
+        {
+          treeChanged[affected[i]] = 1;
+        }
+    }
+
+  std::vector<uint32_t> oldCalls;
+  oldCalls.swap (m_spfCalls);
+  CountSpfCalls (m_spfCalls);
+  for (uint32_t v = 0; v < n; v++)
+    {
+      if (m_spfPathsReady[v] && !NeedsSpfPaths (v))
+        {
+          m_spfPaths[v] = DsrSpfPaths ();
+          m_spfPathsReady[v] = 0;
+        }
+    }
+
+//
+// The routes of a router come from its LSA, its edges, its tree and the
+// number of links into it, and from the LSAs, trees and addresses of its
+// neighbors, so reinstall the routers where one of those changed and their
+// neighbors before and after the change.
+//
+  std::vector<uint8_t> source (n, 0);
+  for (uint32_t v = 0; v < n; v++)
+    {
+      source[v] = lsaChanged[v] || edgesChanged[v] || event[v] || treeChanged[v]
+        || oldCalls[v] != m_spfCalls[v];
+    }
+  std::vector<uint8_t> dirty (source);
+  const DsrSpfGraph *graphs[] = { &old, &m_spfGraph };
+  for (uint32_t g = 0; g < 2; g++)
+    {
+      for (uint32_t u = 0; u < n; u++)
+        {
+          for (uint32_t e = graphs[g]->GetEdgeBegin (u); e < graphs[g]->GetEdgeEnd (u); e++)
+            {
+              uint32_t w = graphs[g]->GetEdgeTarget (e);
+              if (source[w])
+                {
+                  dirty[u] = 1;
                 }
-                else if (l->GetLinkType () == 
-                          DSRRoutingLinkRecord::TransitNetwork)
-                  {
-                    w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
-                    NS_ASSERT (w_lsa);
-                    NS_LOG_LOGIC ("Found a Transit record from " << 
-                                  v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
-                    SPFCalculate (w_lsa->GetLinkStateId (), rtr->GetRouterId (), l, i+1);
-                  }
-                else 
-                  {
-                    NS_ASSERT_MSG (0, "illegal Link Type");
-                  }
+              if (source[u])
+                {
+                  dirty[w] = 1;
                 }
-          }
+            }
+        }
+    }
+
+  bool perRouter = SpfPerRouter ();
+  uint32_t systemId = Simulator::GetSystemId ();
+  uint32_t nRouters = 0;
+  uint32_t patched = 0;
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<Node> node = *i;
+      Ptr<DSRRouter> rtr = node->GetObject<DSRRouter> ();
+      if (rtr == 0)
+        {
+          continue;
+        }
+      uint32_t v = m_spfGraph.GetVertex (rtr->GetRouterId ());
+      if (v == DsrSpfGraph::NO_VERTEX || !dirty[v])
+        {
+          continue;
+        }
+      bool local = node->GetSystemId () == systemId;
+      if (!local && oldCalls[v] == 0 && m_spfCalls[v] == 0)
+        {
+          continue;
+        }
+      Ptr<Ipv4DSRRouting> gr = rtr->GetRoutingProtocol ();
+      gr->BeginRouteUpdate ();
+      if (local)
+        {
+          SPFAddNeighborRoutes (node);
+        }
+      if (m_spfCalls[v] > 0)
+        {
+          SPFAddRootRoutes (v, perRouter);
+        }
+      patched += gr->EndRouteUpdate ();
+      nRouters++;
+    }
+  NS_LOG_INFO ("Replaced " << changed.size () << " LSAs, recomputed " << affected.size () <<
+               " SPF trees, updated " << nRouters << " routers, patched " << patched << " routes");
+  return true;
+}
+
+void
+DSRRouteManagerImpl::SPFIntraAddNeighborTree (const DsrSpfTree &tree, Ptr<Ipv4DSRRouting> gr,
+                                              Ipv4Address nextHop, uint32_t Iface, uint32_t metric)
+{
+  NS_LOG_FUNCTION (this << nextHop << Iface << metric);
+  if (tree.stub)
+    {
+      // SPFCalculate stops at stub roots without adding routes
+      return;
+    }
+  for (std::vector<std::pair<DSRRoutingLSA *, uint32_t> >::const_iterator i = tree.routers.begin ();
+       i != tree.routers.end (); i++)
+    {
+      SPFAddRouterRoutes (gr, i->first, nextHop, Iface, i->second + metric);
     }
-  NS_LOG_INFO ("Finished DSR-SPF calculation");
 }
 
 //
@@ -1122,9 +2156,9 @@ DSRRouteManagerImpl::SPFNext (DSRVertex* v, DsrCandidateQueue& candidate)
                 {
 //
 // If we've changed the cost to get to the vertex represented by <w>, we 
-// must reorder the priority queue keyed to that cost.
+// must restore its place in the priority queue keyed to that cost.
 //
-                  candidate.Reorder ();
+                  candidate.DecreaseKey (cw);
                 }
             } // new lower cost path found
         } // end W is already on the candidate list
@@ -1537,7 +2571,7 @@ DSRRouteManagerImpl::SPFCalculate (Ipv4Address root, Ipv4Address initroot, DSRRo
 // We also mark this vertex as being in the SPF tree.
 //
   m_spfroot= v;
-  v->SetDistanceFromRoot (l->GetMetric ());
+  v->SetDistanceFromRoot (l != 0 ? l->GetMetric () : 0);
   v->GetLSA ()->SetStatus (DSRRoutingLSA::LSA_SPF_IN_SPFTREE);
   NS_LOG_LOGIC ("Starting SPFCalculate for node " << root);
 
@@ -1551,7 +2585,12 @@ DSRRouteManagerImpl::SPFCalculate (Ipv4Address root, Ipv4Address initroot, DSRRo
   if (NodeList::GetNNodes () > 0 && CheckForStubNode (root))
     {
       NS_LOG_LOGIC ("SPFCalculate truncated for stub node " << root);
+      if (m_spfTree != 0)
+        {
+          m_spfTree->stub = true;
+        }
       delete m_spfroot;
+      delete v_init;
       return;
     }
 
@@ -1638,7 +2677,14 @@ DSRRouteManagerImpl::SPFCalculate (Ipv4Address root, Ipv4Address initroot, DSRRo
 //
       if (v->GetVertexType () == DSRVertex::VertexRouter)
         {
-          SPFIntraAddRouter (v, v_init, l->GetLinkData (), Iface);
+          if (m_spfTree != 0)
+            {
+              m_spfTree->routers.push_back (std::make_pair (v->GetLSA (), v->GetDistanceFromRoot ()));
+            }
+          else
+            {
+              SPFIntraAddRouter (v, v_init, l->GetLinkData (), Iface);
+            }
         }
       else if (v->GetVertexType () == DSRVertex::VertexNetwork)
         {
@@ -1673,6 +2719,7 @@ DSRRouteManagerImpl::SPFCalculate (Ipv4Address root, Ipv4Address initroot, DSRRo
 //
   delete m_spfroot;
   m_spfroot = 0;
+  delete v_init;
 }
 
 void
@@ -1731,58 +2778,38 @@ DSRRouteManagerImpl::SPFAddASExternal (DSRRoutingLSA *extlsa, DSRVertex *v)
 
   NS_LOG_LOGIC ("Vertex ID = " << routerId);
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// Look up the node that has the router ID corresponding to the root vertex
+// in the router index.  This is the one we're going to write the routing
+// information to.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  Ptr<Node> node = GetRouterNode (routerId);
+  if (node == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the DSRRouter interface, so we need
-// to QI for that interface.  If there's no DSRRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<DSRRouter> rtr = node->GetObject<DSRRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No DSRRouter interface on node " << node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
+      NS_LOG_LOGIC ("No router with ID " << routerId);
+      return;
+    }
+  NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
 //
 // Routing information is updated using the Ipv4 interface.  We need to QI
 // for that interface.  If the node is acting as an IP version 4 router, it
 // should absolutely have an Ipv4 interface.
 //
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "DSRRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  NS_ASSERT_MSG (ipv4, 
+                 "DSRRouteManagerImpl::SPFIntraAddRouter (): "
+                 "QI for <Ipv4> interface failed");
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "DSRRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in DSRVertex* v");
-          Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = extlsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "DSRRouteManagerImpl::SPFIntraAddRouter (): "
+                 "Expected valid LSA in DSRVertex* v");
+  Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = extlsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
 
 //
 // Here's why we did all of that work.  We're going to add a host route to the
@@ -1797,46 +2824,43 @@ DSRRouteManagerImpl::SPFAddASExternal (DSRRoutingLSA *extlsa, DSRVertex *v)
 // Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
 // which the packets should be send for forwarding.
 //
-          Ptr<DSRRouter> router = node->GetObject<DSRRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              DSRVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              /**
-               * \author Pu Yang
-               * \brief get the distance
-              */
-              // uint32_t distance = v->GetDistanceFromRoot ();
-              // std::cout << "the SPF distance = " << distance;
-
-              if (outIf >= 0)
-                {
-                  gr->AddASExternalRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add external network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  Ptr<DSRRouter> router = node->GetObject<DSRRouter> ();
+  if (router == 0)
+    {
+      return;
+    }
+  Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
+  NS_ASSERT (gr);
+  // walk through all next-hop-IPs and out-going-interfaces for reaching
+  // the stub network gateway 'v' from the root node
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      DSRVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
+      /**
+       * \author Pu Yang
+       * \brief get the distance
+      */
+      // uint32_t distance = v->GetDistanceFromRoot ();
+      // std::cout << "the SPF distance = " << distance;
+
+      if (outIf >= 0)
+        {
+          gr->AddASExternalRouteTo (tempip, tempmask, nextHop, outIf);
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
+                        " add external network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
+        }
+      else
+        {
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative");
+        }
+    }
 }
 
 
@@ -1907,60 +2931,38 @@ DSRRouteManagerImpl::SPFIntraAddStub (DSRRoutingLinkRecord *l, DSRVertex* v)
 
   NS_LOG_LOGIC ("Vertex ID = " << routerId);
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// Look up the node that has the router ID corresponding to the root vertex
+// in the router index.  This is the one we're going to write the routing
+// information to.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  Ptr<Node> node = GetRouterNode (routerId);
+  if (node == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the DSRRouter interface, so we need
-// to QI for that interface.  If there's no DSRRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<DSRRouter> rtr = 
-        node->GetObject<DSRRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No DSRRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
+      NS_LOG_LOGIC ("No router with ID " << routerId);
+      return;
+    }
+  NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
 //
 // Routing information is updated using the Ipv4 interface.  We need to QI
 // for that interface.  If the node is acting as an IP version 4 router, it
 // should absolutely have an Ipv4 interface.
 //
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "DSRRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  NS_ASSERT_MSG (ipv4, 
+                 "DSRRouteManagerImpl::SPFIntraAddRouter (): "
+                 "QI for <Ipv4> interface failed");
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "DSRRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in DSRVertex* v");
-          Ipv4Mask tempmask (l->GetLinkData ().Get ());
-          Ipv4Address tempip = l->GetLinkId ();
-          tempip = tempip.CombineMask (tempmask);
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "DSRRouteManagerImpl::SPFIntraAddRouter (): "
+                 "Expected valid LSA in DSRVertex* v");
+  Ipv4Mask tempmask (l->GetLinkData ().Get ());
+  Ipv4Address tempip = l->GetLinkId ();
+  tempip = tempip.CombineMask (tempmask);
 //
 // Here's why we did all of that work.  We're going to add a host route to the
 // host address found in the m_linkData field of the point-to-point link
@@ -1975,39 +2977,36 @@ DSRRouteManagerImpl::SPFIntraAddStub (DSRRoutingLinkRecord *l, DSRVertex* v)
 // which the packets should be send for forwarding.
 //
 
-          Ptr<DSRRouter> router = node->GetObject<DSRRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              DSRVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  Ptr<DSRRouter> router = node->GetObject<DSRRouter> ();
+  if (router == 0)
+    {
+      return;
+    }
+  Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
+  NS_ASSERT (gr);
+  // walk through all next-hop-IPs and out-going-interfaces for reaching
+  // the stub network gateway 'v' from the root node
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      DSRVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
+      if (outIf >= 0)
+        {
+          gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
+                        " add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
+        }
+      else
+        {
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative");
+        }
+    }
 }
 
 //
@@ -2031,61 +3030,40 @@ DSRRouteManagerImpl::FindOutgoingInterfaceId (Ipv4Address a, Ipv4Mask amask)
 //
   Ipv4Address routerId = m_spfroot->GetVertexId ();
 //
-// Walk the list of nodes in the system looking for the one corresponding to
-// the node at the root of the SPF tree.  This is the node for which we are
-// building the routing table.
+// Look up the node at the root of the SPF tree in the router index.  This
+// is the node for which we are building the routing table.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  Ptr<Node> node = GetRouterNode (routerId);
+  if (node == 0)
     {
-      Ptr<Node> node = *i;
-
-      Ptr<DSRRouter> rtr = 
-        node->GetObject<DSRRouter> ();
-//
-// If the node doesn't have a DSRRouter interface it can't be the one
-// we're interested in.
-//
-      if (rtr == 0)
-        {
-          continue;
-        }
-
-      if (rtr->GetRouterId () == routerId)
-        {
+      NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << routerId);
+      return -1;
+    }
 //
 // This is the node we're building the routing table for.  We're going to need
 // the Ipv4 interface to look for the ipv4 interface index.  Since this node
 // is participating in routing IP version 4 packets, it certainly must have 
 // an Ipv4 interface.
 //
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "DSRRouteManagerImpl::FindOutgoingInterfaceId (): "
-                         "GetObject for <Ipv4> interface failed");
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  NS_ASSERT_MSG (ipv4, 
+                 "DSRRouteManagerImpl::FindOutgoingInterfaceId (): "
+                 "GetObject for <Ipv4> interface failed");
 //
 // Look through the interfaces on this node for one that has the IP address
 // we're looking for.  If we find one, return the corresponding interface
 // index, or -1 if not found.
 //
-          int32_t interface = ipv4->GetInterfaceForPrefix (a, amask);
+  int32_t interface = ipv4->GetInterfaceForPrefix (a, amask);
 
 #if 0
-          if (interface < 0)
-            {
-              NS_FATAL_ERROR ("DSRRouteManagerImpl::FindOutgoingInterfaceId(): "
-                              "Expected an interface associated with address a:" << a);
-            }
-#endif 
-          return interface;
-        }
+  if (interface < 0)
+    {
+      NS_FATAL_ERROR ("DSRRouteManagerImpl::FindOutgoingInterfaceId(): "
+                      "Expected an interface associated with address a:" << a);
     }
-//
-// Couldn't find it.
-//
-  NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << routerId);
-  return -1;
+#endif 
+  return interface;
 }
 
 //
@@ -2128,63 +3106,38 @@ DSRRouteManagerImpl::SPFIntraAddRouter (DSRVertex* v, DSRVertex* v_init, Ipv4Add
   NS_LOG_LOGIC ("Vertex ID = " << routerId);
 
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// Look up the node that has the router ID corresponding to the root vertex
+// in the router index.  This is the one we're going to write the routing
+// information to.
 //
-
-  NodeList::Iterator listEnd = NodeList::End ();
-  NodeList::Iterator i = NodeList::Begin (); 
-  
-  for (; i != listEnd; i++)
+  Ptr<Node> node = GetRouterNode (routerId_init);
+  if (node == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<DSRRouter> rtr = 
-        node->GetObject<DSRRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-        // std::cout << "The neighbour node " << node->GetId () << std::endl;
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId_init)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
+      NS_LOG_LOGIC ("No router with ID " << routerId_init);
+      return;
+    }
+  NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
 //
 // Routing information is updated using the Ipv4 interface.  We need to 
 // GetObject for that interface.  If the node is acting as an IP version 4 
 // router, it should absolutely have an Ipv4 interface.
 //
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "DSRRouteManagerImpl::SPFIntraAddRouter (): "
-                         "GetObject for <Ipv4> interface failed");
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  NS_ASSERT_MSG (ipv4, 
+                 "DSRRouteManagerImpl::SPFIntraAddRouter (): "
+                 "GetObject for <Ipv4> interface failed");
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          DSRRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "DSRRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in DSRVertex* v");
+  DSRRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "DSRRouteManagerImpl::SPFIntraAddRouter (): "
+                 "Expected valid LSA in DSRVertex* v");
 
-          uint32_t nLinkRecords = lsa->GetNLinkRecords ();
+  uint32_t nLinkRecords = lsa->GetNLinkRecords ();
 //
 // Iterate through the link records on the vertex to which we're going to add
 // routes.  To make sure we're being clear, we're going to add routing table
@@ -2193,33 +3146,33 @@ DSRRouteManagerImpl::SPFIntraAddRouter (DSRVertex* v, DSRVertex* v_init, Ipv4Add
 // the local side of the point-to-point links found on the node described by
 // the vertex <v>.
 //
-          NS_LOG_LOGIC (" Node " << node->GetId () <<
-                        " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
-          for (uint32_t j = 0; j < nLinkRecords; ++j)
-            {
+  NS_LOG_LOGIC (" Node " << node->GetId () <<
+                " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
+  for (uint32_t j = 0; j < nLinkRecords; ++j)
+    {
 //
 // We are only concerned about point-to-point links
 //
-              DSRRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
-              if (lr->GetLinkType () != DSRRoutingLinkRecord::PointToPoint)
-                {
-                  continue;
-                }
-              Ptr<DSRRouter> router = node->GetObject<DSRRouter> ();
-              if (router == 0)
-                {
-                  continue;
-                }
-              Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
-              NS_ASSERT (gr);
-              uint32_t distance = v->GetDistanceFromRoot ();
-              gr->AddHostRouteTo (lr->GetLinkData (), nextHop, Iface, distance);
-            }
-//
-// Done adding the routes for the selected node.
-//
+      DSRRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != DSRRoutingLinkRecord::PointToPoint)
+        {
+          continue;
+        }
+      Ptr<DSRRouter> router = node->GetObject<DSRRouter> ();
+      if (router == 0)
+        {
+          continue;
+        }
+      Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
+      NS_ASSERT (gr);
+      uint32_t distance = v->GetDistanceFromRoot ();
+      if (m_routerRoutes)
+        {
+          // one route towards the router ID stands for all its addresses
+          gr->AddHostRouteTo (v->GetVertexId (), nextHop, Iface, distance);
           return;
         }
+      gr->AddHostRouteTo (lr->GetLinkData (), nextHop, Iface, distance);
     }
 }
 void
@@ -2240,95 +3193,71 @@ DSRRouteManagerImpl::SPFIntraAddTransit (DSRVertex* v)
 
   NS_LOG_LOGIC ("Vertex ID = " << routerId);
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// Look up the node that has the router ID corresponding to the root vertex
+// in the router index.  This is the one we're going to write the routing
+// information to.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  Ptr<Node> node = GetRouterNode (routerId);
+  if (node == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the DSRRouter interface, so we need
-// to GetObject for that interface.  If there's no DSRRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<DSRRouter> rtr = 
-        node->GetObject<DSRRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No DSRRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("setting routes for node " << node->GetId ());
+      NS_LOG_LOGIC ("No router with ID " << routerId);
+      return;
+    }
+  NS_LOG_LOGIC ("setting routes for node " << node->GetId ());
 //
 // Routing information is updated using the Ipv4 interface.  We need to 
 // GetObject for that interface.  If the node is acting as an IP version 4 
 // router, it should absolutely have an Ipv4 interface.
 //
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "DSRRouteManagerImpl::SPFIntraAddTransit (): "
-                         "GetObject for <Ipv4> interface failed");
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  NS_ASSERT_MSG (ipv4, 
+                 "DSRRouteManagerImpl::SPFIntraAddTransit (): "
+                 "GetObject for <Ipv4> interface failed");
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          DSRRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "DSRRouteManagerImpl::SPFIntraAddTransit (): "
-                         "Expected valid LSA in DSRVertex* v");
-          Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = lsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-          Ptr<DSRRouter> router = node->GetObject<DSRRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all available exit directions due to ECMP,
-          // and add host route for each of the exit direction toward
-          // the vertex 'v'
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              DSRVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
+  DSRRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "DSRRouteManagerImpl::SPFIntraAddTransit (): "
+                 "Expected valid LSA in DSRVertex* v");
+  Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = lsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
+  Ptr<DSRRouter> router = node->GetObject<DSRRouter> ();
+  if (router == 0)
+    {
+      return;
+    }
+  Ptr<Ipv4DSRRouting> gr = router->GetRoutingProtocol ();
+  NS_ASSERT (gr);
+  // walk through all available exit directions due to ECMP,
+  // and add host route for each of the exit direction toward
+  // the vertex 'v'
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      DSRVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
 
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative " << outIf);
-                }
-            }
+      if (outIf >= 0)
+        {
+          gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
+                        " add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
         }
-    } 
+      else
+        {
+          NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative " << outIf);
+        }
+    }
 }
 
 // Derived from quagga ospf_vertex_add_parents ()
@@ -27,10 +27,15 @@
 #include <queue>
 #include <map>
 #include <vector>
+#include <unordered_map>
 #include "ns3/object.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
 #include "dsr-router-interface.h"
+#include "dsr-spf-graph.h"
 
 namespace ns3 {
 
@@ -612,6 +617,18 @@ public:
  */
   void Insert (Ipv4Address addr, DSRRoutingLSA* lsa);
 
+/**
+ * @brief Replace the router or network Link State Advertisement stored
+ * under an address.
+ *
+ * The previous LSA is deleted.
+ *
+ * @param addr The IP address associated with the LSA.  Typically the Router
+ * ID.
+ * @param lsa A pointer to the new Link State Advertisement.
+ */
+  void Replace (Ipv4Address addr, DSRRoutingLSA* lsa);
+
 /**
  * @brief Look up the Link State Advertisement associated with the given
  * link state ID (address).
@@ -674,6 +691,14 @@ public:
    */
   uint32_t GetNumExtLSAs () const;
 
+  /**
+   * @brief Get the router and network Link State Advertisements.
+   *
+   * @param lsas the vector to which the LSAs are appended, in link state ID
+   * order
+   */
+  void GetLSAs (std::vector<DSRRoutingLSA*> &lsas) const;
+
 
 private:
   typedef std::map<Ipv4Address, DSRRoutingLSA*> LSDBMap_t; //!< container of IPv4 addresses / Link State Advertisements
@@ -827,6 +852,32 @@ public:
  */
   virtual void InitializeRoutes ();
 
+/**
+ * @brief Bring the routes up to date after an interface or address change
+ * on some nodes, recomputing only what the change reaches.
+ * @param nodes the nodes whose interfaces or addresses changed
+ */
+  virtual void UpdateRoutes (NodeContainer nodes);
+
+/**
+ * @brief Coalesce a route update request with the others of its window.
+ * @param node the node whose interfaces or addresses changed
+ * @param delay the time to wait for more changes
+ * @param holdTime the minimum time between two route updates
+ * @see DSRRouteManager::ScheduleUpdate
+ */
+  void ScheduleUpdate (Ptr<Node> node, Time delay, Time holdTime);
+
+/**
+ * @returns the number of ScheduleUpdate calls
+ */
+  uint64_t GetNUpdateTriggers (void) const;
+
+/**
+ * @returns the number of route updates the ScheduleUpdate calls ran
+ */
+  uint64_t GetNUpdates (void) const;
+
 /**
  * @brief Debugging routine; allow client code to supply a pre-built LSDB
  */
@@ -861,6 +912,257 @@ private:
   DSRVertex* m_spfroot; //!< the root node
   DSRRouteManagerLSDB* m_lsdb; //!< the Link State DataBase (LSDB) of the Global Route Manager
 
+  /**
+   * \brief The routers of one SPF tree, kept to install the routes of every
+   * router bordering its root.
+   */
+  struct DsrSpfTree
+  {
+    DsrSpfTree ();
+    bool stub;  //!< the calculation was truncated because the root is a stub
+    /// LSA and distance from the root of every router, in the order they joined the tree
+    std::vector<std::pair<DSRRoutingLSA *, uint32_t> > routers;
+  };
+  /// SPF trees keyed by the router ID of their root
+  typedef std::unordered_map<uint32_t, DsrSpfTree> DsrSpfTrees;
+
+  DsrSpfTrees m_spfTrees;  //!< trees computed by the running InitializeRoutes
+  DsrSpfTree *m_spfTree;   //!< tree recorded by the running SPFCalculate, if any
+  DsrSpfGraph m_spfGraph;  //!< snapshot of the LSDB built by BuildDSRRoutingDatabase
+  DsrSpfResult m_spfResult; //!< working state of the serial SPF calculations
+  std::vector<DsrSpfPaths> m_spfPaths; //!< SPF paths by root vertex
+  std::vector<uint8_t> m_spfPathsReady; //!< which entries of m_spfPaths are computed
+  std::vector<uint32_t> m_spfPathsUses; //!< uses of each entry of m_spfPaths left in the route build
+  std::vector<uint32_t> m_spfCalls;     //!< point-to-point links into each vertex from the routers of this system
+  bool m_keepSpfPaths;                  //!< m_spfPaths outlives the route build, for UpdateRoutes
+
+  /// nodes by the first address of each of their interfaces, once per interface, in NodeList order
+  std::unordered_map<uint32_t, std::vector<Ptr<Node> > > m_addressIndex;
+  std::unordered_map<uint32_t, Ptr<Node> > m_routerIndex; //!< routers by router ID
+  bool m_routerRoutes; //!< value of "DsrRouterRoutes" when the index was built
+
+  EventId m_updateEvent;         //!< route update of the open window
+  NodeContainer m_updateNodes;   //!< nodes whose events the open window collects
+  uint32_t m_updateTriggers;     //!< events the open window collects
+  Time m_lastUpdate;             //!< start of the last scheduled route update
+  uint64_t m_nUpdateTriggers;    //!< ScheduleUpdate calls
+  uint64_t m_nUpdates;           //!< route updates run by ScheduleUpdate
+
+  /**
+   * \brief Run the route update of the open window and close it.
+   */
+  void RunScheduledUpdate (void);
+
+  /**
+   * \return the value of the "DsrSpfPerRouter" global value
+   */
+  static bool SpfPerRouter (void);
+
+  /**
+   * \return the value of the "DsrSpfGraph" global value
+   */
+  static bool UseSpfGraph (void);
+
+  /**
+   * \return the value of the "DsrRouterRoutes" global value
+   */
+  static bool RouterRoutes (void);
+
+  /**
+   * \return the number of threads set by the "DsrSpfThreads" global value
+   */
+  static uint32_t SpfThreads (void);
+
+  /**
+   * \return true if a router recomputes its routes on interface events
+   */
+  static bool RespondToInterfaceEvents (void);
+
+  /**
+   * \brief Compare two LSAs field by field.
+   * \param a an LSA
+   * \param b another LSA
+   * \return true if the LSAs advertise the same links
+   */
+  static bool SameLSA (const DSRRoutingLSA &a, const DSRRoutingLSA &b);
+
+  /**
+   * \brief Compute and install the routes over m_spfGraph.
+   *
+   * Installs the same routes, in the same order on every router, as the
+   * per-link loop of InitializeRoutes running the DSRVertex SPF.
+   *
+   * \param perRouter true for the "DsrSpfPerRouter" route build
+   */
+  void InitializeGraphRoutes (bool perRouter);
+
+  /**
+   * \brief Count the point-to-point links into each vertex of m_spfGraph
+   * from the routers of this system.
+   *
+   * The route build runs one SPF rooted at the far end of each of those
+   * links.
+   *
+   * \param calls the counts, by vertex
+   */
+  void CountSpfCalls (std::vector<uint32_t> &calls) const;
+
+  /**
+   * \param v a vertex of m_spfGraph
+   * \return true if the route build needs the SPF paths rooted at the vertex
+   */
+  bool NeedsSpfPaths (uint32_t v) const;
+
+  /**
+   * \brief Compute the paths of a set of roots into m_spfPaths.
+   *
+   * The workers only read m_spfGraph and each writes the m_spfPaths entries
+   * of the roots it took.  No route is installed here, so the routes and
+   * their order do not depend on the number of threads.
+   *
+   * \param roots the root vertices
+   * \param nThreads the number of worker threads
+   */
+  void SPFComputePaths (const std::vector<uint32_t> &roots, uint32_t nThreads);
+
+  /**
+   * \brief Drop the SPF paths and the link counts of the last route build.
+   */
+  void ClearSpfPaths (void);
+
+  /**
+   * \brief Get the SPF paths rooted at a vertex, computing them on first use.
+   * \param root the root vertex
+   * \return the paths
+   */
+  const DsrSpfPaths &GetSpfPaths (uint32_t root);
+
+  /**
+   * \brief Note one use of the SPF paths rooted at a vertex, freeing them
+   * after the last use unless they are kept for UpdateRoutes.
+   * \param root the root vertex
+   */
+  void ReleaseSpfPaths (uint32_t root);
+
+  /**
+   * \brief Install on a router the host routes to and through its
+   * point-to-point neighbors.
+   *
+   * The routes are those the per-link loop of InitializeRoutes adds to the
+   * router, in the same order, taken from the SPF paths of the neighbors.
+   *
+   * \param node the router
+   */
+  void SPFAddNeighborRoutes (Ptr<Node> node);
+
+  /**
+   * \brief Index the nodes by interface address and the routers by router ID.
+   *
+   * Called before the routes are computed, so that the lookups of the route
+   * build are hash lookups instead of walks of the node list.  With
+   * "DsrRouterRoutes", also maps the addresses of the routers to their
+   * router ID; see Ipv4DSRRouting::AddRouterAddress.
+   */
+  void BuildNodeIndex (void);
+
+  /**
+   * \brief Find the router with a router ID in the index.
+   * \param routerId the router ID
+   * \return the node of the router, or 0 if there is none
+   */
+  Ptr<Node> GetRouterNode (Ipv4Address routerId) const;
+
+  /**
+   * \brief Have every indexed router start building a new routing table.
+   * \see Ipv4DSRRouting::BeginRouteTable
+   */
+  void BeginRouteTables (void);
+
+  /**
+   * \brief Swap in the routing tables built since BeginRouteTables.
+   * \see Ipv4DSRRouting::CommitRouteTable
+   */
+  void CommitRouteTables (void);
+
+  /**
+   * \brief Install on a router the host routes to the addresses of the
+   * nodes owning an address.
+   *
+   * Every interface but the loopback of every node with an interface whose
+   * first address is linkData gets a host route through linkData.  With
+   * "DsrRouterRoutes", a router gets one host route towards its router ID
+   * instead.
+   *
+   * \param gr the routing protocol of the router
+   * \param linkData the address of the neighbor on the link
+   * \param Iface the interface of the router on the link
+   * \param metric the metric of the link
+   */
+  void SPFAddAddressRoutes (Ptr<Ipv4DSRRouting> gr, Ipv4Address linkData,
+                            int32_t Iface, uint32_t metric);
+
+  /**
+   * \brief Install on a router the host routes to a router of its SPF tree.
+   *
+   * One route per point-to-point link record of the LSA, towards the local
+   * address of the link, or with "DsrRouterRoutes" a single route towards
+   * the router ID.
+   *
+   * \param gr the routing protocol of the router
+   * \param lsa the router LSA of the destination
+   * \param nextHop the next hop towards the destination
+   * \param Iface the outgoing interface
+   * \param distance the distance to the destination
+   */
+  void SPFAddRouterRoutes (Ptr<Ipv4DSRRouting> gr, DSRRoutingLSA *lsa,
+                           Ipv4Address nextHop, uint32_t Iface, uint32_t distance);
+
+  /**
+   * \brief Install on a router the routes the SPF calculations rooted at it
+   * add: the stub, external and default routes.
+   *
+   * \param root the vertex of the router
+   * \param perRouter true to install them once, false to install them once
+   * per point-to-point link into the router, as the per-link loop does
+   */
+  void SPFAddRootRoutes (uint32_t root, bool perRouter);
+
+  /**
+   * \brief Apply an interface or address change incrementally.
+   *
+   * Rediscovers the LSAs of the nodes and of their neighbors, recomputes
+   * the kept SPF paths the changed edges can reach and reinstalls, through
+   * Ipv4DSRRouting::BeginRouteUpdate, the routes of the routers whose
+   * inputs changed.
+   *
+   * \param nodes the nodes whose interfaces or addresses changed
+   * \return false if the change needs a full route build
+   */
+  bool UpdateGraphRoutes (NodeContainer nodes);
+
+  /**
+   * \brief Get the SPF tree rooted at a router, computing it on first use.
+   * \param root the router ID of the root
+   * \return the tree
+   */
+  const DsrSpfTree &GetSpfTree (Ipv4Address root);
+
+  /**
+   * \brief Install on a router the host routes leading through one of its
+   * point-to-point neighbors.
+   *
+   * The routes are those SPFCalculate (neighbor, router, link, Iface) would
+   * add, in the same order, taken from the SPF tree of the neighbor.
+   *
+   * \param tree the SPF tree rooted at the neighbor
+   * \param gr the routing protocol of the router
+   * \param nextHop the address of the neighbor on the link
+   * \param Iface the interface of the router on the link
+   * \param metric the metric of the link, as announced by the neighbor
+   */
+  void SPFIntraAddNeighborTree (const DsrSpfTree &tree, Ptr<Ipv4DSRRouting> gr,
+                                Ipv4Address nextHop, uint32_t Iface, uint32_t metric);
+
   /**
    * \brief Test if a node is a stub, from an OSPF sense.
    *
@@ -877,7 +1179,15 @@ private:
    * \brief Calculate the shortest path first (SPF) tree
    *
    * Equivalent to quagga ospf_spf_calculate
+   *
+   * When m_spfTree is set, the routers joining the tree are recorded there
+   * instead of being installed on initroot.
+   *
    * \param root the root node
+   * \param initroot the router whose routing table is written
+   * \param l the link record of root towards initroot, or 0 to start at
+   * distance 0
+   * \param Iface the interface of initroot towards root
    */
   void SPFCalculate (Ipv4Address root, Ipv4Address initroot, DSRRoutingLinkRecord *l, uint32_t Iface);
 
@@ -58,6 +58,38 @@ DSRRouteManager::InitializeRoutes (void)
   InitializeRoutes ();
 }
 
+void
+DSRRouteManager::UpdateRoutes (NodeContainer nodes)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  SimulationSingleton<DSRRouteManagerImpl>::Get ()->
+  UpdateRoutes (nodes);
+}
+
+void
+DSRRouteManager::ScheduleUpdate (Ptr<Node> node, Time delay, Time holdTime)
+{
+  NS_LOG_FUNCTION (node << delay << holdTime);
+  SimulationSingleton<DSRRouteManagerImpl>::Get ()->
+  ScheduleUpdate (node, delay, holdTime);
+}
+
+uint64_t
+DSRRouteManager::GetNUpdateTriggers (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  return SimulationSingleton<DSRRouteManagerImpl>::Get ()->
+         GetNUpdateTriggers ();
+}
+
+uint64_t
+DSRRouteManager::GetNUpdates (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  return SimulationSingleton<DSRRouteManagerImpl>::Get ()->
+         GetNUpdates ();
+}
+
 uint32_t
 DSRRouteManager::AllocateRouterId (void)
 {
@@ -22,6 +22,9 @@
 #ifndef DSR_ROUTE_MANAGER_H
 #define DSR_ROUTE_MANAGER_H
 
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+
 namespace ns3 {
 
 /**
@@ -65,6 +68,44 @@ public:
  */
   static void InitializeRoutes ();
 
+/**
+ * @brief Bring the routes up to date after an interface or address change
+ * on some nodes.
+ *
+ * Only the LSAs of the nodes and of their neighbors are discovered again,
+ * and only the SPF trees and the routing tables the change reaches are
+ * recomputed.  Falls back to DeleteDSRRoutes, BuildDSRRoutingDatabase and
+ * InitializeRoutes when the change cannot be applied incrementally.
+ *
+ * @param nodes the nodes whose interfaces or addresses changed
+ */
+  static void UpdateRoutes (NodeContainer nodes);
+
+/**
+ * @brief Ask for a route update after an interface or address change on
+ * a node.
+ *
+ * The requests are coalesced the way OSPF throttles its SPF runs: the first
+ * request of a window schedules one UpdateRoutes call, delay later but no
+ * sooner than holdTime after the start of the previous one, and the
+ * requests arriving until it runs only add their node to it.
+ *
+ * @param node the node whose interfaces or addresses changed
+ * @param delay the time to wait for more changes
+ * @param holdTime the minimum time between two route updates
+ */
+  static void ScheduleUpdate (Ptr<Node> node, Time delay, Time holdTime);
+
+/**
+ * @returns the number of ScheduleUpdate calls
+ */
+  static uint64_t GetNUpdateTriggers ();
+
+/**
+ * @returns the number of route updates the ScheduleUpdate calls ran
+ */
+  static uint64_t GetNUpdates ();
+
 private:
 /**
  * @brief Global Route Manager copy construction is disallowed.  There's no 
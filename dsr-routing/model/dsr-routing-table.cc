@@ -0,0 +1,440 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "dsr-routing-table.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DsrRoutingTable");
+
+const uint32_t DsrRoutingTable::NO_ROUTE;
+
+DsrRoutingTable::DsrRoutingTable ()
+{
+  NS_LOG_FUNCTION (this);
+  Clear ();
+}
+
+DsrRoutingTable::~DsrRoutingTable ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DsrRoutingTable::AddHostRoute (const Ipv4DSRRoutingTableEntry &route)
+{
+  NS_ASSERT (route.IsHost ());
+  Log (HOST, route);
+}
+
+void
+DsrRoutingTable::AddNetworkRoute (const Ipv4DSRRoutingTableEntry &route)
+{
+  Log (NETWORK, route);
+}
+
+void
+DsrRoutingTable::AddASExternalRoute (const Ipv4DSRRoutingTableEntry &route)
+{
+  Log (AS_EXTERNAL, route);
+}
+
+void
+DsrRoutingTable::Log (uint8_t kind, const Ipv4DSRRoutingTableEntry &route)
+{
+  uint32_t address = route.GetDest ().Get ();
+  uint32_t mask = route.GetDestNetworkMask ().Get ();
+  uint32_t next = m_destKind.size ();
+  uint32_t dest;
+  if (kind == HOST)
+    {
+      dest = m_hostDests.insert (std::make_pair (address, next)).first->second;
+    }
+  else
+    {
+      uint64_t key = (static_cast<uint64_t> (address) << 32) | mask;
+      dest = m_prefixDests[kind - 1].insert (std::make_pair (key, next)).first->second;
+    }
+  if (dest == next)
+    {
+      m_destKind.push_back (kind);
+      m_destAddress.push_back (address);
+      m_destMask.push_back (mask);
+    }
+  m_logDest.push_back (dest);
+  m_logGateway.push_back (route.GetGateway ().Get ());
+  m_logInterface.push_back (route.GetInterface ());
+  m_logDistance.push_back (route.GetDistance ());
+}
+
+bool
+DsrRoutingTable::IsSealed (void) const
+{
+  return m_logDest.empty ();
+}
+
+void
+DsrRoutingTable::Seal (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (IsSealed ())
+    {
+      return;
+    }
+  uint32_t nDests = m_destKind.size ();
+  uint32_t nSealed = m_routeDest.size ();
+  uint32_t nRoutes = nSealed + m_logDest.size ();
+//
+// Counting sort of the sealed routes followed by the logged ones on their
+// destination, which keeps the order of the routes of each destination.
+//
+  std::vector<uint32_t> first (nDests + 1, 0);
+  for (uint32_t r = 0; r < nSealed; r++)
+    {
+      first[m_routeDest[r] + 1]++;
+    }
+  for (uint32_t r = 0; r < m_logDest.size (); r++)
+    {
+      first[m_logDest[r] + 1]++;
+    }
+  for (uint32_t d = 0; d < nDests; d++)
+    {
+      first[d + 1] += first[d];
+    }
+  std::vector<uint32_t> next (first.begin (), first.end () - 1);
+  std::vector<uint32_t> routeDest (nRoutes);
+  std::vector<uint32_t> routeGateway (nRoutes);
+  std::vector<uint32_t> routeInterface (nRoutes);
+  std::vector<uint32_t> routeDistance (nRoutes);
+  for (uint32_t r = 0; r < nSealed; r++)
+    {
+      uint32_t i = next[m_routeDest[r]]++;
+      routeDest[i] = m_routeDest[r];
+      routeGateway[i] = m_routeGateway[r];
+      routeInterface[i] = m_routeInterface[r];
+      routeDistance[i] = m_routeDistance[r];
+    }
+  for (uint32_t r = 0; r < m_logDest.size (); r++)
+    {
+      uint32_t i = next[m_logDest[r]]++;
+      routeDest[i] = m_logDest[r];
+      routeGateway[i] = m_logGateway[r];
+      routeInterface[i] = m_logInterface[r];
+      routeDistance[i] = m_logDistance[r];
+    }
+  m_destFirst.swap (first);
+  m_routeDest.swap (routeDest);
+  m_routeGateway.swap (routeGateway);
+  m_routeInterface.swap (routeInterface);
+  m_routeDistance.swap (routeDistance);
+  std::vector<uint32_t> ().swap (m_logDest);
+  std::vector<uint32_t> ().swap (m_logGateway);
+  std::vector<uint32_t> ().swap (m_logInterface);
+  std::vector<uint32_t> ().swap (m_logDistance);
+
+  m_bestRoute.assign (nDests, NO_ROUTE);
+  m_prefixTries[0].Clear ();
+  m_prefixTries[1].Clear ();
+  std::fill (m_nRoutes, m_nRoutes + KINDS, 0);
+  for (uint32_t d = 0; d < nDests; d++)
+    {
+      UpdateBestRoute (d);
+      m_nRoutes[m_destKind[d]] += m_destFirst[d + 1] - m_destFirst[d];
+      if (m_destKind[d] != HOST)
+        {
+          m_prefixTries[m_destKind[d] - 1].Insert (Ipv4Address (m_destAddress[d]), Ipv4Mask (m_destMask[d]), d);
+        }
+    }
+  NS_LOG_LOGIC ("Sealed " << nRoutes << " routes towards " << nDests << " destinations");
+}
+
+void
+DsrRoutingTable::UpdateBestRoute (uint32_t dest)
+{
+  // keep the first shortest route, as the linear scan of the lookup did
+  uint32_t best = NO_ROUTE;
+  for (uint32_t r = m_destFirst[dest]; r < m_destFirst[dest + 1]; r++)
+    {
+      if (best == NO_ROUTE || m_routeDistance[r] < m_routeDistance[best])
+        {
+          best = r;
+        }
+    }
+  m_bestRoute[dest] = best;
+}
+
+void
+DsrRoutingTable::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  std::vector<uint8_t> ().swap (m_destKind);
+  std::vector<uint32_t> ().swap (m_destAddress);
+  std::vector<uint32_t> ().swap (m_destMask);
+  std::vector<uint32_t> (1, 0).swap (m_destFirst);
+  std::vector<uint32_t> ().swap (m_bestRoute);
+  m_hostDests.clear ();
+  m_prefixDests[0].clear ();
+  m_prefixDests[1].clear ();
+  m_prefixTries[0].Clear ();
+  m_prefixTries[1].Clear ();
+  std::fill (m_nRoutes, m_nRoutes + KINDS, 0);
+  std::vector<uint32_t> ().swap (m_routeDest);
+  std::vector<uint32_t> ().swap (m_routeGateway);
+  std::vector<uint32_t> ().swap (m_routeInterface);
+  std::vector<uint32_t> ().swap (m_routeDistance);
+  std::vector<uint32_t> ().swap (m_logDest);
+  std::vector<uint32_t> ().swap (m_logGateway);
+  std::vector<uint32_t> ().swap (m_logInterface);
+  std::vector<uint32_t> ().swap (m_logDistance);
+}
+
+uint32_t
+DsrRoutingTable::GetNRoutes (void) const
+{
+  return m_routeDest.size ();
+}
+
+uint32_t
+DsrRoutingTable::GetNHostRoutes (void) const
+{
+  return m_nRoutes[HOST];
+}
+
+uint32_t
+DsrRoutingTable::GetNNetworkRoutes (void) const
+{
+  return m_nRoutes[NETWORK];
+}
+
+uint32_t
+DsrRoutingTable::GetNASExternalRoutes (void) const
+{
+  return m_nRoutes[AS_EXTERNAL];
+}
+
+Ipv4Address
+DsrRoutingTable::GetDest (uint32_t route) const
+{
+  return Ipv4Address (m_destAddress[m_routeDest[route]]);
+}
+
+Ipv4Address
+DsrRoutingTable::GetGateway (uint32_t route) const
+{
+  return Ipv4Address (m_routeGateway[route]);
+}
+
+uint32_t
+DsrRoutingTable::GetInterface (uint32_t route) const
+{
+  return m_routeInterface[route];
+}
+
+uint32_t
+DsrRoutingTable::GetDistance (uint32_t route) const
+{
+  return m_routeDistance[route];
+}
+
+Ipv4DSRRoutingTableEntry
+DsrRoutingTable::GetRoute (uint32_t route) const
+{
+  NS_LOG_FUNCTION (this << route);
+  NS_ASSERT (route < m_routeDest.size ());
+  uint32_t dest = m_routeDest[route];
+  Ipv4Mask mask (m_destMask[dest]);
+  if (mask == Ipv4Mask::GetOnes ())
+    {
+      return Ipv4DSRRoutingTableEntry::CreateHostRouteTo (Ipv4Address (m_destAddress[dest]),
+                                                        Ipv4Address (m_routeGateway[route]),
+                                                        m_routeInterface[route],
+                                                        m_routeDistance[route]);
+    }
+  // network routes are always added without a distance
+  return Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address (m_destAddress[dest]), mask,
+                                                       Ipv4Address (m_routeGateway[route]),
+                                                       m_routeInterface[route]);
+}
+
+void
+DsrRoutingTable::RemoveRoute (uint32_t route)
+{
+  NS_LOG_FUNCTION (this << route);
+  NS_ASSERT (IsSealed ());
+  NS_ASSERT (route < m_routeDest.size ());
+  uint32_t dest = m_routeDest[route];
+  m_routeDest.erase (m_routeDest.begin () + route);
+  m_routeGateway.erase (m_routeGateway.begin () + route);
+  m_routeInterface.erase (m_routeInterface.begin () + route);
+  m_routeDistance.erase (m_routeDistance.begin () + route);
+  m_nRoutes[m_destKind[dest]]--;
+  // an emptied destination stays, without routes
+  for (uint32_t d = dest + 1; d < m_destFirst.size (); d++)
+    {
+      m_destFirst[d]--;
+    }
+  for (uint32_t d = 0; d < m_bestRoute.size (); d++)
+    {
+      if (d == dest)
+        {
+          UpdateBestRoute (d);
+        }
+      else if (m_bestRoute[d] != NO_ROUTE && m_bestRoute[d] > route)
+        {
+          m_bestRoute[d]--;
+        }
+    }
+}
+
+bool
+DsrRoutingTable::SameRoute (const DsrRoutingTable &a, uint32_t i, const DsrRoutingTable &b, uint32_t j)
+{
+  // the distance matters here, unlike in operator== on the entries
+  uint32_t da = a.m_routeDest[i];
+  uint32_t db = b.m_routeDest[j];
+  return a.m_destAddress[da] == b.m_destAddress[db]
+         && a.m_destMask[da] == b.m_destMask[db]
+         && a.m_destKind[da] == b.m_destKind[db]
+         && a.m_routeGateway[i] == b.m_routeGateway[j]
+         && a.m_routeInterface[i] == b.m_routeInterface[j]
+         && a.m_routeDistance[i] == b.m_routeDistance[j];
+}
+
+uint32_t
+DsrRoutingTable::CountChanges (const DsrRoutingTable &other) const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (IsSealed () && other.IsSealed ());
+  uint32_t n = GetNRoutes ();
+  uint32_t m = other.GetNRoutes ();
+  uint32_t head = 0;
+  while (head < n && head < m && SameRoute (*this, head, other, head))
+    {
+      head++;
+    }
+  uint32_t tail = 0;
+  while (tail < n - head && tail < m - head
+         && SameRoute (*this, n - 1 - tail, other, m - 1 - tail))
+    {
+      tail++;
+    }
+  return (n - head - tail) + (m - head - tail);
+}
+
+uint32_t
+DsrRoutingTable::GetCommonHead (const DsrRoutingTable &other) const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (IsSealed () && other.IsSealed ());
+  uint32_t n = GetNRoutes ();
+  uint32_t m = other.GetNRoutes ();
+  uint32_t head = 0;
+  while (head < n && head < m && SameRoute (*this, head, other, head))
+    {
+      head++;
+    }
+  // a destination cut by the head has more routes in one of the tables
+  if (head < n)
+    {
+      head = std::min (head, m_destFirst[m_routeDest[head]]);
+    }
+  if (head < m)
+    {
+      head = std::min (head, other.m_destFirst[other.m_routeDest[head]]);
+    }
+  return head;
+}
+
+bool
+DsrRoutingTable::SameDestinations (const DsrRoutingTable &other) const
+{
+  return m_destKind == other.m_destKind
+         && m_destAddress == other.m_destAddress
+         && m_destMask == other.m_destMask;
+}
+
+uint32_t
+DsrRoutingTable::AppendRoutes (uint32_t dest, int32_t interface, RouteIds &routes) const
+{
+  uint32_t found = 0;
+  for (uint32_t r = m_destFirst[dest]; r < m_destFirst[dest + 1]; r++)
+    {
+      if (interface < 0 || m_routeInterface[r] == static_cast<uint32_t> (interface))
+        {
+          routes.push_back (r);
+          found++;
+        }
+    }
+  return found;
+}
+
+uint32_t
+DsrRoutingTable::LookupHostRoutes (Ipv4Address dest, int32_t interface, RouteIds &routes) const
+{
+  std::unordered_map<uint32_t, uint32_t>::const_iterator i = m_hostDests.find (dest.Get ());
+  if (i == m_hostDests.end () || i->second >= m_bestRoute.size ())
+    {
+      return 0;
+    }
+  return AppendRoutes (i->second, interface, routes);
+}
+
+uint32_t
+DsrRoutingTable::FindBestHostRoute (Ipv4Address dest) const
+{
+  std::unordered_map<uint32_t, uint32_t>::const_iterator i = m_hostDests.find (dest.Get ());
+  if (i == m_hostDests.end () || i->second >= m_bestRoute.size ())
+    {
+      return NO_ROUTE;
+    }
+  return m_bestRoute[i->second];
+}
+
+uint32_t
+DsrRoutingTable::LookupPrefix (const DsrPrefixTrie &trie, Ipv4Address dest, int32_t interface,
+                               RouteIds &routes) const
+{
+  uint32_t ids[DsrPrefixTrie::MAX_MATCHES];
+  uint32_t nMatches = trie.Lookup (dest, ids);
+  for (uint32_t i = 0; i < nMatches; i++)
+    {
+      uint32_t found = AppendRoutes (ids[i], interface, routes);
+      if (found > 0)
+        {
+          return found;
+        }
+      NS_LOG_LOGIC ("No route on requested interface, trying a shorter prefix");
+    }
+  return 0;
+}
+
+uint32_t
+DsrRoutingTable::LookupNetworkRoutes (Ipv4Address dest, int32_t interface, RouteIds &routes) const
+{
+  return LookupPrefix (m_prefixTries[NETWORK - 1], dest, interface, routes);
+}
+
+uint32_t
+DsrRoutingTable::LookupASExternalRoutes (Ipv4Address dest, int32_t interface, RouteIds &routes) const
+{
+  return LookupPrefix (m_prefixTries[AS_EXTERNAL - 1], dest, interface, routes);
+}
+
+} // namespace ns3
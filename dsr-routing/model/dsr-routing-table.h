@@ -0,0 +1,282 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef DSR_ROUTING_TABLE_H
+#define DSR_ROUTING_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include "ns3/ipv4-address.h"
+#include "ipv4-dsr-routing-table-entry.h"
+#include "dsr-prefix-trie.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup dsr
+ *
+ * \brief The host, network and AS external routes of one Ipv4DSRRouting,
+ * with their lookup indexes.
+ *
+ * The routes are kept in parallel arrays (destination, gateway, interface
+ * and distance) grouped by destination, so the routes towards one
+ * destination are contiguous and a lookup reads them without following
+ * pointers.  The destinations are numbered in the order they first appear;
+ * a route is identified by its position, which is also its index in
+ * GetRoute.
+ *
+ * Added routes are appended to a log and only take part in the lookups
+ * once Seal has regrouped them, which costs O(routes).  Building a whole
+ * table then sealing it once is therefore the intended use; see
+ * Ipv4DSRRouting::BeginRouteTable.  Route identifiers stay valid until the
+ * next Seal, RemoveRoute or Clear.
+ */
+class DsrRoutingTable
+{
+public:
+  /// identifiers of routes
+  typedef std::vector<uint32_t> RouteIds;
+  /// no route
+  static const uint32_t NO_ROUTE = 0xffffffff;
+
+  DsrRoutingTable ();
+  ~DsrRoutingTable ();
+
+  /**
+   * \brief Log a host route.
+   * \param route the route
+   */
+  void AddHostRoute (const Ipv4DSRRoutingTableEntry &route);
+
+  /**
+   * \brief Log a network route.
+   * \param route the route
+   */
+  void AddNetworkRoute (const Ipv4DSRRoutingTableEntry &route);
+
+  /**
+   * \brief Log an AS external route.
+   * \param route the route
+   */
+  void AddASExternalRoute (const Ipv4DSRRoutingTableEntry &route);
+
+  /**
+   * \brief Group the logged routes with the others and rebuild the indexes.
+   *
+   * The routes of a destination keep the order they were added in.
+   */
+  void Seal (void);
+
+  /**
+   * \return true if no route was added since the last Seal
+   */
+  bool IsSealed (void) const;
+
+  /**
+   * \brief Remove every route.
+   */
+  void Clear (void);
+
+  /**
+   * \return the number of sealed routes
+   */
+  uint32_t GetNRoutes (void) const;
+
+  /**
+   * \param route a route identifier
+   * \return a copy of the route
+   */
+  Ipv4DSRRoutingTableEntry GetRoute (uint32_t route) const;
+
+  /**
+   * \brief Remove a route; the routes after it shift down by one.
+   * \param route a route identifier
+   */
+  void RemoveRoute (uint32_t route);
+
+  /**
+   * \brief Count the routes that differ between two sealed tables.
+   *
+   * The routes outside the longest common head and tail of the two route
+   * sequences are counted in both tables.
+   *
+   * \param other the other table
+   * \return the number of routes removed or added going from this table
+   * to other
+   */
+  uint32_t CountChanges (const DsrRoutingTable &other) const;
+
+  /**
+   * \brief Find the routes two sealed tables share at their start.
+   *
+   * The head ends on a destination boundary, so each destination inside it
+   * has the same routes, with the same identifiers, in both tables.
+   *
+   * \param other the other table
+   * \return the number of leading routes the two tables have in common
+   */
+  uint32_t GetCommonHead (const DsrRoutingTable &other) const;
+
+  /**
+   * \param other the other table
+   * \return true if both tables hold the same destinations in the same order
+   */
+  bool SameDestinations (const DsrRoutingTable &other) const;
+
+  /**
+   * \brief Append the host routes towards a destination to a vector.
+   * \param dest the destination
+   * \param interface the required outgoing interface, or -1 for any
+   * \param routes the vector receiving the route identifiers
+   * \return the number of routes appended
+   */
+  uint32_t LookupHostRoutes (Ipv4Address dest, int32_t interface, RouteIds &routes) const;
+
+  /**
+   * \param dest a destination
+   * \return the first of the shortest host routes to the destination, or NO_ROUTE
+   */
+  uint32_t FindBestHostRoute (Ipv4Address dest) const;
+
+  /**
+   * \brief Append the network routes of the longest prefix matching a
+   * destination to a vector.
+   *
+   * When interface is not negative, only routes leaving through that
+   * interface are considered, and the longest prefix owning at least one
+   * such route wins.
+   *
+   * \param dest the destination
+   * \param interface the required outgoing interface, or -1 for any
+   * \param routes the vector receiving the route identifiers
+   * \return the number of routes appended
+   */
+  uint32_t LookupNetworkRoutes (Ipv4Address dest, int32_t interface, RouteIds &routes) const;
+
+  /**
+   * \brief Append the AS external routes of the longest prefix matching a
+   * destination to a vector.
+   * \see LookupNetworkRoutes
+   */
+  uint32_t LookupASExternalRoutes (Ipv4Address dest, int32_t interface, RouteIds &routes) const;
+
+  /// \param route a route identifier \return the destination of the route
+  Ipv4Address GetDest (uint32_t route) const;
+  /// \param route a route identifier \return the gateway of the route
+  Ipv4Address GetGateway (uint32_t route) const;
+  /// \param route a route identifier \return the outgoing interface of the route
+  uint32_t GetInterface (uint32_t route) const;
+  /// \param route a route identifier \return the distance of the route
+  uint32_t GetDistance (uint32_t route) const;
+
+  /// \return the number of sealed host routes
+  uint32_t GetNHostRoutes (void) const;
+  /// \return the number of sealed network routes
+  uint32_t GetNNetworkRoutes (void) const;
+  /// \return the number of sealed AS external routes
+  uint32_t GetNASExternalRoutes (void) const;
+
+private:
+  /**
+   * \brief Copy construction is disallowed (not implemented): the prefix
+   * tries own their nodes.
+   * \param table object to copy
+   */
+  DsrRoutingTable (const DsrRoutingTable &table);
+  /**
+   * \brief Assignment is disallowed (not implemented): the prefix tries
+   * own their nodes.
+   * \param table object to assign
+   * \return copied object
+   */
+  DsrRoutingTable &operator= (const DsrRoutingTable &table);
+
+  /// kinds of destinations
+  enum Kind
+  {
+    HOST = 0,
+    NETWORK = 1,
+    AS_EXTERNAL = 2,
+    KINDS = 3
+  };
+
+  /**
+   * \brief Find or create the destination of a route and log the route.
+   * \param kind the kind of the route
+   * \param route the route
+   */
+  void Log (uint8_t kind, const Ipv4DSRRoutingTableEntry &route);
+
+  /**
+   * \brief Append the routes of a destination to a vector.
+   * \param dest the destination identifier
+   * \param interface the required outgoing interface, or -1 for any
+   * \param routes the vector receiving the route identifiers
+   * \return the number of routes appended
+   */
+  uint32_t AppendRoutes (uint32_t dest, int32_t interface, RouteIds &routes) const;
+
+  /**
+   * \brief Append the routes of the longest prefix of a trie owning routes.
+   * \see LookupNetworkRoutes
+   */
+  uint32_t LookupPrefix (const DsrPrefixTrie &trie, Ipv4Address dest, int32_t interface,
+                         RouteIds &routes) const;
+
+  /**
+   * \brief Find the first shortest route of a destination.
+   * \param dest the destination identifier
+   */
+  void UpdateBestRoute (uint32_t dest);
+
+  /**
+   * \param a a table
+   * \param i a route of a
+   * \param b a table
+   * \param j a route of b
+   * \return true if the two routes are identical, distance included
+   */
+  static bool SameRoute (const DsrRoutingTable &a, uint32_t i, const DsrRoutingTable &b, uint32_t j);
+
+  // destinations, in the order they first appeared
+  std::vector<uint8_t> m_destKind;      //!< kind of each destination
+  std::vector<uint32_t> m_destAddress;  //!< address of each destination
+  std::vector<uint32_t> m_destMask;     //!< mask of each destination
+  std::vector<uint32_t> m_destFirst;    //!< first route of each destination, then the route count
+  std::vector<uint32_t> m_bestRoute;    //!< first shortest route of each destination, or NO_ROUTE
+  std::unordered_map<uint32_t, uint32_t> m_hostDests;       //!< host destinations by address
+  std::unordered_map<uint64_t, uint32_t> m_prefixDests[2];  //!< network and external destinations by address and mask
+  DsrPrefixTrie m_prefixTries[2];       //!< longest prefix match on the network and external destinations
+  uint32_t m_nRoutes[KINDS];            //!< sealed routes of each kind
+
+  // sealed routes, grouped by destination
+  std::vector<uint32_t> m_routeDest;      //!< destination of each route
+  std::vector<uint32_t> m_routeGateway;   //!< gateway of each route
+  std::vector<uint32_t> m_routeInterface; //!< outgoing interface of each route
+  std::vector<uint32_t> m_routeDistance;  //!< distance of each route
+
+  // routes added since the last Seal, in order
+  std::vector<uint32_t> m_logDest;      //!< destination of each logged route
+  std::vector<uint32_t> m_logGateway;   //!< gateway of each logged route
+  std::vector<uint32_t> m_logInterface; //!< outgoing interface of each logged route
+  std::vector<uint32_t> m_logDistance;  //!< distance of each logged route
+};
+
+} // Namespace ns3
+
+#endif /* DSR_ROUTING_TABLE_H */
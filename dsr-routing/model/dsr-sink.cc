@@ -19,6 +19,7 @@
 #include "priority-tag.h"
 #include "flag-tag.h"
 #include "timestamp-tag.h"
+#include "dsr-meta-tag.h"
 
 namespace ns3 {
 
@@ -98,9 +99,18 @@ DsrPacketSink::GetAcceptedSockets (void) const
 Time DsrPacketSink::GetDelay(const Ptr<Packet> &p) const
 {
   NS_LOG_FUNCTION (this);
-  TimestampTag txTimeTag;
-  p->FindFirstMatchingByteTag (txTimeTag);
-  Time txTime = txTimeTag.GetTimestamp ();
+  Time txTime;
+  DsrMetaTag metaTag;
+  if (p->PeekPacketTag (metaTag))
+    {
+      txTime = metaTag.GetTimestamp ();
+    }
+  else
+    {
+      TimestampTag txTimeTag;
+      p->FindFirstMatchingByteTag (txTimeTag);
+      txTime = txTimeTag.GetTimestamp ();
+    }
   Time deadline = Simulator::Now() - txTime;
   return deadline;
 }
@@ -0,0 +1,455 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/node.h"
+#include "ns3/ipv4.h"
+#include "dsr-spf-graph.h"
+#include "dsr-router-interface.h"
+#include "dsr-route-manager-impl.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DsrSpfGraph");
+
+namespace {
+
+enum
+{
+  NOT_EXPLORED = 0,
+  CANDIDATE,
+  IN_TREE
+};
+
+/**
+ * \return true if candidate a leaves the heap before candidate b
+ */
+inline bool
+Before (const DsrSpfResult &r, uint32_t a, uint32_t b)
+{
+  if (r.distance[a] != r.distance[b])
+    {
+      return r.distance[a] < r.distance[b];
+    }
+  return r.sequence[a] < r.sequence[b];
+}
+
+inline void
+Place (DsrSpfResult &r, uint32_t slot, uint32_t v)
+{
+  r.heap[slot] = v;
+  r.slot[v] = slot;
+}
+
+void
+SiftUp (DsrSpfResult &r, uint32_t slot)
+{
+  uint32_t v = r.heap[slot];
+  while (slot > 0)
+    {
+      uint32_t parent = (slot - 1) / 4;
+      if (!Before (r, v, r.heap[parent]))
+        {
+          break;
+        }
+      Place (r, slot, r.heap[parent]);
+      slot = parent;
+    }
+  Place (r, slot, v);
+}
+
+void
+SiftDown (DsrSpfResult &r, uint32_t slot)
+{
+  uint32_t n = r.heap.size ();
+  uint32_t v = r.heap[slot];
+  while (true)
+    {
+      uint32_t first = 4 * slot + 1;
+      if (first >= n)
+        {
+          break;
+        }
+      uint32_t best = first;
+      for (uint32_t child = first + 1; child < first + 4 && child < n; child++)
+        {
+          if (Before (r, r.heap[child], r.heap[best]))
+            {
+              best = child;
+            }
+        }
+      if (!Before (r, r.heap[best], v))
+        {
+          break;
+        }
+      Place (r, slot, r.heap[best]);
+      slot = best;
+    }
+  Place (r, slot, v);
+}
+
+uint32_t
+Pop (DsrSpfResult &r)
+{
+  uint32_t top = r.heap.front ();
+  uint32_t last = r.heap.back ();
+  r.heap.pop_back ();
+  if (!r.heap.empty ())
+    {
+      Place (r, 0, last);
+      SiftDown (r, 0);
+    }
+  return top;
+}
+
+} // anonymous namespace
+
+DsrSpfGraph::DsrSpfGraph ()
+  : m_usable (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+DsrSpfGraph::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_lsa.clear ();
+  m_vertex.clear ();
+  m_edgeOffset.clear ();
+  m_edgeTarget.clear ();
+  m_edgeMetric.clear ();
+  m_edgeNextHop.clear ();
+  m_edgeOutIf.clear ();
+  m_usable = false;
+}
+
+void
+DsrSpfGraph::Build (const DSRRouteManagerLSDB &lsdb)
+{
+  NS_LOG_FUNCTION (this << &lsdb);
+  Clear ();
+  m_usable = true;
+
+  std::vector<DSRRoutingLSA *> lsas;
+  lsdb.GetLSAs (lsas);
+  for (std::vector<DSRRoutingLSA *>::const_iterator i = lsas.begin (); i != lsas.end (); i++)
+    {
+      if ((*i)->GetLSType () != DSRRoutingLSA::RouterLSA)
+        {
+          NS_LOG_LOGIC ("LSA " << (*i)->GetLinkStateId () << " is not a router LSA");
+          m_usable = false;
+          continue;
+        }
+      m_vertex[(*i)->GetLinkStateId ().Get ()] = m_lsa.size ();
+      m_lsa.push_back (*i);
+    }
+
+  m_edgeOffset.reserve (m_lsa.size () + 1);
+  for (uint32_t v = 0; v < m_lsa.size (); v++)
+    {
+      m_edgeOffset.push_back (m_edgeTarget.size ());
+      DSRRoutingLSA *lsa = m_lsa[v];
+      Ptr<Ipv4> ipv4 = lsa->GetNode ()->GetObject<Ipv4> ();
+      for (uint32_t j = 0; j < lsa->GetNLinkRecords (); j++)
+        {
+          DSRRoutingLinkRecord *l = lsa->GetLinkRecord (j);
+          if (l->GetLinkType () == DSRRoutingLinkRecord::StubNetwork)
+            {
+              continue;
+            }
+          if (l->GetLinkType () != DSRRoutingLinkRecord::PointToPoint)
+            {
+              NS_LOG_LOGIC ("Router " << lsa->GetLinkStateId () << " has a non point-to-point link");
+              m_usable = false;
+              continue;
+            }
+          uint32_t w = GetVertex (l->GetLinkId ());
+          NS_ASSERT_MSG (w != NO_VERTEX, "DsrSpfGraph: no LSA for router " << l->GetLinkId ());
+//
+// As in SPFNexthopCalculation, the next hop is the link data of the first
+// record of <w> pointing back to <v>.
+//
+          DSRRoutingLSA *wLsa = m_lsa[w];
+          DSRRoutingLinkRecord *linkRemote = 0;
+          for (uint32_t k = 0; k < wLsa->GetNLinkRecords (); k++)
+            {
+              if (wLsa->GetLinkRecord (k)->GetLinkId () == lsa->GetLinkStateId ())
+                {
+                  linkRemote = wLsa->GetLinkRecord (k);
+                  break;
+                }
+            }
+          NS_ASSERT_MSG (linkRemote, "DsrSpfGraph: no link back from " << l->GetLinkId ());
+          m_edgeTarget.push_back (w);
+          m_edgeMetric.push_back (l->GetMetric ());
+          m_edgeNextHop.push_back (linkRemote->GetLinkData ().Get ());
+          m_edgeOutIf.push_back (ipv4 ? ipv4->GetInterfaceForPrefix (l->GetLinkData (),
+                                                                     Ipv4Mask ("255.255.255.255"))
+                                      : -1);
+        }
+    }
+  m_edgeOffset.push_back (m_edgeTarget.size ());
+  NS_LOG_LOGIC ("SPF graph of " << GetNVertices () << " routers and " << GetNEdges () <<
+                " edges, usable " << m_usable);
+}
+
+bool
+DsrSpfGraph::IsUsable (void) const
+{
+  return m_usable;
+}
+
+uint32_t
+DsrSpfGraph::GetNVertices (void) const
+{
+  return m_lsa.size ();
+}
+
+uint32_t
+DsrSpfGraph::GetNEdges (void) const
+{
+  return m_edgeTarget.size ();
+}
+
+uint32_t
+DsrSpfGraph::GetVertex (Ipv4Address routerId) const
+{
+  std::unordered_map<uint32_t, uint32_t>::const_iterator i = m_vertex.find (routerId.Get ());
+  return i == m_vertex.end () ? NO_VERTEX : i->second;
+}
+
+uint32_t
+DsrSpfGraph::GetDegree (uint32_t v) const
+{
+  return m_edgeOffset[v + 1] - m_edgeOffset[v];
+}
+
+DSRRoutingLSA*
+DsrSpfGraph::GetLSA (uint32_t v) const
+{
+  return m_lsa.at (v);
+}
+
+uint32_t
+DsrSpfGraph::GetEdgeBegin (uint32_t v) const
+{
+  return m_edgeOffset[v];
+}
+
+uint32_t
+DsrSpfGraph::GetEdgeEnd (uint32_t v) const
+{
+  return m_edgeOffset[v + 1];
+}
+
+uint32_t
+DsrSpfGraph::GetEdgeTarget (uint32_t e) const
+{
+  return m_edgeTarget[e];
+}
+
+uint32_t
+DsrSpfGraph::GetEdgeMetric (uint32_t e) const
+{
+  return m_edgeMetric[e];
+}
+
+bool
+DsrSpfGraph::SameEdges (const DsrSpfGraph &other, uint32_t v) const
+{
+  uint32_t first = m_edgeOffset[v];
+  uint32_t otherFirst = other.m_edgeOffset[v];
+  uint32_t degree = GetDegree (v);
+  if (other.GetDegree (v) != degree)
+    {
+      return false;
+    }
+  for (uint32_t k = 0; k < degree; k++)
+    {
+      if (m_edgeTarget[first + k] != other.m_edgeTarget[otherFirst + k]
+          || m_edgeMetric[first + k] != other.m_edgeMetric[otherFirst + k]
+          || m_edgeNextHop[first + k] != other.m_edgeNextHop[otherFirst + k]
+          || m_edgeOutIf[first + k] != other.m_edgeOutIf[otherFirst + k])
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+DsrSpfGraph::Reset (DsrSpfResult &result) const
+{
+  uint32_t n = m_lsa.size ();
+  result.order.clear ();
+  result.preorder.clear ();
+  result.distance.assign (n, 0xffffffff);
+  result.state.assign (n, NOT_EXPLORED);
+  result.sequence.assign (n, 0);
+  result.slot.assign (n, 0);
+  result.heap.clear ();
+  result.exits.resize (n);
+  result.parents.resize (n);
+  result.children.resize (n);
+  for (uint32_t v = 0; v < n; v++)
+    {
+      result.exits[v].clear ();
+      result.parents[v].clear ();
+      result.children[v].clear ();
+    }
+}
+
+void
+DsrSpfGraph::Calculate (uint32_t root, DsrSpfResult &result) const
+{
+  // no logging here: the worker threads of the route build run this, and
+  // the ns-3 logging is not thread-safe
+  NS_ASSERT (root < m_lsa.size ());
+  Reset (result);
+  result.root = root;
+  result.distance[root] = 0;
+  result.state[root] = IN_TREE;
+
+  uint64_t sequence = 0;
+  uint32_t v = root;
+  for (;;)
+    {
+      for (uint32_t e = m_edgeOffset[v]; e < m_edgeOffset[v + 1]; e++)
+        {
+          uint32_t w = m_edgeTarget[e];
+          if (result.state[w] == IN_TREE)
+            {
+              continue;
+            }
+          uint32_t distance = result.distance[v] + m_edgeMetric[e];
+          if (result.state[w] == CANDIDATE)
+            {
+              if (result.distance[w] < distance)
+                {
+                  continue;
+                }
+              if (result.distance[w] == distance)
+                {
+                  // equal cost: merge the exits and the parents
+                  std::vector<DsrSpfResult::Exit> &exits = result.exits[w];
+                  if (v == root)
+                    {
+                      exits.push_back (DsrSpfResult::Exit (m_edgeNextHop[e], m_edgeOutIf[e]));
+                    }
+                  else
+                    {
+                      exits.insert (exits.end (), result.exits[v].begin (), result.exits[v].end ());
+                    }
+                  std::sort (exits.begin (), exits.end ());
+                  exits.erase (std::unique (exits.begin (), exits.end ()), exits.end ());
+                  std::vector<uint32_t> &parents = result.parents[w];
+                  if (std::find (parents.begin (), parents.end (), v) == parents.end ())
+                    {
+                      parents.push_back (v);
+                    }
+                  continue;
+                }
+            }
+          // first or shorter path: w takes the exits of v and v as only parent
+          if (v == root)
+            {
+              result.exits[w].assign (1, DsrSpfResult::Exit (m_edgeNextHop[e], m_edgeOutIf[e]));
+            }
+          else
+            {
+              result.exits[w] = result.exits[v];
+            }
+          result.parents[w].assign (1, v);
+          result.distance[w] = distance;
+          result.sequence[w] = sequence++;
+          if (result.state[w] == NOT_EXPLORED)
+            {
+              result.state[w] = CANDIDATE;
+              result.heap.push_back (w);
+              result.slot[w] = result.heap.size () - 1;
+            }
+          SiftUp (result, result.slot[w]);
+        }
+      if (result.heap.empty ())
+        {
+          break;
+        }
+      v = Pop (result);
+      result.state[v] = IN_TREE;
+      result.order.push_back (v);
+      const std::vector<uint32_t> &parents = result.parents[v];
+      for (std::vector<uint32_t>::const_iterator p = parents.begin (); p != parents.end (); p++)
+        {
+          result.children[*p].push_back (v);
+        }
+    }
+  Preorder (result);
+}
+
+void
+DsrSpfGraph::Preorder (DsrSpfResult &result)
+{
+  // the vertices are either in the tree or not explored at this point,
+  // reuse the state to mark the visited ones
+  std::vector<std::pair<uint32_t, uint32_t> > stack;
+  result.preorder.push_back (result.root);
+  stack.push_back (std::make_pair (result.root, 0));
+  while (!stack.empty ())
+    {
+      uint32_t v = stack.back ().first;
+      uint32_t &next = stack.back ().second;
+      if (next == result.children[v].size ())
+        {
+          stack.pop_back ();
+          continue;
+        }
+      uint32_t child = result.children[v][next++];
+      if (result.state[child] != IN_TREE)
+        {
+          continue;
+        }
+      result.state[child] = CANDIDATE;
+      result.preorder.push_back (child);
+      stack.push_back (std::make_pair (child, 0));
+    }
+  for (std::vector<uint32_t>::const_iterator i = result.preorder.begin (); i != result.preorder.end (); i++)
+    {
+      result.state[*i] = IN_TREE;
+    }
+}
+
+void
+DsrSpfGraph::Summarize (const DsrSpfResult &result, DsrSpfPaths &paths)
+{
+  paths.routers = result.order;
+  paths.distance = result.distance;
+  paths.preorder.assign (result.preorder.begin () + 1, result.preorder.end ());
+  paths.exitOffset.clear ();
+  paths.exitOffset.reserve (paths.preorder.size () + 1);
+  paths.exits.clear ();
+  for (std::vector<uint32_t>::const_iterator i = paths.preorder.begin (); i != paths.preorder.end (); i++)
+    {
+      paths.exitOffset.push_back (paths.exits.size ());
+      paths.exits.insert (paths.exits.end (), result.exits[*i].begin (), result.exits[*i].end ());
+    }
+  paths.exitOffset.push_back (paths.exits.size ());
+}
+
+} // namespace ns3
@@ -0,0 +1,228 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef DSR_SPF_GRAPH_H
+#define DSR_SPF_GRAPH_H
+
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+class DSRRoutingLSA;
+class DSRRouteManagerLSDB;
+
+/**
+ * \ingroup dsr
+ *
+ * \brief Working state and output of one DsrSpfGraph::Calculate call.
+ *
+ * All the vectors are indexed by graph vertex.  The object is meant to be
+ * reused from one calculation to the next so that the vectors keep their
+ * capacity.
+ */
+struct DsrSpfResult
+{
+  /// a way out of the root: next hop address and outgoing interface
+  typedef std::pair<uint32_t, int32_t> Exit;
+
+  uint32_t root;                                //!< vertex the tree is rooted at
+  std::vector<uint32_t> order;                  //!< vertices in the order they joined the tree, root excluded
+  std::vector<uint32_t> preorder;               //!< depth-first walk of the tree, root first
+  std::vector<uint32_t> distance;               //!< distance from the root
+  std::vector<uint8_t> state;                   //!< not explored, candidate or in the tree
+  std::vector<std::vector<Exit> > exits;        //!< equal-cost ways out of the root
+  std::vector<std::vector<uint32_t> > parents;  //!< equal-cost parents
+  std::vector<std::vector<uint32_t> > children; //!< children, in the order they joined the tree
+  std::vector<uint64_t> sequence;               //!< candidate rank, breaking distance ties
+  std::vector<uint32_t> heap;                   //!< candidates, as a 4-ary heap
+  std::vector<uint32_t> slot;                   //!< heap slot of each candidate
+};
+
+/**
+ * \ingroup dsr
+ *
+ * \brief What the route build needs of one SPF tree, without the
+ * per-vertex working state of DsrSpfResult.
+ */
+struct DsrSpfPaths
+{
+  std::vector<uint32_t> routers;                //!< vertices in the order they joined the tree
+  std::vector<uint32_t> distance;               //!< distance from the root by vertex, 0xffffffff if unreachable
+  std::vector<uint32_t> preorder;               //!< depth-first walk of the tree, root excluded
+  std::vector<uint32_t> exitOffset;             //!< first exit of each preorder vertex, plus the end
+  std::vector<DsrSpfResult::Exit> exits;        //!< exits of the preorder vertices
+};
+
+/**
+ * \ingroup dsr
+ *
+ * \brief Compressed sparse row snapshot of the router part of the LSDB.
+ *
+ * The DSRVertex based SPF allocates a vertex per reached router, looks the
+ * LSAs up by address and rescans the link records of both ends of every
+ * link for each root.  This graph is built once per route build: routers
+ * get dense integer ids, the point-to-point links become one edge array
+ * holding the metric and, precomputed, the next hop address and outgoing
+ * interface the link gives when it leaves the root.  Calculate then runs
+ * Dijkstra over flat arrays.
+ *
+ * Calculate reproduces the DSRVertex SPF exactly: same candidate order
+ * (distance, then order of insertion or decrease), same merging of the
+ * equal-cost exits and parents, same children order.  Only LSDBs made of
+ * router LSAs with point-to-point and stub records are supported; when a
+ * network LSA or a transit record is found IsUsable returns false and the
+ * caller keeps using the DSRVertex SPF.
+ */
+class DsrSpfGraph
+{
+public:
+  /// vertex id returned when a router is not in the graph
+  static const uint32_t NO_VERTEX = 0xffffffff;
+
+  DsrSpfGraph ();
+
+  /**
+   * \brief Rebuild the graph from a link state database.
+   * \param lsdb the database; its LSAs must outlive the graph
+   */
+  void Build (const DSRRouteManagerLSDB &lsdb);
+
+  /**
+   * \brief Drop the graph.
+   */
+  void Clear (void);
+
+  /**
+   * \return true if the graph was built from an LSDB that Calculate supports
+   */
+  bool IsUsable (void) const;
+
+  /**
+   * \return the number of vertices, one per router LSA
+   */
+  uint32_t GetNVertices (void) const;
+
+  /**
+   * \return the number of directed point-to-point edges
+   */
+  uint32_t GetNEdges (void) const;
+
+  /**
+   * \param v a vertex
+   * \return the number of point-to-point edges leaving the vertex
+   */
+  uint32_t GetDegree (uint32_t v) const;
+
+  /**
+   * \param routerId a router ID
+   * \return the vertex of that router, or NO_VERTEX
+   */
+  uint32_t GetVertex (Ipv4Address routerId) const;
+
+  /**
+   * \param v a vertex
+   * \return the router LSA of the vertex
+   */
+  DSRRoutingLSA* GetLSA (uint32_t v) const;
+
+  /**
+   * \param v a vertex
+   * \return the first edge leaving the vertex
+   */
+  uint32_t GetEdgeBegin (uint32_t v) const;
+
+  /**
+   * \param v a vertex
+   * \return one past the last edge leaving the vertex
+   */
+  uint32_t GetEdgeEnd (uint32_t v) const;
+
+  /**
+   * \param e an edge
+   * \return the vertex the edge leads to
+   */
+  uint32_t GetEdgeTarget (uint32_t e) const;
+
+  /**
+   * \param e an edge
+   * \return the metric of the edge
+   */
+  uint32_t GetEdgeMetric (uint32_t e) const;
+
+  /**
+   * \brief Compare the edges leaving a vertex in two graphs built from
+   * the same set of routers.
+   * \param other the other graph
+   * \param v a vertex
+   * \return true if the edges have the same targets, metrics, next hops
+   * and interfaces, in the same order
+   */
+  bool SameEdges (const DsrSpfGraph &other, uint32_t v) const;
+
+  /**
+   * \brief Compute the shortest path tree rooted at a vertex.
+   *
+   * Fills order, distance, exits, parents, children and preorder of the
+   * result; the root is at distance 0 and has no exit.
+   *
+   * \param root the root vertex
+   * \param result the result, reset first
+   */
+  void Calculate (uint32_t root, DsrSpfResult &result) const;
+
+  /**
+   * \brief Keep what the route build needs of a calculation.
+   *
+   * Calculate and Summarize only read the graph and do not log, so several
+   * threads can run them at once with their own result objects.
+   *
+   * \param result the result of Calculate
+   * \param paths the summary, reset first
+   */
+  static void Summarize (const DsrSpfResult &result, DsrSpfPaths &paths);
+
+private:
+  /**
+   * \brief Reset a result for a new calculation over this graph.
+   * \param result the result
+   */
+  void Reset (DsrSpfResult &result) const;
+
+  /**
+   * \brief Walk the children lists depth first from the root, visiting each
+   * vertex once, the way SPFProcessStubs does.
+   * \param result a result with the children lists filled
+   */
+  static void Preorder (DsrSpfResult &result);
+
+  std::vector<DSRRoutingLSA *> m_lsa;              //!< router LSA of each vertex
+  std::unordered_map<uint32_t, uint32_t> m_vertex; //!< router ID to vertex
+  std::vector<uint32_t> m_edgeOffset;              //!< first edge of each vertex, plus the end
+  std::vector<uint32_t> m_edgeTarget;              //!< vertex the edge leads to
+  std::vector<uint32_t> m_edgeMetric;              //!< metric of the edge
+  std::vector<uint32_t> m_edgeNextHop;             //!< address of the target on the link
+  std::vector<int32_t> m_edgeOutIf;                //!< interface of the source on the link
+  bool m_usable;                                   //!< built from a supported LSDB
+};
+
+} // Namespace ns3
+
+#endif /* DSR_SPF_GRAPH_H */
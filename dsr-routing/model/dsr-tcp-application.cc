@@ -13,10 +13,7 @@
 #include "ns3/tcp-socket-factory.h"
 #include "ns3/boolean.h"
 #include "dsr-tcp-application.h"
-#include "budget-tag.h"
-#include "priority-tag.h"
-#include "flag-tag.h"
-#include "timestamp-tag.h"
+#include "dsr-meta-tag.h"
 
 #define MAX_UINT_32 0xffffffff
 
@@ -232,22 +229,19 @@ void DsrTcpApplication::SendData (const Address &from, const Address &to)
       NS_LOG_LOGIC ("sending packet at " << Simulator::Now ());
       Ptr<Packet> packet;
 
-      TimestampTag txTimeTag;
-      FlagTag flagTag;
-      BudgetTag budgetTag;
-      PriorityTag priorityTag;
+      DsrMetaTag metaTag;
 
-      txTimeTag.SetTimestamp (Simulator::Now ());
-      flagTag.SetFlagTag (m_flag);
+      metaTag.SetTimestamp (Simulator::Now ());
+      metaTag.SetFlag (m_flag);
       if (m_budget == MAX_UINT_32)
         {
-          budgetTag.SetBudget (0);
-          priorityTag.SetPriority (99);
+          metaTag.SetBudget (0);
+          metaTag.SetLane (99);
         }
       else
         {
-          budgetTag.SetBudget (m_budget);
-          priorityTag.SetPriority (1);
+          metaTag.SetBudget (m_budget);
+          metaTag.SetLane (1);
         }
 
       if (m_unsentPacket)
@@ -258,10 +252,7 @@ void DsrTcpApplication::SendData (const Address &from, const Address &to)
       else
         {
           packet = Create<Packet> (toSend);
-          packet->AddPacketTag (txTimeTag);
-          packet->AddPacketTag (flagTag);
-          packet->AddPacketTag (budgetTag);
-          packet->AddPacketTag (priorityTag);
+          metaTag.AddTo (packet, DsrMetaTag::UseLegacyTags ());
         }
       int actual = m_socket->Send (packet);
       if ((unsigned) actual == toSend)
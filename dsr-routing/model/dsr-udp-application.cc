@@ -8,10 +8,7 @@
 #include "ns3/internet-module.h"
 #include "ns3/flow-monitor-module.h"
 #include "dsr-udp-application.h"
-#include "budget-tag.h"
-#include "priority-tag.h"
-#include "flag-tag.h"
-#include "timestamp-tag.h"
+#include "dsr-meta-tag.h"
 
 
 #define MAX_UINT_32 0xffffffff
@@ -106,30 +103,24 @@ void
 DsrUdpApplication::SendPacket()
 {
 
-    TimestampTag txTimeTag;
-    FlagTag flagTag;
-    BudgetTag budgetTag;
-    PriorityTag priorityTag;
+    DsrMetaTag metaTag;
     
     Ptr<Packet> packet = Create <Packet> (m_packetSize);
     Time txTime = Simulator::Now ();
     if (m_budget == MAX_UINT_32)
     {
-        budgetTag.SetBudget (0);
-        priorityTag.SetPriority (99);
+        metaTag.SetBudget (0);
+        metaTag.SetLane (99);
     }
     else
     {
-        budgetTag.SetBudget (m_budget);
-        priorityTag.SetPriority (1);
+        metaTag.SetBudget (m_budget);
+        metaTag.SetLane (1);
     }
-    flagTag.SetFlagTag (m_flag);
-    txTimeTag.SetTimestamp (txTime);
+    metaTag.SetFlag (m_flag);
+    metaTag.SetTimestamp (txTime);
 
-    packet->AddPacketTag (txTimeTag);
-    packet->AddPacketTag (flagTag);
-    packet->AddPacketTag (budgetTag);
-    packet->AddPacketTag (priorityTag);
+    metaTag.AddTo (packet, DsrMetaTag::UseLegacyTags ());
     m_socket->Send (packet);
     if(++ m_packetSent < m_nPackets)
     {
@@ -1,24 +1,32 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
+#include <algorithm>
+#include <sstream>
 #include "ns3/log.h"
 #include "ns3/object-factory.h"
 #include "ns3/queue.h"
 #include "ns3/socket.h"
 #include "ns3/simulator.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/integer.h"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
 #include "dsr-virtual-queue-disc.h"
+#include "dsr-edf-queue.h"
 #include "priority-tag.h"
+#include "dsr-meta-tag.h"
 #include "timestamp-tag.h"
 
-#define FAST_LANE 0
-#define SLOW_LANE 1
-#define NORMAL_LANE 2
-
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("DsrVirtualQueueDisc");
 
 NS_OBJECT_ENSURE_REGISTERED (DsrVirtualQueueDisc);
 
+const uint32_t DsrVirtualQueueDisc::NO_LANE;
+
 TypeId DsrVirtualQueueDisc::GetTypeId (void)
 {
   static TypeId tid = TypeId ("ns3::DsrVirtualQueueDisc")
@@ -31,12 +39,79 @@ TypeId DsrVirtualQueueDisc::GetTypeId (void)
                    MakeQueueSizeAccessor (&QueueDisc::SetMaxSize,
                                           &QueueDisc::GetMaxSize),
                    MakeQueueSizeChecker ())
+    .AddAttribute ("Scheduler",
+                   "How the lanes share the link: packet-count weighted round robin, or "
+                   "deficit round robin on the byte quanta of the lanes",
+                   EnumValue (DsrVirtualQueueDisc::WRR),
+                   MakeEnumAccessor (&DsrVirtualQueueDisc::m_scheduler),
+                   MakeEnumChecker (DsrVirtualQueueDisc::WRR, "WRR",
+                                    DsrVirtualQueueDisc::DRR, "DRR"))
+    .AddAttribute ("LaneCapacities",
+                   "Capacity of each lane, in packets, separated by spaces.  The number "
+                   "of values sets the number of lanes; the last lane is best effort.",
+                   StringValue ("12 36 100"),
+                   MakeStringAccessor (&DsrVirtualQueueDisc::m_laneCapacitiesString),
+                   MakeStringChecker ())
+    .AddAttribute ("LaneShares",
+                   "Fraction of the link rate each lane is served at when every lane is "
+                   "backlogged, separated by spaces.  Sets the DRR quanta, and the delay "
+                   "estimates of the routing.",
+                   StringValue ("0.5 0.3 0.2"),
+                   MakeStringAccessor (&DsrVirtualQueueDisc::m_laneSharesString),
+                   MakeStringChecker ())
+    .AddAttribute ("LaneWeights",
+                   "Packets each lane may send per round in WRR mode, separated by spaces",
+                   StringValue ("10 3 2"),
+                   MakeStringAccessor (&DsrVirtualQueueDisc::m_laneWeightsString),
+                   MakeStringChecker ())
+    .AddAttribute ("DrrRoundSize",
+                   "Bytes served per round in DRR mode when every lane is backlogged; "
+                   "the quantum of a lane is its share of them",
+                   UintegerValue (15000),
+                   MakeUintegerAccessor (&DsrVirtualQueueDisc::m_drrRoundSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("EdfLane",
+                   "Lane whose packets leave in earliest-deadline-first order instead of "
+                   "FIFO, or -1 for none.  Only applies to the internal queues created "
+                   "by the queue disc; see DsrEdfQueue.",
+                   IntegerValue (-1),
+                   MakeIntegerAccessor (&DsrVirtualQueueDisc::m_edfLane),
+                   MakeIntegerChecker<int32_t> (-1))
+    .AddAttribute ("DropExpired",
+                   "Drop the packets whose delay budget has run out when they reach the "
+                   "head of their lane, instead of sending them to a next hop that would "
+                   "drop them",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DsrVirtualQueueDisc::m_dropExpired),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ExpiredDrops",
+                   "Number of packets dropped because their delay budget had run out",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DsrVirtualQueueDisc::GetExpiredDrops),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("SojournEwmaWeight",
+                   "Weight of a new sample in the moving average of the sojourn time of a lane",
+                   DoubleValue (0.125),
+                   MakeDoubleAccessor (&DsrVirtualQueueDisc::m_sojournWeight),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("SojournWindow",
+                   "Length of the windows of the maximum sojourn time of a lane",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&DsrVirtualQueueDisc::m_sojournWindow),
+                   MakeTimeChecker ())
   ;
   return tid;
 }
 
 DsrVirtualQueueDisc::DsrVirtualQueueDisc ()
-  : QueueDisc (QueueDiscSizePolicy::MULTIPLE_QUEUES, QueueSizeUnit::PACKETS)
+  : QueueDisc (QueueDiscSizePolicy::MULTIPLE_QUEUES, QueueSizeUnit::PACKETS),
+    m_drrRoundSize (0),
+    m_edfLane (-1),
+    m_dropExpired (false),
+    m_nExpiredDrops (0),
+    m_scheduler (WRR),
+    m_sojournWeight (0.125)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -52,11 +127,20 @@ DsrVirtualQueueDisc::DoEnqueue (Ptr<QueueDiscItem> item)
 {
   NS_LOG_FUNCTION (this << item);
   uint32_t lane = EnqueueClassify (item);
-  if (GetInternalQueue(lane)->GetCurrentSize ().GetValue() >= LinesSize[lane])
+  if (GetInternalQueue(lane)->GetCurrentSize ().GetValue() >= m_capacity[lane])
   {
     DropBeforeEnqueue (item, LIMIT_EXCEEDED_DROP);
+    return false;
   }
+  item->SetTimeStamp (Simulator::Now ());
   bool retval = GetInternalQueue (lane)->Enqueue (item);
+  if (retval && m_scheduler == DRR && !m_laneActive[lane])
+    {
+      // a lane joining the round starts with a full quantum
+      m_activeLanes.push_back (lane);
+      m_laneActive[lane] = true;
+      m_deficit[lane] = m_quantum[lane];
+    }
   return retval;
 }
 
@@ -65,9 +149,110 @@ DsrVirtualQueueDisc::DoDequeue (void)
 {
   NS_LOG_FUNCTION (this);
 
+  uint32_t lane = NO_LANE;
+  Ptr<QueueDiscItem> item;
+  while ((item = DequeueNext (lane)) != 0)
+    {
+      RecordSojourn (lane, item);
+      if (!IsExpired (item))
+        {
+          return item;
+        }
+      DropExpiredItem (lane, item);
+    }
+  return item;
+}
+
+bool
+DsrVirtualQueueDisc::IsExpired (Ptr<const QueueDiscItem> item) const
+{
+  return m_dropExpired && DsrEdfQueue::GetDeadline (item) < Simulator::Now ().GetMicroSeconds ();
+}
+
+void
+DsrVirtualQueueDisc::DropExpiredItem (uint32_t lane, Ptr<QueueDiscItem> item)
+{
+  // the link time of the dead packet goes back to its lane
+  if (m_scheduler == DRR)
+    {
+      m_deficit[lane] += item->GetSize ();
+    }
+  else
+    {
+      m_credit[lane]++;
+    }
+  m_nExpiredDrops++;
+  NS_LOG_LOGIC ("Expired packet at the head of band " << lane << ": " << item);
+  DropAfterDequeue (item, EXPIRED_DROP);
+}
+
+uint64_t
+DsrVirtualQueueDisc::GetExpiredDrops (void) const
+{
+  return m_nExpiredDrops;
+}
+
+void
+DsrVirtualQueueDisc::RecordSojourn (uint32_t lane, Ptr<const QueueDiscItem> item)
+{
+  Time now = Simulator::Now ();
+  Time sojourn = now - item->GetTimeStamp ();
+  LaneSojourn &s = m_sojourn[lane];
+  if (now >= s.windowStart + m_sojournWindow)
+    {
+      // a window without any packet leaves nothing to remember
+      s.previousMax = now >= s.windowStart + m_sojournWindow * 2 ? Time () : s.max;
+      s.max = Time ();
+      s.windowStart = now;
+    }
+  s.max = std::max (s.max, sojourn);
+  double sample = static_cast<double> (sojourn.GetNanoSeconds ());
+  s.average = s.sampled ? s.average + m_sojournWeight * (sample - s.average) : sample;
+  s.sampled = true;
+}
+
+Time
+DsrVirtualQueueDisc::GetLaneSojourn (uint32_t lane) const
+{
+  NS_ASSERT (lane < m_sojourn.size ());
+  return NanoSeconds (static_cast<uint64_t> (m_sojourn[lane].average));
+}
+
+Time
+DsrVirtualQueueDisc::GetLaneMaxSojourn (uint32_t lane) const
+{
+  NS_ASSERT (lane < m_sojourn.size ());
+  const LaneSojourn &s = m_sojourn[lane];
+  Time now = Simulator::Now ();
+  if (now >= s.windowStart + m_sojournWindow * 2)
+    {
+      return Time ();
+    }
+  if (now >= s.windowStart + m_sojournWindow)
+    {
+      return s.max;
+    }
+  return std::max (s.max, s.previousMax);
+}
+
+uint32_t
+DsrVirtualQueueDisc::GetLaneBacklog (uint32_t lane) const
+{
+  NS_ASSERT (lane < GetNInternalQueues ());
+  return GetInternalQueue (lane)->GetNBytes ();
+}
+
+Ptr<QueueDiscItem>
+DsrVirtualQueueDisc::DequeueNext (uint32_t &lane)
+{
+  if (m_scheduler == DRR)
+    {
+      return DrrDequeue (lane);
+    }
   Ptr<QueueDiscItem> item;
   uint32_t prio = Classify ();
-  if (prio == 88)
+  lane = prio;
+  if (prio == NO_LANE)
   {
     return 0;
   }
@@ -89,18 +274,38 @@ DsrVirtualQueueDisc::DoPeek (void)
 
   Ptr<const QueueDiscItem> item;
 
-  for (uint32_t i = 0; i < GetNInternalQueues (); i++)
+  // the packet DoDequeue would return, without moving the scheduler
+  while (true)
     {
-      if ((item = GetInternalQueue (i)->Peek ()) != 0)
+      uint32_t lane = NO_LANE;
+      if (m_scheduler == DRR)
+        {
+          lane = PeekDrrLane ();
+        }
+      else
+        {
+          std::vector<uint32_t> credit (m_credit);
+          lane = SelectWrrLane (credit);
+        }
+      if (lane == NO_LANE || (item = GetInternalQueue (lane)->Peek ()) == 0)
+        {
+          NS_LOG_LOGIC ("Queue empty");
+          return 0;
+        }
+      if (!IsExpired (item))
         {
-          NS_LOG_LOGIC ("Peeked from band " << i << ": " << item);
-          NS_LOG_LOGIC ("Number packets band " << i << ": " << GetInternalQueue (i)->GetNPackets ());
+          NS_LOG_LOGIC ("Peeked from band " << lane << ": " << item);
+          NS_LOG_LOGIC ("Number packets band " << lane << ": " << GetInternalQueue (lane)->GetNPackets ());
           return item;
         }
+      // DoDequeue would drop the head, so the next Dequeue could not return
+      // it: drop it now and look at the packet after it
+      uint32_t served = NO_LANE;
+      Ptr<QueueDiscItem> expired = DequeueNext (served);
+      NS_ASSERT (expired == item && served == lane);
+      RecordSojourn (served, expired);
+      DropExpiredItem (served, expired);
     }
-
-  NS_LOG_LOGIC ("Queue empty");
-  return item;
 }
 
 bool
@@ -120,32 +325,57 @@ DsrVirtualQueueDisc::CheckConfig (void)
       return false;
     }
   
+  if (!ConfigureLanes ())
+    {
+      return false;
+    }
+  uint32_t nLanes = GetNLanes ();
+
+  if (m_edfLane >= static_cast<int32_t> (nLanes))
+    {
+      NS_LOG_ERROR ("DsrVirtualQueueDisc has no lane " << m_edfLane);
+      return false;
+    }
+
   if (GetNInternalQueues () == 0)
     {
-      // create 3 DropTail queues with GetLimit() packets each
+      // create one DropTail queue with GetLimit() packets per lane, or a
+      // DsrEdfQueue for the EDF lane
       ObjectFactory factory;
       factory.SetTypeId ("ns3::DropTailQueue<QueueDiscItem>");
       factory.Set ("MaxSize", QueueSizeValue (GetMaxSize ()));
-      AddInternalQueue (factory.Create<InternalQueue> ());
-      AddInternalQueue (factory.Create<InternalQueue> ());
-      AddInternalQueue (factory.Create<InternalQueue> ());
+      ObjectFactory edfFactory;
+      edfFactory.SetTypeId ("ns3::DsrEdfQueue");
+      edfFactory.Set ("MaxSize", QueueSizeValue (GetMaxSize ()));
+      for (uint32_t i = 0; i < nLanes; i++)
+        {
+          if (static_cast<int32_t> (i) == m_edfLane)
+            {
+              AddInternalQueue (edfFactory.Create<InternalQueue> ());
+            }
+          else
+            {
+              AddInternalQueue (factory.Create<InternalQueue> ());
+            }
+        }
     }
 
-  if (GetNInternalQueues () != 3)
+  if (GetNInternalQueues () != nLanes)
     {
-      NS_LOG_ERROR ("DsrVirtualQueueDisc needs 3 internal queues");
+      NS_LOG_ERROR ("DsrVirtualQueueDisc needs one internal queue per lane");
       return false;
     }
 
-  if (GetInternalQueue (0)-> GetMaxSize ().GetUnit () != QueueSizeUnit::PACKETS ||
-      GetInternalQueue (1)-> GetMaxSize ().GetUnit () != QueueSizeUnit::PACKETS ||
-      GetInternalQueue (2)-> GetMaxSize ().GetUnit () != QueueSizeUnit::PACKETS)
+  for (uint32_t i = 0; i < nLanes; i++)
     {
-      NS_LOG_ERROR ("PfifoFastQueueDisc needs 3 internal queues operating in packet mode");
-      return false;
+      if (GetInternalQueue (i)-> GetMaxSize ().GetUnit () != QueueSizeUnit::PACKETS)
+        {
+          NS_LOG_ERROR ("DsrVirtualQueueDisc needs internal queues operating in packet mode");
+          return false;
+        }
     }
 
-  for (uint8_t i = 0; i < 2; i++)
+  for (uint32_t i = 0; i + 1 < nLanes; i++)
     {
       if (GetInternalQueue (i)->GetMaxSize () < GetMaxSize ())
         {
@@ -163,109 +393,205 @@ DsrVirtualQueueDisc::InitializeParams (void)
   NS_LOG_FUNCTION (this);
 }
 
-uint32_t
-DsrVirtualQueueDisc::Classify ()
+bool
+DsrVirtualQueueDisc::ConfigureLanes (void)
 {
-  if (currentFastWeight > 0)
+  NS_LOG_FUNCTION (this);
+  m_capacity.clear ();
+  m_share.clear ();
+  m_weight.clear ();
+  std::istringstream capacities (m_laneCapacitiesString);
+  std::istringstream shares (m_laneSharesString);
+  std::istringstream weights (m_laneWeightsString);
+  uint32_t capacity;
+  double share;
+  uint32_t weight;
+  while (capacities >> capacity)
     {
-      if (!GetInternalQueue (0)->IsEmpty ())
-        {
-          currentFastWeight--;
-          return 0;
-        }
-      else
-        {
-          currentFastWeight = 0;
-        }
+      m_capacity.push_back (capacity);
     }
-  if (currentSlowWeight > 0)
+  while (shares >> share)
     {
-      if (!GetInternalQueue (1)->IsEmpty ())
-        {
-          currentSlowWeight--;
-          return 1;
-        }
-      else
-        {
-          currentSlowWeight = 0;
-        }
+      m_share.push_back (share);
     }
-  if (currentNormalWeight > 0)
+  while (weights >> weight)
     {
-      if (!GetInternalQueue (2)->IsEmpty ())
-        {
-          currentNormalWeight--;
-          return 2;
-        }
-      else
+      m_weight.push_back (weight);
+    }
+  if (!capacities.eof () || !shares.eof () || !weights.eof ())
+    {
+      NS_LOG_ERROR ("DsrVirtualQueueDisc lane attributes must be numbers separated by spaces");
+      return false;
+    }
+  uint32_t nLanes = m_capacity.size ();
+  if (nLanes < 2)
+    {
+      NS_LOG_ERROR ("DsrVirtualQueueDisc needs a budget-aware lane and a best-effort lane");
+      return false;
+    }
+  if (m_share.size () != nLanes || m_weight.size () != nLanes)
+    {
+      NS_LOG_ERROR ("DsrVirtualQueueDisc needs a share and a weight per lane");
+      return false;
+    }
+  double total = 0;
+  for (uint32_t i = 0; i < nLanes; i++)
+    {
+      // the routing divides by the shares of the budget-aware lanes
+      if (m_share[i] <= 0 || m_capacity[i] == 0)
         {
-          currentNormalWeight = 0;
+          NS_LOG_ERROR ("DsrVirtualQueueDisc lanes need a positive capacity and share");
+          return false;
         }
+      total += m_share[i];
     }
-  currentFastWeight = m_fastWeight;
-  currentSlowWeight = m_slowWeight;
-  currentNormalWeight = m_normalWeight;
-  
-   if (currentFastWeight > 0)
+  if (total > 1 + 1e-9)
+    {
+      NS_LOG_ERROR ("DsrVirtualQueueDisc lane shares add up to more than the link");
+      return false;
+    }
+
+  m_credit.assign (nLanes, 0);
+  m_quantum.resize (nLanes);
+  for (uint32_t i = 0; i < nLanes; i++)
+    {
+      m_quantum[i] = std::max<uint32_t> (1, static_cast<uint32_t> (m_share[i] * m_drrRoundSize + 0.5));
+    }
+  m_deficit.assign (nLanes, 0);
+  m_laneActive.assign (nLanes, 0);
+  m_activeLanes.clear ();
+  LaneSojourn idle = { 0.0, Time (), Time (), Time (), false };
+  m_sojourn.assign (nLanes, idle);
+  return true;
+}
+
+uint32_t
+DsrVirtualQueueDisc::GetNLanes (void) const
+{
+  return m_capacity.size ();
+}
+
+uint32_t
+DsrVirtualQueueDisc::GetLaneCapacity (uint32_t lane) const
+{
+  NS_ASSERT (lane < m_capacity.size ());
+  return m_capacity[lane];
+}
+
+double
+DsrVirtualQueueDisc::GetLaneShare (uint32_t lane) const
+{
+  NS_ASSERT (lane < m_share.size ());
+  return m_share[lane];
+}
+
+uint32_t
+DsrVirtualQueueDisc::Classify ()
+{
+  return SelectWrrLane (m_credit);
+}
+
+uint32_t
+DsrVirtualQueueDisc::SelectWrrLane (std::vector<uint32_t> &credit) const
+{
+  // what is left of the current round, then a fresh round
+  for (uint32_t pass = 0; pass < 2; pass++)
     {
-      if (!GetInternalQueue (0)->IsEmpty ())
+      for (uint32_t lane = 0; lane < credit.size (); lane++)
         {
-          currentFastWeight--;
-          return 0;
+          if (credit[lane] == 0)
+            {
+              continue;
+            }
+          if (!GetInternalQueue (lane)->IsEmpty ())
+            {
+              credit[lane]--;
+              return lane;
+            }
+          credit[lane] = 0;
         }
-      else
+      if (pass == 0)
         {
-          currentFastWeight = 0;
+          credit = m_weight;
         }
     }
-  if (currentSlowWeight > 0)
+  return NO_LANE;
+}
+
+Ptr<QueueDiscItem>
+DsrVirtualQueueDisc::DrrDequeue (uint32_t &served)
+{
+  while (!m_activeLanes.empty ())
     {
-      if (!GetInternalQueue (1)->IsEmpty ())
+      uint32_t lane = m_activeLanes.front ();
+      if (m_deficit[lane] <= 0)
         {
-          currentSlowWeight--;
-          return 1;
+          m_deficit[lane] += m_quantum[lane];
+          m_activeLanes.splice (m_activeLanes.end (), m_activeLanes, m_activeLanes.begin ());
+          continue;
         }
-      else
+      Ptr<QueueDiscItem> item = GetInternalQueue (lane)->Dequeue ();
+      if (item == 0)
         {
-          currentSlowWeight = 0;
+          m_activeLanes.pop_front ();
+          m_laneActive[lane] = false;
+          continue;
         }
-    }
-  if (currentNormalWeight > 0)
-    {
-      if (!GetInternalQueue (2)->IsEmpty ())
+      NS_LOG_LOGIC ("Popped from band " << lane << ": " << item);
+      served = lane;
+      m_deficit[lane] -= item->GetSize ();
+      if (GetInternalQueue (lane)->IsEmpty ())
         {
-          currentNormalWeight--;
-          return 2;
+          // an idle lane does not bank credit
+          m_activeLanes.pop_front ();
+          m_laneActive[lane] = false;
         }
-      else
+      return item;
+    }
+  NS_LOG_LOGIC ("Queue empty");
+  return 0;
+}
+
+uint32_t
+DsrVirtualQueueDisc::PeekDrrLane (void) const
+{
+  if (m_activeLanes.empty ())
+    {
+      return NO_LANE;
+    }
+  std::vector<int64_t> deficit (m_deficit.begin (), m_deficit.end ());
+  // the quanta are positive, so some lane eventually has credit
+  while (true)
+    {
+      for (std::list<uint32_t>::const_iterator i = m_activeLanes.begin (); i != m_activeLanes.end (); i++)
         {
-          currentNormalWeight = 0;
+          if (deficit[*i] > 0)
+            {
+              return *i;
+            }
+          deficit[*i] += m_quantum[*i];
         }
     }
-  return 88;
-}   
+}
 
 uint32_t
 DsrVirtualQueueDisc::EnqueueClassify (Ptr<QueueDiscItem> item)
 {
+  DsrMetaTag metaTag;
   PriorityTag priorityTag;
-  if (item->GetPacket ()->FindFirstMatchingByteTag (priorityTag))
-    {
-      uint32_t priority = priorityTag.GetPriority ();
-      switch (priority)
-      {
-      case 0x00:
-        return FAST_LANE;
-      case 0x01:
-        return SLOW_LANE;
-      default:
-        return NORMAL_LANE;
-      }
+  uint32_t priority;
+  if (item->GetPacket ()->PeekPacketTag (metaTag))
+    {
+      priority = metaTag.GetLane ();
+    }
+  else if (item->GetPacket ()->FindFirstMatchingByteTag (priorityTag))
+    {
+      priority = priorityTag.GetPriority ();
     }
   else
     {
-      return NORMAL_LANE;
+      return GetNLanes () - 1;
     }
-
+  return std::min (priority, GetNLanes () - 1);
 }
-} // namespace ns3
\ No newline at end of file
+} // namespace ns3
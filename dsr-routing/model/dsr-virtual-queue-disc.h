@@ -2,10 +2,35 @@
 #ifndef DSR_VIRTUAL_QUEUE_DISC_H
 #define DSR_VIRTUAL_QUEUE_DISC_H
 
+#include <list>
+#include <string>
+#include <vector>
 #include "ns3/queue-disc.h"
+#include "ns3/nstime.h"
+
+class DsrLaneConfigTestCase;
 
 namespace ns3 {
 
+/**
+ * \brief Multi-lane queue disc of DSR forwarding.
+ *
+ * The number of lanes is the number of values of the "LaneCapacities"
+ * attribute, three by default: fast, slow and best effort.  The last lane
+ * is the best-effort lane; the others are the budget-aware lanes
+ * Ipv4DSRRouting chooses from, using the capacity and the share of each
+ * lane read from this queue disc.
+ *
+ * The lanes are served by packet-count weighted round robin, or by deficit
+ * round robin with a quantum of bytes per lane, which shares the link in
+ * proportion to the quanta whatever the packet sizes.  Within a lane, the
+ * packets leave in FIFO order, or by earliest deadline first in the lane
+ * set by the "EdfLane" attribute.
+ *
+ * The sojourn time of every packet, from enqueue to dequeue, is measured
+ * per lane: GetLaneSojourn, GetLaneMaxSojourn and GetLaneBacklog give the
+ * routing the delay the lanes actually deliver, in constant time.
+ */
 class DsrVirtualQueueDisc : public QueueDisc {
 public:
   /**
@@ -22,32 +47,172 @@ public:
 
   virtual ~DsrVirtualQueueDisc();
 
+  /// how the lanes share the link
+  enum Scheduler
+  {
+    WRR,  //!< weighted round robin on packets
+    DRR   //!< deficit round robin on bytes
+  };
+
+  static const uint32_t NO_LANE = 0xffffffff; //!< no lane has a packet to send
+
+  /**
+   * \return the number of lanes, the best-effort lane included
+   */
+  uint32_t GetNLanes (void) const;
+
+  /**
+   * \param lane a lane
+   * \return the number of packets the lane accepts
+   */
+  uint32_t GetLaneCapacity (uint32_t lane) const;
+
+  /**
+   * \param lane a lane
+   * \return the fraction of the link rate the lane is served at when every
+   * lane is backlogged
+   */
+  double GetLaneShare (uint32_t lane) const;
+
+  /**
+   * \param lane a lane
+   * \return the moving average of the sojourn time of the packets of the lane
+   */
+  Time GetLaneSojourn (uint32_t lane) const;
+
+  /**
+   * \param lane a lane
+   * \return the largest sojourn time of a packet of the lane over the last
+   * one to two "SojournWindow"
+   */
+  Time GetLaneMaxSojourn (uint32_t lane) const;
+
+  /**
+   * \param lane a lane
+   * \return the bytes queued in the lane
+   */
+  uint32_t GetLaneBacklog (uint32_t lane) const;
+
   // Reasons for dropping packets
   static constexpr const char* LIMIT_EXCEEDED_DROP = "Queue disc limit exceeded";  //!< Packet dropped due to queue disc limit exceeded
   static constexpr const char* TIMEOUT_DROP = "time out !!!!!!!!";
   static constexpr const char* BUFFERBLOAT_DROP = "Buffer bloat !!!!!!!!";
+  static constexpr const char* EXPIRED_DROP = "Delay budget expired";  //!< Packet dropped at the head of its lane, its budget run out
+
+  /**
+   * \return the number of packets dropped by "DropExpired"
+   */
+  uint64_t GetExpiredDrops (void) const;
 
 private:
-  // packet size = 1kB
-  // packet size for test = 52B
-  uint32_t LinesSize[3] = {12,36,100};
-  uint32_t m_fastWeight = 10;
-  uint32_t m_slowWeight = 3;
-  uint32_t m_normalWeight = 2;
-
-  uint32_t currentFastWeight = 0;
-  uint32_t currentSlowWeight = 0;
-  uint32_t currentNormalWeight = 0;
+  friend class ::DsrLaneConfigTestCase; //!< checks the rejected lane configurations
+
+  std::string m_laneCapacitiesString; //!< "LaneCapacities" attribute
+  std::string m_laneSharesString;     //!< "LaneShares" attribute
+  std::string m_laneWeightsString;    //!< "LaneWeights" attribute
+  uint32_t m_drrRoundSize;            //!< bytes served per DRR round
+  int32_t m_edfLane;                  //!< lane created as a DsrEdfQueue, or -1
+  bool m_dropExpired;                 //!< drop the packets whose budget ran out at dequeue
+  uint64_t m_nExpiredDrops;           //!< packets dropped for an expired budget
+
+  std::vector<uint32_t> m_capacity;   //!< packets each lane accepts
+  std::vector<double> m_share;        //!< link share of each lane
+  std::vector<uint32_t> m_weight;     //!< packets of each lane per round, in WRR mode
+  std::vector<uint32_t> m_credit;     //!< packets each lane may still send this round
+
+  Scheduler m_scheduler;              //!< how the lanes share the link
+  std::vector<uint32_t> m_quantum;    //!< bytes credited to each lane per round, in DRR mode
+  std::vector<int32_t> m_deficit;     //!< bytes each lane may still send, in DRR mode
+  std::vector<uint8_t> m_laneActive;  //!< lane is in m_activeLanes
+  std::list<uint32_t> m_activeLanes;  //!< backlogged lanes, in service order, in DRR mode
+
+  /// sojourn time measured in a lane
+  struct LaneSojourn
+  {
+    double average;         //!< moving average, in nanoseconds
+    Time max;               //!< largest sample of the current window
+    Time previousMax;       //!< largest sample of the previous window
+    Time windowStart;       //!< start of the current window
+    bool sampled;           //!< a packet of the lane has left
+  };
+
+  double m_sojournWeight;             //!< weight of a new sample in the moving average
+  Time m_sojournWindow;               //!< length of a window of the windowed max
+  std::vector<LaneSojourn> m_sojourn; //!< sojourn time of each lane
+
   virtual bool DoEnqueue (Ptr<QueueDiscItem> item);
   virtual Ptr<QueueDiscItem> DoDequeue (void);
   // virtual void DoPrioDequeue (void);
   virtual Ptr<const QueueDiscItem> DoPeek (void);
   virtual bool CheckConfig (void);
   virtual void InitializeParams (void);
+  /**
+   * \brief Parse the lane attributes.
+   * \return false if they are malformed or inconsistent
+   */
+  bool ConfigureLanes (void);
+  /**
+   * \brief Pick the lane to serve next in WRR mode.
+   * \return the lane, or NO_LANE if every lane is empty
+   */
   virtual uint32_t Classify (); 
+  /**
+   * \brief Dequeue the next packet of the scheduler.
+   * \param lane set to the lane of the packet
+   * \return the packet, or 0 if every lane is empty
+   */
+  Ptr<QueueDiscItem> DequeueNext (uint32_t &lane);
+  /**
+   * \brief Run the weighted round robin on a set of credits.
+   * \param credit the packets each lane may still send this round, updated
+   * \return the lane to serve, or NO_LANE if every lane is empty
+   */
+  uint32_t SelectWrrLane (std::vector<uint32_t> &credit) const;
+  /**
+   * \brief Dequeue the next packet in DRR mode.
+   *
+   * The lane at the head of the active list sends while its deficit is
+   * positive, then gets its quantum and moves to the tail.  With quanta of
+   * at least one MTU, this visits a bounded number of lanes per packet.
+   *
+   * \param served set to the lane of the packet
+   * \return the packet, or 0 if every lane is empty
+   */
+  Ptr<QueueDiscItem> DrrDequeue (uint32_t &served);
+  /**
+   * \return the lane DrrDequeue would serve next, or NO_LANE
+   */
+  uint32_t PeekDrrLane (void) const;
+  /**
+   * \brief Account for the sojourn time of a packet leaving a lane.
+   * \param lane the lane
+   * \param item the packet, stamped by DoEnqueue
+   */
+  void RecordSojourn (uint32_t lane, Ptr<const QueueDiscItem> item);
+  /**
+   * \param item a packet at the head of its lane
+   * \return true if "DropExpired" is set and the budget of the packet has run out
+   */
+  bool IsExpired (Ptr<const QueueDiscItem> item) const;
+  /**
+   * \brief Drop a dequeued packet whose budget has run out, and give its
+   * link time back to its lane.
+   * \param lane the lane of the packet
+   * \param item the packet
+   */
+  void DropExpiredItem (uint32_t lane, Ptr<QueueDiscItem> item);
+  /**
+   * \brief Map a packet to its lane.
+   *
+   * Lane i of the DSR meta tag, or priority i of the priority tag, maps to
+   * lane i when that is a budget-aware lane, and to the best-effort lane
+   * otherwise.
+   *
+   * \param item the packet
+   * \return the lane
+   */
   virtual uint32_t EnqueueClassify (Ptr<QueueDiscItem> item);
 };
-
 }
 
 #endif /* DSR_VIRTUAL_QUEUE_DISC_H */
@@ -17,9 +17,12 @@
 //
 
 #include <vector>
+#include <algorithm>
 #include <iomanip>
+#include <chrono>
 #include "ns3/names.h"
 #include "ns3/log.h"
+#include "ns3/abort.h"
 #include "ns3/simulator.h"
 #include "ns3/object.h"
 #include "ns3/packet.h"
@@ -29,13 +32,16 @@
 #include "ns3/ipv4-route.h"
 #include "ns3/ipv4-routing-table-entry.h"
 #include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
 #include "ns3/node.h"
+#include "ns3/output-stream-wrapper.h"
 #include "ipv4-dsr-routing.h"
 #include "dsr-route-manager.h"
-#include "budget-tag.h"
-#include "flag-tag.h"
-#include "timestamp-tag.h"
-#include "priority-tag.h"
+#include "dsr-meta-tag.h"
+#include "dsr-virtual-queue-disc.h"
 
 namespace ns3 {
 
@@ -43,6 +49,12 @@ NS_LOG_COMPONENT_DEFINE ("Ipv4DSRRouting");
 
 NS_OBJECT_ENSURE_REGISTERED (Ipv4DSRRouting);
 
+const uint32_t DsrForwardingDecision::MAX_CANDIDATES;
+const uint32_t DsrForwardingDecision::MAX_LANES;
+
+/// router IDs by interface address, shared by every router
+static std::unordered_map<uint32_t, uint32_t> g_routerAddresses;
+
 TypeId 
 Ipv4DSRRouting::GetTypeId (void)
 { 
@@ -60,22 +72,159 @@ Ipv4DSRRouting::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&Ipv4DSRRouting::m_respondToInterfaceEvents),
                    MakeBooleanChecker ())
+    .AddAttribute ("SpfDelay",
+                   "Time between the first interface event of a window and the route update "
+                   "serving every event of the window, as the OSPF SPF delay",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&Ipv4DSRRouting::m_spfDelay),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("SpfHoldTime",
+                   "Minimum time between the starts of two route updates, as the OSPF SPF "
+                   "hold time",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&Ipv4DSRRouting::m_spfHoldTime),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("FlowCache",
+                   "Set to true to reuse the forwarding decision of non-flagged packets sharing "
+                   "a destination and a budget bucket",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4DSRRouting::m_flowCacheEnabled),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FlowCacheTimeout",
+                   "How long a cached forwarding decision may be reused",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&Ipv4DSRRouting::m_flowCacheTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("FlowCacheMaxPackets",
+                   "How many packets may reuse a cached forwarding decision",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::m_flowCacheMaxPackets),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("FlowCacheBudgetBucket",
+                   "Width, in microseconds, of the remaining-budget buckets sharing a cached decision",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::m_flowCacheBudgetBucket),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("FlowCacheOccupancyThreshold",
+                   "Occupancy of the selected lane, as a fraction of its buffer, above which a "
+                   "cached decision is dropped",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&Ipv4DSRRouting::m_flowCacheOccupancy),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("DelayEstimator",
+                   "How the delay of a packet through a lane of a next hop is estimated: from "
+                   "the queue length and the lane share, or from the sojourn times measured by "
+                   "a DsrVirtualQueueDisc",
+                   EnumValue (Ipv4DSRRouting::MODEL),
+                   MakeEnumAccessor (&Ipv4DSRRouting::m_delayEstimator),
+                   MakeEnumChecker (Ipv4DSRRouting::MODEL, "Model",
+                                    Ipv4DSRRouting::MEASURED, "Measured",
+                                    Ipv4DSRRouting::MEASURED_MAX, "MeasuredMax"))
+    .AddAttribute ("FlowCacheHits",
+                   "Number of budget-aware lookups answered by the flow cache",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::GetFlowCacheHits),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("FlowCacheMisses",
+                   "Number of budget-aware lookups the flow cache could not answer",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::GetFlowCacheMisses),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("LatencySampleInterval",
+                   "Measure the wall-clock time of one budget-aware lookup out of this many; "
+                   "0 disables the measurement",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::m_latencySampleInterval),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Lookups",
+                   "Number of budget-aware lookups",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::m_lookups),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("DropsNoRoute",
+                   "Number of packets dropped because no route leads to their destination",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::GetDropsNoRoute),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("DropsTimeout",
+                   "Number of packets dropped because their budget was exhausted before the lookup",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::GetDropsTimeout),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("DropsNoFineRoute",
+                   "Number of packets dropped because every route costs more than their remaining budget",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::GetDropsNoFineRoute),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("DropsCongested",
+                   "Number of packets dropped because every budget-aware lane of a next hop was full",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::GetDropsCongested),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("DropsZeroWeight",
+                   "Number of packets dropped because no next hop could meet their budget",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4DSRRouting::GetDropsZeroWeight),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddTraceSource ("ForwardingDecision",
+                     "A budget-aware forwarding decision was made",
+                     MakeTraceSourceAccessor (&Ipv4DSRRouting::m_forwardingDecisionTrace),
+                     "ns3::Ipv4DSRRouting::ForwardingDecisionTracedCallback")
+    .AddTraceSource ("RouteUpdateTrigger",
+                     "An interface event of this router asked for a route update",
+                     MakeTraceSourceAccessor (&Ipv4DSRRouting::m_routeUpdateTriggerTrace),
+                     "ns3::Ipv4DSRRouting::RouteUpdateTriggerTracedCallback")
+    .AddTraceSource ("RouteUpdate",
+                     "The route update opened by an event of this router ran",
+                     MakeTraceSourceAccessor (&Ipv4DSRRouting::m_routeUpdateTrace),
+                     "ns3::Ipv4DSRRouting::RouteUpdateTracedCallback")
   ;
   return tid;
 }
 
 Ipv4DSRRouting::Ipv4DSRRouting () 
   : m_randomEcmpRouting (false),
-    m_respondToInterfaceEvents (false)
+    m_respondToInterfaceEvents (false),
+    m_flowCacheEnabled (false),
+    m_flowCacheMaxPackets (100),
+    m_flowCacheBudgetBucket (1000),
+    m_flowCacheOccupancy (0.5),
+    m_flowCacheHits (0),
+    m_flowCacheMisses (0),
+    m_delayEstimator (MODEL),
+    m_latencySampleInterval (64),
+    m_latencySampled (false),
+    m_table (new DsrRoutingTable ()),
+    m_nextTable (new DsrRoutingTable ()),
+    m_buildingTable (false),
+    m_routeUpdate (false)
 {
   NS_LOG_FUNCTION (this);
 
+  ResetForwardingStats ();
+
   m_rand = CreateObject<UniformRandomVariable> ();
 }
 
 Ipv4DSRRouting::~Ipv4DSRRouting ()
 {
   NS_LOG_FUNCTION (this);
+  delete m_table;
+  delete m_nextTable;
+}
+
+Ipv4DSRRouting::InterfaceInfo::InterfaceInfo ()
+  : valid (false),
+    bitRate (0)
+{
 }
 
 void 
@@ -84,9 +233,7 @@ Ipv4DSRRouting::AddHostRouteTo (Ipv4Address dest,
                                    uint32_t interface)
 {
   NS_LOG_FUNCTION (this << dest << nextHop << interface);
-  Ipv4DSRRoutingTableEntry *route = new Ipv4DSRRoutingTableEntry ();
-  *route = Ipv4DSRRoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface);
-  m_hostRoutes.push_back (route);
+  InsertHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface));
 }
 
 void 
@@ -94,9 +241,7 @@ Ipv4DSRRouting::AddHostRouteTo (Ipv4Address dest,
                                    uint32_t interface)
 {
   NS_LOG_FUNCTION (this << dest << interface);
-  Ipv4DSRRoutingTableEntry *route = new Ipv4DSRRoutingTableEntry ();
-  *route = Ipv4DSRRoutingTableEntry::CreateHostRouteTo (dest, interface);
-  m_hostRoutes.push_back (route);
+  InsertHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (dest, interface));
 }
 
 /**
@@ -116,10 +261,7 @@ Ipv4DSRRouting::AddHostRouteTo (Ipv4Address dest,
                        uint32_t distance)
 {
   NS_LOG_FUNCTION (this << dest << nextHop << interface << distance);
-  Ipv4DSRRoutingTableEntry *route = new Ipv4DSRRoutingTableEntry ();
-  // std::cout << "add host route with the distance = " << distance;
-  *route = Ipv4DSRRoutingTableEntry::CreateHostRouteTo(dest, nextHop, interface, distance);
-  m_hostRoutes.push_back (route);
+  InsertHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface, distance));
 }
 
 
@@ -131,12 +273,10 @@ Ipv4DSRRouting::AddNetworkRouteTo (Ipv4Address network,
                                       uint32_t interface)
 {
   NS_LOG_FUNCTION (this << network << networkMask << nextHop << interface);
-  Ipv4DSRRoutingTableEntry *route = new Ipv4DSRRoutingTableEntry ();
-  *route = Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (network,
-                                                        networkMask,
-                                                        nextHop,
-                                                        interface);
-  m_networkRoutes.push_back (route);
+  InsertNetworkRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (network,
+                                                                     networkMask,
+                                                                     nextHop,
+                                                                     interface));
 }
 
 void 
@@ -145,11 +285,9 @@ Ipv4DSRRouting::AddNetworkRouteTo (Ipv4Address network,
                                       uint32_t interface)
 {
   NS_LOG_FUNCTION (this << network << networkMask << interface);
-  Ipv4DSRRoutingTableEntry *route = new Ipv4DSRRoutingTableEntry ();
-  *route = Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (network,
-                                                        networkMask,
-                                                        interface);
-  m_networkRoutes.push_back (route);
+  InsertNetworkRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (network,
+                                                                     networkMask,
+                                                                     interface));
 }
 
 void 
@@ -159,12 +297,514 @@ Ipv4DSRRouting::AddASExternalRouteTo (Ipv4Address network,
                                          uint32_t interface)
 {
   NS_LOG_FUNCTION (this << network << networkMask << nextHop << interface);
-  Ipv4DSRRoutingTableEntry *route = new Ipv4DSRRoutingTableEntry ();
-  *route = Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (network,
-                                                        networkMask,
-                                                        nextHop,
-                                                        interface);
-  m_ASexternalRoutes.push_back (route);
+  InsertASExternalRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (network,
+                                                                        networkMask,
+                                                                        nextHop,
+                                                                        interface));
+}
+
+void
+Ipv4DSRRouting::InsertHostRoute (const Ipv4DSRRoutingTableEntry &route)
+{
+  if (m_routeUpdate || m_buildingTable)
+    {
+      m_nextTable->AddHostRoute (route);
+      return;
+    }
+  // sealed on first use, so that installing N routes costs one Seal
+  m_table->AddHostRoute (route);
+  TableChanged ();
+}
+
+void
+Ipv4DSRRouting::InsertNetworkRoute (const Ipv4DSRRoutingTableEntry &route)
+{
+  if (m_routeUpdate || m_buildingTable)
+    {
+      m_nextTable->AddNetworkRoute (route);
+      return;
+    }
+  // sealed on first use, so that installing N routes costs one Seal
+  m_table->AddNetworkRoute (route);
+  TableChanged ();
+}
+
+void
+Ipv4DSRRouting::InsertASExternalRoute (const Ipv4DSRRoutingTableEntry &route)
+{
+  if (m_routeUpdate || m_buildingTable)
+    {
+      m_nextTable->AddASExternalRoute (route);
+      return;
+    }
+  // sealed on first use, so that installing N routes costs one Seal
+  m_table->AddASExternalRoute (route);
+  TableChanged ();
+}
+
+void
+Ipv4DSRRouting::SealTable (void) const
+{
+  if (!m_table->IsSealed ())
+    {
+      m_table->Seal ();
+    }
+}
+
+void
+Ipv4DSRRouting::BeginRouteUpdate (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (!m_routeUpdate, "Route update already running");
+  NS_ASSERT_MSG (!m_buildingTable, "Route table being built");
+  SealTable ();
+  m_routeUpdate = true;
+  m_nextTable->Clear ();
+}
+
+uint32_t
+Ipv4DSRRouting::EndRouteUpdate (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_routeUpdate, "No route update running");
+  m_routeUpdate = false;
+  m_nextTable->Seal ();
+  uint32_t patched = m_table->CountChanges (*m_nextTable);
+  if (patched > 0)
+    {
+      uint32_t head = m_table->GetCommonHead (*m_nextTable);
+      bool sameDestinations = m_table->SameDestinations (*m_nextTable);
+      std::swap (m_table, m_nextTable);
+      TableChanged (head, sameDestinations);
+      NS_LOG_LOGIC ("Kept the caches of the first " << head << " routes");
+    }
+  m_nextTable->Clear ();
+  NS_LOG_LOGIC ("Route update patched " << patched << " entries");
+  return patched;
+}
+
+void
+Ipv4DSRRouting::BeginRouteTable (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (!m_buildingTable, "Route table already being built");
+  NS_ASSERT_MSG (!m_routeUpdate, "Route update running");
+  m_buildingTable = true;
+  m_nextTable->Clear ();
+}
+
+uint32_t
+Ipv4DSRRouting::CommitRouteTable (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_buildingTable, "No route table being built");
+  m_buildingTable = false;
+  m_nextTable->Seal ();
+  std::swap (m_table, m_nextTable);
+  TableChanged ();
+  m_nextTable->Clear ();
+  NS_LOG_LOGIC ("Committed a table of " << m_table->GetNRoutes () << " routes");
+  return m_table->GetNRoutes ();
+}
+
+void
+Ipv4DSRRouting::ClearRoutes (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_table->Clear ();
+  TableChanged ();
+}
+
+void
+Ipv4DSRRouting::TableChanged (uint32_t head, bool sameDestinations)
+{
+//
+// The route identifiers from head on may now name other routes.  A flow
+// cache decision also depends on the destination its lookup matched, which
+// only stays put when the set of destinations did.
+//
+  if (m_ipv4RouteCache.size () > head)
+    {
+      m_ipv4RouteCache.resize (head);
+    }
+  if (head == 0 || !sameDestinations)
+    {
+      FlushFlowCache ();
+      return;
+    }
+  for (FlowCache::iterator i = m_flowCache.begin (); i != m_flowCache.end (); )
+    {
+      if (i->second.route >= head)
+        {
+          i = m_flowCache.erase (i);
+        }
+      else
+        {
+          i++;
+        }
+    }
+}
+
+
+void
+Ipv4DSRRouting::AddRouterAddress (Ipv4Address address, Ipv4Address routerId)
+{
+  NS_LOG_FUNCTION (address << routerId);
+  g_routerAddresses.insert (std::make_pair (address.Get (), routerId.Get ()));
+}
+
+void
+Ipv4DSRRouting::ClearRouterAddresses (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  g_routerAddresses.clear ();
+}
+
+bool
+Ipv4DSRRouting::GetRouterOf (Ipv4Address dest, Ipv4Address &routerId)
+{
+  if (g_routerAddresses.empty ())
+    {
+      return false;
+    }
+  std::unordered_map<uint32_t, uint32_t>::const_iterator i = g_routerAddresses.find (dest.Get ());
+  if (i == g_routerAddresses.end () || i->second == dest.Get ())
+    {
+      return false;
+    }
+  routerId = Ipv4Address (i->second);
+  return true;
+}
+
+uint32_t
+Ipv4DSRRouting::FindBestHostRoute (Ipv4Address dest) const
+{
+  uint32_t best = m_table->FindBestHostRoute (dest);
+  Ipv4Address routerId;
+  if (best == DsrRoutingTable::NO_ROUTE && GetRouterOf (dest, routerId))
+    {
+      best = m_table->FindBestHostRoute (routerId);
+    }
+  return best;
+}
+
+uint32_t
+Ipv4DSRRouting::LookupHostRoutes (Ipv4Address dest, Ptr<NetDevice> oif, RouteVec_t &routes) const
+{
+  uint32_t n = m_table->LookupHostRoutes (dest, OutputInterface (oif), routes);
+  Ipv4Address routerId;
+  if (n == 0 && GetRouterOf (dest, routerId))
+    {
+      NS_LOG_LOGIC ("Looking for host routes to router " << routerId);
+      n = m_table->LookupHostRoutes (routerId, OutputInterface (oif), routes);
+    }
+  return n;
+}
+
+int32_t
+Ipv4DSRRouting::OutputInterface (Ptr<NetDevice> oif) const
+{
+  if (oif == 0)
+    {
+      return -1;
+    }
+  int32_t interface = m_ipv4->GetInterfaceForDevice (oif);
+  // an unknown device matches no route rather than every route
+  return interface < 0 ? static_cast<int32_t> (m_ipv4->GetNInterfaces ()) : interface;
+}
+
+const Ipv4DSRRouting::InterfaceInfo &
+Ipv4DSRRouting::GetInterfaceInfo (uint32_t interface)
+{
+  if (interface >= m_interfaceCache.size ())
+    {
+      m_interfaceCache.resize (m_ipv4->GetNInterfaces ());
+    }
+  NS_ASSERT (interface < m_interfaceCache.size ());
+  InterfaceInfo &info = m_interfaceCache[interface];
+  if (info.valid)
+    {
+      return info;
+    }
+
+  NS_LOG_LOGIC ("Building descriptor of interface " << interface);
+  info.device = m_ipv4->GetNetDevice (interface);
+  DataRateValue dataRate;
+  info.bitRate = info.device->GetAttributeFailSafe ("DataRate", dataRate) ? dataRate.Get ().GetBitRate () : 0;
+  info.lanes.clear ();
+  Ptr<TrafficControlLayer> tc = m_ipv4->GetObject<Node> ()->GetObject<TrafficControlLayer> ();
+  Ptr<QueueDisc> qdisc = tc != 0 ? tc->GetRootQueueDiscOnDevice (info.device) : 0;
+  if (qdisc != 0)
+    {
+      for (uint32_t k = 0; k < qdisc->GetNInternalQueues (); k++)
+        {
+          info.lanes.push_back (qdisc->GetInternalQueue (k));
+        }
+      // the lane configuration comes from the queue disc, so the delay
+      // estimates follow it
+      Ptr<DsrVirtualQueueDisc> dsrQdisc = DynamicCast<DsrVirtualQueueDisc> (qdisc);
+      bool configured = dsrQdisc != 0 && dsrQdisc->GetNLanes () == info.lanes.size ();
+      info.dsrQdisc = configured ? dsrQdisc : 0;
+      info.laneCapacity.resize (info.lanes.size ());
+      info.laneShare.resize (info.lanes.size ());
+      for (uint32_t k = 0; k < info.lanes.size (); k++)
+        {
+          info.laneCapacity[k] = configured ? dsrQdisc->GetLaneCapacity (k)
+                                            : info.lanes[k]->GetMaxSize ().GetValue ();
+          info.laneShare[k] = configured ? dsrQdisc->GetLaneShare (k) : 1.0 / info.lanes.size ();
+        }
+      // without a queue disc the descriptor is rebuilt until one is installed
+      info.valid = true;
+    }
+  return info;
+}
+
+void
+Ipv4DSRRouting::InvalidateInterfaceCache (void)
+{
+  NS_LOG_FUNCTION (this);
+  // cached routes carry the interface address
+  m_ipv4RouteCache.clear ();
+  FlushFlowCache ();
+  for (std::vector<InterfaceInfo>::iterator i = m_interfaceCache.begin ();
+       i != m_interfaceCache.end ();
+       i++)
+    {
+      i->valid = false;
+    }
+}
+
+double
+Ipv4DSRRouting::EstimateLaneDelay (const InterfaceInfo &info, uint32_t lane, double packetTime) const
+{
+  double transmit = packetTime / info.laneShare[lane];
+  if (m_delayEstimator == MODEL || info.dsrQdisc == 0)
+    {
+      return (info.lanes[lane]->GetCurrentSize ().GetValue () + 1) * transmit;
+    }
+  uint32_t backlog = info.dsrQdisc->GetLaneBacklog (lane);
+  if (backlog == 0)
+    {
+      // the last samples of an idle lane say nothing of the next packet
+      return transmit;
+    }
+  double queued = backlog * 8 * 1000.0 / info.bitRate / info.laneShare[lane];
+  Time sojourn = m_delayEstimator == MEASURED ? info.dsrQdisc->GetLaneSojourn (lane)
+                                               : info.dsrQdisc->GetLaneMaxSojourn (lane);
+  return std::max (queued, sojourn.GetSeconds () * 1000) + transmit;
+}
+
+void
+Ipv4DSRRouting::NotifyDataRateChange (uint32_t interface)
+{
+  NS_LOG_FUNCTION (this << interface);
+  if (interface < m_interfaceCache.size ())
+    {
+      m_interfaceCache[interface].valid = false;
+    }
+}
+
+Ptr<Ipv4Route>
+Ipv4DSRRouting::GetIpv4Route (uint32_t route)
+{
+  if (m_ipv4RouteCache.size () <= route)
+    {
+      m_ipv4RouteCache.resize (m_table->GetNRoutes ());
+    }
+  Ptr<Ipv4Route> &rtentry = m_ipv4RouteCache[route];
+  if (rtentry != 0)
+    {
+      return rtentry;
+    }
+  // create a Ipv4Route object from the selected routing table entry
+  uint32_t interface = m_table->GetInterface (route);
+  rtentry = Create<Ipv4Route> ();
+  rtentry->SetDestination (m_table->GetDest (route));
+  /// \todo handle multi-address case
+  rtentry->SetSource (m_ipv4->GetAddress (interface, 0).GetLocal ());
+  rtentry->SetGateway (m_table->GetGateway (route));
+  rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interface));
+  return rtentry;
+}
+
+uint32_t
+Ipv4DSRRouting::LookupFlowCache (Ipv4Address dest, uint32_t budget, uint32_t &lane)
+{
+  uint64_t key = (static_cast<uint64_t> (dest.Get ()) << 32) | (budget / m_flowCacheBudgetBucket);
+  FlowCache::iterator i = m_flowCache.find (key);
+  if (i == m_flowCache.end ())
+    {
+      m_flowCacheMisses++;
+      return DsrRoutingTable::NO_ROUTE;
+    }
+  FlowCacheEntry &entry = i->second;
+  if (Simulator::Now () >= entry.expires
+      || entry.packetsLeft == 0
+      || m_table->GetDistance (entry.route) >= budget
+      || GetInterfaceInfo (m_table->GetInterface (entry.route)).lanes[entry.lane]->GetCurrentSize ().GetValue () >= entry.occupancyLimit)
+    {
+      NS_LOG_LOGIC ("Cached decision for " << dest << " is stale");
+      m_flowCache.erase (i);
+      m_flowCacheMisses++;
+      return DsrRoutingTable::NO_ROUTE;
+    }
+  entry.packetsLeft--;
+  m_flowCacheHits++;
+  lane = entry.lane;
+  return entry.route;
+}
+
+void
+Ipv4DSRRouting::CacheFlowDecision (Ipv4Address dest, uint32_t budget, uint32_t route,
+                                   uint32_t lane, uint32_t laneBuffer)
+{
+  uint32_t occupancyLimit = static_cast<uint32_t> (m_flowCacheOccupancy * laneBuffer);
+  if (GetInterfaceInfo (m_table->GetInterface (route)).lanes[lane]->GetCurrentSize ().GetValue () >= occupancyLimit)
+    {
+      // a decision taken under congestion is not worth reusing
+      return;
+    }
+  uint64_t key = (static_cast<uint64_t> (dest.Get ()) << 32) | (budget / m_flowCacheBudgetBucket);
+  FlowCacheEntry &entry = m_flowCache[key];
+  entry.route = route;
+  entry.lane = lane;
+  entry.expires = Simulator::Now () + m_flowCacheTimeout;
+  entry.packetsLeft = m_flowCacheMaxPackets - 1;
+  entry.occupancyLimit = occupancyLimit;
+}
+
+void
+Ipv4DSRRouting::FlushFlowCache (void)
+{
+  if (!m_flowCache.empty ())
+    {
+      m_flowCache.clear ();
+    }
+}
+
+uint64_t
+Ipv4DSRRouting::GetFlowCacheHits (void) const
+{
+  return m_flowCacheHits;
+}
+
+uint64_t
+Ipv4DSRRouting::GetFlowCacheMisses (void) const
+{
+  return m_flowCacheMisses;
+}
+
+uint64_t
+Ipv4DSRRouting::GetDrops (uint8_t reason) const
+{
+  NS_ASSERT (reason < DsrForwardingDecision::DROP_REASONS);
+  return m_drops[reason];
+}
+
+uint64_t
+Ipv4DSRRouting::GetDropsNoRoute (void) const
+{
+  return m_drops[DsrForwardingDecision::DROP_NO_ROUTE];
+}
+
+uint64_t
+Ipv4DSRRouting::GetDropsTimeout (void) const
+{
+  return m_drops[DsrForwardingDecision::DROP_TIMEOUT];
+}
+
+uint64_t
+Ipv4DSRRouting::GetDropsNoFineRoute (void) const
+{
+  return m_drops[DsrForwardingDecision::DROP_NO_FINE_ROUTE];
+}
+
+uint64_t
+Ipv4DSRRouting::GetDropsCongested (void) const
+{
+  return m_drops[DsrForwardingDecision::DROP_CONGESTED];
+}
+
+uint64_t
+Ipv4DSRRouting::GetDropsZeroWeight (void) const
+{
+  return m_drops[DsrForwardingDecision::DROP_ZERO_WEIGHT];
+}
+
+const std::vector<uint64_t> &
+Ipv4DSRRouting::GetCandidateHistogram (void) const
+{
+  return m_candidateHistogram;
+}
+
+const std::vector<uint64_t> &
+Ipv4DSRRouting::GetLaneHistogram (void) const
+{
+  return m_laneHistogram;
+}
+
+const std::vector<uint64_t> &
+Ipv4DSRRouting::GetLatencyHistogram (void) const
+{
+  return m_latencyHistogram;
+}
+
+void
+Ipv4DSRRouting::ResetForwardingStats (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_lookups = 0;
+  for (uint32_t i = 0; i < DsrForwardingDecision::DROP_REASONS; i++)
+    {
+      m_drops[i] = 0;
+    }
+  m_candidateHistogram.assign (17, 0);
+  m_laneHistogram.assign (DsrForwardingDecision::MAX_LANES, 0);
+  m_latencyHistogram.assign (32, 0);
+  m_flowCacheHits = 0;
+  m_flowCacheMisses = 0;
+}
+
+void
+Ipv4DSRRouting::PrintForwardingStats (Ptr<OutputStreamWrapper> stream) const
+{
+  std::ostream* os = stream->GetStream ();
+  *os << "Node: " << m_ipv4->GetObject<Node> ()->GetId ()
+      << ", Time: " << Now().As (Time::S)
+      << ", Local time: " << m_ipv4->GetObject<Node> ()->GetLocalTime ().As (Time::S)
+      << ", Ipv4DSRRouting forwarding statistics" << std::endl;
+  *os << "  lookups " << m_lookups
+      << " flow-cache-hits " << m_flowCacheHits
+      << " flow-cache-misses " << m_flowCacheMisses << std::endl;
+  *os << "  forwarded " << m_drops[DsrForwardingDecision::NOT_DROPPED]
+      << " no-route " << m_drops[DsrForwardingDecision::DROP_NO_ROUTE]
+      << " timeout " << m_drops[DsrForwardingDecision::DROP_TIMEOUT]
+      << " no-fine-route " << m_drops[DsrForwardingDecision::DROP_NO_FINE_ROUTE]
+      << " congested " << m_drops[DsrForwardingDecision::DROP_CONGESTED]
+      << " zero-weight " << m_drops[DsrForwardingDecision::DROP_ZERO_WEIGHT] << std::endl;
+  *os << "  candidates";
+  for (uint32_t i = 0; i < m_candidateHistogram.size (); i++)
+    {
+      if (m_candidateHistogram[i] != 0)
+        {
+          *os << " " << i << (i + 1 == m_candidateHistogram.size () ? "+" : "")
+              << ":" << m_candidateHistogram[i];
+        }
+    }
+  *os << std::endl << "  lanes";
+  for (uint32_t i = 0; i < m_laneHistogram.size (); i++)
+    {
+      *os << " " << i << ":" << m_laneHistogram[i];
+    }
+  *os << std::endl << "  lookup-ns";
+  for (uint32_t i = 0; i < m_latencyHistogram.size (); i++)
+    {
+      if (m_latencyHistogram[i] != 0)
+        {
+          *os << " <" << (uint64_t (1) << (i + 1)) << ":" << m_latencyHistogram[i];
+        }
+    }
+  *os << std::endl;
 }
 
 
@@ -179,78 +819,37 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<NetDevice> oif)
 
   NS_LOG_FUNCTION (this << dest << oif);
   NS_LOG_LOGIC ("Looking for route for destination " << dest);
+  SealTable ();
+  if (oif == 0)
+    {
+      // best effort fast path: the shortest host route is precomputed
+      uint32_t best = FindBestHostRoute (dest);
+      if (best != DsrRoutingTable::NO_ROUTE)
+        {
+          NS_LOG_LOGIC ("Found best dsr host route " << best);
+          return GetIpv4Route (best);
+        }
+    }
   Ptr<Ipv4Route> rtentry = 0;
   // store all available routes that bring packets to their destination
-  typedef std::vector<Ipv4DSRRoutingTableEntry*> RouteVec_t;
-  RouteVec_t allRoutes;
+  RouteVec_t &allRoutes = m_allRoutes;
+  allRoutes.clear ();
 
-  NS_LOG_LOGIC ("Number of m_hostRoutes = " << m_hostRoutes.size ());
-  for (HostRoutesCI i = m_hostRoutes.begin (); 
-       i != m_hostRoutes.end (); 
-       i++) 
+  NS_LOG_LOGIC ("Number of host routes = " << m_table->GetNHostRoutes ());
+  if (LookupHostRoutes (dest, oif, allRoutes) > 0)
     {
-      NS_ASSERT ((*i)->IsHost ());
-      if ((*i)->GetDest () == dest)
-        {
-          if (oif != 0)
-            {
-              if (oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
-                {
-                  NS_LOG_LOGIC ("Not on requested interface, skipping");
-                  continue;
-                }
-            }
-          allRoutes.push_back (*i);
-          NS_LOG_LOGIC (allRoutes.size () << "Found dsr host route" << *i); 
-        }
+      NS_LOG_LOGIC (allRoutes.size () << " dsr host routes found");
     }
   if (allRoutes.size () == 0) // if no host route is found
     {
-      NS_LOG_LOGIC ("Number of m_networkRoutes" << m_networkRoutes.size ());
-      for (NetworkRoutesI j = m_networkRoutes.begin (); 
-           j != m_networkRoutes.end (); 
-           j++) 
-        {
-          Ipv4Mask mask = (*j)->GetDestNetworkMask ();
-          Ipv4Address entry = (*j)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry)) 
-            {
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*j)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*j);
-              NS_LOG_LOGIC (allRoutes.size () << "Found DSR network route" << *j);
-            }
-        }
+      NS_LOG_LOGIC ("Number of network routes = " << m_table->GetNNetworkRoutes ());
+      m_table->LookupNetworkRoutes (dest, OutputInterface (oif), allRoutes);
+      NS_LOG_LOGIC (allRoutes.size () << " DSR network routes found");
     }
   if (allRoutes.size () == 0)  // consider external if no host/network found
     {
-      for (ASExternalRoutesI k = m_ASexternalRoutes.begin ();
-           k != m_ASexternalRoutes.end ();
-           k++)
-        {
-          Ipv4Mask mask = (*k)->GetDestNetworkMask ();
-          Ipv4Address entry = (*k)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry))
-            {
-              NS_LOG_LOGIC ("Found external route" << *k);
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*k)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*k);
-              break;
-            }
-        }
+      m_table->LookupASExternalRoutes (dest, OutputInterface (oif), allRoutes);
+      NS_LOG_LOGIC (allRoutes.size () << " external routes found");
     }
   if (allRoutes.size () > 0 ) // if route(s) is found
     {
@@ -265,22 +864,16 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<NetDevice> oif)
       uint32_t flagCost = 0;
       for (uint32_t i = 0; i < allRoutes.size (); i ++)
       {
-        flagCost = allRoutes.at (flagNum)->GetDistance ();
-        if (allRoutes.at (i)->GetDistance () <  flagCost)
+        flagCost = m_table->GetDistance (allRoutes.at (flagNum));
+        if (m_table->GetDistance (allRoutes.at (i)) <  flagCost)
         {
           flagNum = i;
         }
       }
-      Ipv4DSRRoutingTableEntry* route = allRoutes.at (flagNum);
-
-      // create a Ipv4Route object from the selected routing table entry
-      rtentry = Create<Ipv4Route> ();
-      rtentry->SetDestination (route->GetDest ());
-      /// \todo handle multi-address case
-      rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
-      rtentry->SetGateway (route->GetGateway ());
-      uint32_t interfaceIdx = route->GetInterface ();
-      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
+      uint32_t route = allRoutes.at (flagNum);
+
+      // get the Ipv4Route object of the selected routing table entry
+      rtentry = GetIpv4Route (route);
       /**
        * \author Pu Yang
        * \brief set the distance
@@ -296,7 +889,8 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<NetDevice> oif)
 }
 
 Ptr<Ipv4Route>
-Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<Packet> p, Ptr<NetDevice> oif)
+Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<const Packet> p, const DsrMetaTag &metaTag,
+                                uint32_t &lane, Ptr<NetDevice> oif)
 {
   /**
    * \author Pu Yang
@@ -306,79 +900,41 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<Packet> p, Ptr<NetDevice>
 
   NS_LOG_FUNCTION (this << dest << oif);
   NS_LOG_LOGIC ("Looking for route for destination " << dest);
+  SealTable ();
   Ptr<Ipv4Route> rtentry = 0;
   // store all available routes that bring packets to their destination
-  typedef std::vector<Ipv4DSRRoutingTableEntry*> RouteVec_t;
-  RouteVec_t allRoutes;
+  RouteVec_t &allRoutes = m_allRoutes;
+  allRoutes.clear ();
+  // the decision record is only filled when somebody listens
+  bool record = !m_forwardingDecisionTrace.IsEmpty ();
+  if (record)
+    {
+      BeginDecision (dest, p, metaTag);
+    }
+  m_latencySampled = m_latencySampleInterval != 0 && m_lookups % m_latencySampleInterval == 0;
+  if (m_latencySampled)
+    {
+      m_lookupStart = std::chrono::steady_clock::now ();
+    }
+  m_lookups++;
 
-  NS_LOG_LOGIC ("Number of m_hostRoutes = " << m_hostRoutes.size ());
-  for (HostRoutesCI i = m_hostRoutes.begin (); 
-       i != m_hostRoutes.end (); 
-       i++) 
+  NS_LOG_LOGIC ("Number of host routes = " << m_table->GetNHostRoutes ());
+  if (LookupHostRoutes (dest, oif, allRoutes) > 0)
     {
-      NS_ASSERT ((*i)->IsHost ());
-      if ((*i)->GetDest () == dest)
-        {
-          if (oif != 0)
-            {
-              if (oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
-                {
-                  NS_LOG_LOGIC ("Not on requested interface, skipping");
-                  continue;
-                }
-            }
-          allRoutes.push_back (*i);
-          NS_LOG_LOGIC (allRoutes.size () << "Found dsr host route" << *i << " with Cost: " << (*i)->GetDistance ()); 
-        }
+      NS_LOG_LOGIC (allRoutes.size () << " dsr host routes found");
     }
   if (allRoutes.size () == 0) // if no host route is found
     {
-      NS_LOG_LOGIC ("Number of m_networkRoutes" << m_networkRoutes.size ());
-      for (NetworkRoutesI j = m_networkRoutes.begin (); 
-           j != m_networkRoutes.end (); 
-           j++) 
-        {
-          Ipv4Mask mask = (*j)->GetDestNetworkMask ();
-          Ipv4Address entry = (*j)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry)) 
-            {
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*j)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*j);
-              NS_LOG_LOGIC (allRoutes.size () << "Found DSR network route" << *j);
-            }
-        }
+      NS_LOG_LOGIC ("Number of network routes = " << m_table->GetNNetworkRoutes ());
+      m_table->LookupNetworkRoutes (dest, OutputInterface (oif), allRoutes);
+      NS_LOG_LOGIC (allRoutes.size () << " DSR network routes found");
     }
   if (allRoutes.size () == 0)  // consider external if no host/network found
     {
-      for (ASExternalRoutesI k = m_ASexternalRoutes.begin ();
-           k != m_ASexternalRoutes.end ();
-           k++)
-        {
-          Ipv4Mask mask = (*k)->GetDestNetworkMask ();
-          Ipv4Address entry = (*k)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry))
-            {
-              NS_LOG_LOGIC ("Found external route" << *k);
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*k)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*k);
-              break;
-            }
-        }
+      m_table->LookupASExternalRoutes (dest, OutputInterface (oif), allRoutes);
+      NS_LOG_LOGIC (allRoutes.size () << " external routes found");
     }
+  m_candidateHistogram[std::min<size_t> (allRoutes.size (), m_candidateHistogram.size () - 1)]++;
   if (allRoutes.size () > 0 ) // if route(s) is found
     {
       /**
@@ -386,25 +942,42 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<Packet> p, Ptr<NetDevice>
        * \todo get all the possible route to the destination, and weight randomly
        * select a possbile route  
       */
-      FlagTag flagTag;
-      p->PeekPacketTag (flagTag);
-      BudgetTag budgetTag;
-      p->PeekPacketTag (budgetTag);
-      TimestampTag timestampTag;
-      p->PeekPacketTag (timestampTag);
-
-      if (budgetTag.GetBudget () + timestampTag.GetMicroSeconds () < Simulator::Now().GetMicroSeconds ())
+      int64_t deadline = metaTag.GetTimestamp ().GetMicroSeconds () + metaTag.GetBudget (); // in Microseconds
+      if (deadline < Simulator::Now().GetMicroSeconds ())
       {
         NS_LOG_INFO ("TIMEOUT DROP !!!");
+        EndDecision (DsrForwardingDecision::DROP_TIMEOUT, DsrRoutingTable::NO_ROUTE, 0, record);
         return 0;
       }
 
-      uint32_t budget = budgetTag.GetBudget () + timestampTag.GetMicroSeconds () - Simulator::Now().GetMicroSeconds (); // in Microseconds
+      uint32_t budget = deadline - Simulator::Now().GetMicroSeconds (); // in Microseconds
+      if (record)
+        {
+          m_decision.budget = budget;
+          m_decision.nRoutes = allRoutes.size ();
+        }
+
+      bool useFlowCache = m_flowCacheEnabled && !metaTag.GetFlag () && oif == 0;
+      if (useFlowCache)
+        {
+          uint32_t cached = LookupFlowCache (dest, budget, lane);
+          if (cached != DsrRoutingTable::NO_ROUTE)
+            {
+              if (record)
+                {
+                  m_decision.fromFlowCache = 1;
+                }
+              EndDecision (DsrForwardingDecision::NOT_DROPPED, cached, lane, record);
+              return GetIpv4Route (cached);
+            }
+        }
 
       // std::cout << "budget = " << budgetTag.GetBudget () << "\n";
       // std::cout << "Old Allroute size = "<< allRoutes.size () << std::endl;
-      RouteVec_t fineRoutes;
-      RouteVec_t goodRoutes;
+      RouteVec_t &fineRoutes = m_fineRoutes;
+      RouteVec_t &goodRoutes = m_goodRoutes;
+      fineRoutes.clear ();
+      goodRoutes.clear ();
       double cost = 0;
       double avgCost = 0;
       uint32_t numFineRoute = 0;
@@ -414,23 +987,16 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<Packet> p, Ptr<NetDevice>
         {
           // std::cout << "All Distance: " << allRoutes.at(i)->GetDistance () << std::endl;
           // use FINEROUTE to filter out route beyond packet cost
-          if (allRoutes.at(i)->GetDistance () < budget) // push route i to fineRoute if the current budget > route i's cost
+          if (m_table->GetDistance (allRoutes.at(i)) < budget) // push route i to fineRoute if the current budget > route i's cost
             {
               fineRoutes.push_back(allRoutes.at (i));  // BUG: Route not properly erased
-              NS_LOG_LOGIC ("FINEROUTE CURRENT NODE GATEWAY " << allRoutes.at (i)->GetGateway());
-              cost += allRoutes.at(i)->GetDistance ();
+              NS_LOG_LOGIC ("FINEROUTE CURRENT NODE GATEWAY " << m_table->GetGateway (allRoutes.at (i)));
+              cost += m_table->GetDistance (allRoutes.at(i));
               numFineRoute ++;
             }
           else
             {
-              NS_LOG_INFO (" DROP ROUTE: " << allRoutes.at(i)->GetGateway () << " COST: "<< allRoutes.at(i)->GetDistance () );
-              if (flagTag.GetFlagTag () == true)
-              {
-                uint32_t q_fast = m_ipv4->GetNetDevice (allRoutes.at(i)->GetInterface ())->GetNode ()->GetObject<TrafficControlLayer> ()->GetRootQueueDiscOnDevice (m_ipv4->GetNetDevice(allRoutes.at (i)->GetInterface()))->GetInternalQueue (0)->GetCurrentSize ().GetValue ();
-                uint32_t q_slow = m_ipv4->GetNetDevice (allRoutes.at(i)->GetInterface ())->GetNode ()->GetObject<TrafficControlLayer> ()->GetRootQueueDiscOnDevice (m_ipv4->GetNetDevice(allRoutes.at (i)->GetInterface()))->GetInternalQueue (1)->GetCurrentSize ().GetValue ();
-                std::cout << "q_fast: "<< q_fast << " q_slow: " << q_slow << std::endl;
-                std::cout << "Budget: "<< budget << " DROP ROUTE: "<< i << std::endl;
-              }
+              NS_LOG_INFO (" DROP ROUTE: " << m_table->GetGateway (allRoutes.at(i)) << " COST: "<< m_table->GetDistance (allRoutes.at(i)) );
             }
         }
       NS_LOG_INFO (" FINEROUTE SIZE: "<< fineRoutes.size());
@@ -438,28 +1004,29 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<Packet> p, Ptr<NetDevice>
       if (numFineRoute == 0)
         {
           NS_LOG_ERROR ("NO ROUTE !!! " );
-          if (flagTag.GetFlagTag () == true)
-            {
-              std::cout << "Budget: "<< budget<< " DROP PACKET: NO ROUTE" << std::endl;
-            }
+          EndDecision (DsrForwardingDecision::DROP_NO_FINE_ROUTE, DsrRoutingTable::NO_ROUTE, 0, record);
           return 0;
         }
+      if (record)
+        {
+          m_decision.nFineRoutes = numFineRoute;
+        }
       
       avgCost = cost / numFineRoute + 1500;
 
       // use GOODROUTE to filter avoid loop when budget is sufficient
       for (uint32_t i = 0; i < fineRoutes.size (); i ++)
       {
-        double flag = fineRoutes.at(i)->GetDistance () * 1.0 ; // In MicroSeconds
+        double flag = m_table->GetDistance (fineRoutes.at(i)) * 1.0 ; // In MicroSeconds
         // std::cout<< "avgCost: " << avgCost << "   " << "route Cost: " << flag << std::endl;
         if (flag <= avgCost)                
         {
           goodRoutes.push_back(fineRoutes.at (i));  // BUG: Route not properly erased
-          NS_LOG_LOGIC ("GOODROUTE CURRENT NODE GATEWAY " << allRoutes.at (i)->GetGateway());
+          NS_LOG_LOGIC ("GOODROUTE CURRENT NODE GATEWAY " << m_table->GetGateway (allRoutes.at (i)));
         }
         else
         {
-          NS_LOG_INFO (" DROP ROUTE: " << fineRoutes.at(i)->GetGateway () << " COST: "<< fineRoutes.at(i)->GetDistance () );
+          NS_LOG_INFO (" DROP ROUTE: " << m_table->GetGateway (fineRoutes.at(i)) << " COST: "<< m_table->GetDistance (fineRoutes.at(i)) );
         }
       }
         
@@ -474,105 +1041,113 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<Packet> p, Ptr<NetDevice>
       // std::sort (allRoutes.begin (), allRoutes.end (), CompareRouteCost);
 
 
-      uint32_t internalNqueue = m_ipv4->GetNetDevice (0)->GetNode ()->GetObject<TrafficControlLayer> ()-> GetRootQueueDiscOnDevice (m_ipv4->GetNetDevice(goodRoutes.at (0)->GetInterface()))->GetNInternalQueues();
-      uint32_t bf_fast = 12;
-      uint32_t bf_slow = 36;
+      // the budget-aware lanes are every lane but the last, best-effort one
+      uint32_t nLanes = 0;
+      for (uint32_t i = 0; i < goodRoutes.size (); i++)
+        {
+          uint32_t n = GetInterfaceInfo (m_table->GetInterface (goodRoutes.at (i))).lanes.size ();
+          NS_ASSERT_MSG (n > 1, "DSR forwarding needs a root queue disc with budget-aware and best-effort lanes");
+          nLanes = std::max (nLanes, n - 1);
+        }
+      if (record)
+        {
+          m_decision.nCandidates = goodRoutes.size ();
+        }
 
-      double weight[goodRoutes.size ()* (internalNqueue - 1)];  // Exclude best-effort lane
+      std::vector<double> &weight = m_weights;
+      weight.assign (goodRoutes.size () * nLanes, 0.0);  // Exclude best-effort lane
       double tempSum = 0;
       for (uint32_t i = 0; i < goodRoutes.size (); i ++)
       {
         double dn = 0.0;
         // weight[i] = 1.0 / (m_ipv4->GetNetDevice (allRoutes.at(i)->GetInterface ())->GetNode ()->GetObject<TrafficControlLayer> ()->GetRootQueueDiscOnDevice (m_ipv4->GetNetDevice(allRoutes.at (i)->GetInterface()))->GetCurrentSize ().GetValue () + 0.01);
-        if (budget < goodRoutes.at (i)->GetDistance())
+        if (budget < m_table->GetDistance (goodRoutes.at (i)))
         {
           dn = 0.0 ;
         }
         else
         {
-          dn = (budget - goodRoutes.at (i)->GetDistance()) * 1.0; // dn: per-hop budget in Microseconds
+          dn = (budget - m_table->GetDistance (goodRoutes.at (i))) * 1.0; // dn: per-hop budget in Microseconds
           dn = dn/1000; // in Milliseconds
         }
-        // ql_fast: fast lane queue length;  ql_slow: slow lane queue length; bf: buffer size
-        uint32_t ql_fast = m_ipv4->GetNetDevice (goodRoutes.at(i)->GetInterface ())->GetNode ()->GetObject<TrafficControlLayer> ()->GetRootQueueDiscOnDevice (m_ipv4->GetNetDevice(goodRoutes.at (i)->GetInterface()))->GetInternalQueue (0)->GetCurrentSize ().GetValue ();
-        uint32_t ql_slow = m_ipv4->GetNetDevice (goodRoutes.at(i)->GetInterface ())->GetNode ()->GetObject<TrafficControlLayer> ()->GetRootQueueDiscOnDevice (m_ipv4->GetNetDevice(goodRoutes.at (i)->GetInterface()))->GetInternalQueue (1)->GetCurrentSize ().GetValue ();
+        // ql: lane queue length; bf: lane buffer size; share: lane share of the link
+        const InterfaceInfo &info = GetInterfaceInfo (m_table->GetInterface (goodRoutes.at (i)));
+        uint32_t laneCount = info.lanes.size () - 1;
         uint32_t packet_size = p->GetSize ();
-        uint32_t linkrate;
-        Ptr<NetDevice> device = m_ipv4->GetNetDevice (goodRoutes.at (i)->GetInterface ());
-        DataRateValue dataRate;
-        device->GetAttribute ("DataRate", dataRate);
-        linkrate = dataRate.Get().GetBitRate ();
-        double bound_fast = ((bf_fast)*packet_size*8 / (0.5*linkrate))*1000; 
-        double bound_slow = ((bf_slow)*packet_size*8 / (0.3*linkrate))*1000; // in Milliseconds
-
-        if (ql_fast == bf_fast && ql_slow == bf_slow)
-        {
-          NS_LOG_ERROR ("All next-hops are congested!! Drop packet");
-          if (flagTag.GetFlagTag () == true)
+        NS_ABORT_MSG_IF (info.bitRate == 0, "DSR forwarding needs the DataRate of the output device of interface "
+                         << m_table->GetInterface (goodRoutes.at (i)));
+        double packetTime = packet_size*8*1000.0 / info.bitRate; // in Milliseconds, at the full link rate
+
+        if (record && i < DsrForwardingDecision::MAX_CANDIDATES)
+          {
+            DsrForwardingDecision::Candidate &candidate = m_decision.candidates[i];
+            candidate.gateway = m_table->GetGateway (goodRoutes.at (i)).Get ();
+            candidate.interface = m_table->GetInterface (goodRoutes.at (i));
+            candidate.distance = m_table->GetDistance (goodRoutes.at (i));
+            for (uint32_t k = 0; k < DsrForwardingDecision::MAX_LANES; k++)
+              {
+                candidate.queueLength[k] = k < laneCount ? info.lanes[k]->GetCurrentSize ().GetValue () : 0;
+                candidate.weight[k] = 0.0;
+              }
+          }
+
+        // the delay bound of a lane is that of a packet at the back of the full lane
+        bool congested = true;
+        double bound_min = 0;
+        double bound_max = 0;
+        for (uint32_t k = 0; k < laneCount; k++)
           {
-            std::cout << "DROP PACKETS: TIME OUT DUE TO CONGESTION" << std::endl;
+            uint32_t ql = info.lanes[k]->GetCurrentSize ().GetValue ();
+            double bound = info.laneCapacity[k] * packetTime / info.laneShare[k];
+            congested = congested && ql >= info.laneCapacity[k];
+            bound_min = k == 0 ? bound : std::min (bound_min, bound);
+            bound_max = k == 0 ? bound : std::max (bound_max, bound);
           }
+        if (congested)
+        {
+          NS_LOG_ERROR ("All next-hops are congested!! Drop packet");
+          EndDecision (DsrForwardingDecision::DROP_CONGESTED, DsrRoutingTable::NO_ROUTE, 0, record);
           return 0;
         }
         
-        double edq_fast = ((ql_fast+1)*packet_size*8 / (0.5*linkrate))*1000;  // in Milliseconds
-        double edq_slow = ((ql_slow+1)*packet_size*8 / (0.3*linkrate))*1000;
         double dnn = std::max(dn, 0.0); // in Milliseconds
-        double delayFlag;
+        double delayFlag = std::min (std::max (dnn, bound_min), bound_max);
 
-        if (dnn >= bound_slow)
-        {
-          delayFlag = bound_slow;
-        }
-        if (dnn >= bound_fast && dnn < bound_slow)
-        {
-          delayFlag = dnn;
-        }
-        if (dnn < bound_fast)
-        {
-          delayFlag = bound_fast;
-        }
-        weight[2*i] = std::max(delayFlag - edq_fast, 0.0 ) * 0.1;
-        weight[2*i+1] = std::max(delayFlag - edq_slow, 0.0 ) * 0.1;
-
-        if (ql_fast > bf_fast - 5)
-        {
-          weight[2*i] = bound_fast - edq_fast;
-        }
-        if (ql_slow > bf_slow - 5)
-        {
-          weight[2*i+1] = bound_slow - edq_slow;
-        }
-
-        
-        tempSum += (weight[2*i] + weight[2*i+1]);
+        for (uint32_t k = 0; k < laneCount; k++)
+          {
+            uint32_t ql = info.lanes[k]->GetCurrentSize ().GetValue ();
+            uint32_t bf = info.laneCapacity[k];
+            double bound = bf * packetTime / info.laneShare[k];
+            double edq = EstimateLaneDelay (info, k, packetTime);  // in Milliseconds
+            double &w = weight[i*nLanes + k];
+            w = std::max(delayFlag - edq, 0.0 ) * 0.1;
+            if (ql + 5 > bf)
+            {
+              w = std::max (bound - edq, 0.0);
+            }
+            tempSum += w;
+            NS_LOG_LOGIC ("GoodRoute " << i << " lane " << k << " dn = " << delayFlag
+                          << " ql = " << ql << " edq = " << edq << " bound = " << bound
+                          << " weight = " << w);
+            if (record && i < DsrForwardingDecision::MAX_CANDIDATES && k < DsrForwardingDecision::MAX_LANES)
+              {
+                m_decision.candidates[i].weight[k] = w;
+              }
+          }
 
         // weight[i] = max((dn - E[dq]), 0) 
         // dn = per-hop budget,  E[dq] = estimated next-hop delay
         //  per-hop_budget = current_budget - next-hop cost, current_budget = delay_budget - (timestamp.now()-timestamp.begin())
-        //  estimated next-hop delay = Qh/(w*C),  Qh = next-hop queue length, w = fast/slow lane weight, C = link rate
+        //  estimated next-hop delay = Qh/(w*C),  Qh = next-hop queue length, w = lane share, C = link rate
         // 
         // total_weight = sum(weight)
         // weight[i] = weight[i]/total_weight
-
-        if (flagTag.GetFlagTag () == true)
-          {
-            std::cout << "=======================================" << std::endl;
-            std::cout << "GoodRoute "<< i << " dn = " << delayFlag << std::endl; // Check the change of queue length
-            std::cout << "GoodRoute "<< i << " fql = " << ql_fast << ", sql = " << ql_slow << std::endl; // Check the change of queue length
-            std::cout << "GoodRoute "<< i << " edq_fast = " << edq_fast << ", edq_slow = " << edq_slow << std::endl; // Check the change of estimated delay
-            std::cout << "GoodRoute "<< i << " bound_fast = " << bound_fast << ", bound_slow = " << bound_slow << std::endl; // Check the change of estimated delay
-            std::cout << "GoodRoute "<< i << " Fast lane weight: " << weight[2*i] << " Slow lane: " << weight[2*i+1] << std::endl; // Check the change of weight
-          }
       }
       
       if (tempSum == 0)
       {
         NS_LOG_ERROR ("All next-hops are congested!! Drop packet");
-        if (flagTag.GetFlagTag () == true)
-        {
-          std::cout << "DROP PACKETS: TIME OUT" << std::endl;
-        }
+        EndDecision (DsrForwardingDecision::DROP_ZERO_WEIGHT, DsrRoutingTable::NO_ROUTE, 0, record);
         return 0;
       }
 
@@ -580,190 +1155,150 @@ Ipv4DSRRouting::LookupDSRRoute (Ipv4Address dest, Ptr<Packet> p, Ptr<NetDevice>
       uint32_t randInt = m_rand->GetInteger (1, 100);
       uint32_t selectRouteIndex = 0;
       uint32_t selectLaneIndex = 0;
-      if (flagTag.GetFlagTag () == true)
+      if (metaTag.GetFlag () == true)
       {
         NS_LOG_LOGIC ("Select route by probability");
-        for (uint32_t i = 0; i < goodRoutes.size () * (internalNqueue - 1); i ++)
+        for (uint32_t i = 0; i < weight.size (); i ++)
         {
           weight[i] = (weight[i]/tempSum) * 100;
         }      
 
-        for (uint32_t i = 0; i < goodRoutes.size () * (internalNqueue - 1) -1; i ++)
+        for (uint32_t i = 0; i + 1 < weight.size (); i ++)
         {
           weight[i+1] += weight[i];
         }
      
         // ns3::RngSeedManager::SetSeed(2);
-        for (uint32_t i = 0; i < goodRoutes.size () * (internalNqueue - 1); i ++)
+        for (uint32_t i = 0; i < weight.size (); i ++)
         {
           if (weight[i] >= randInt)
             {
-              selectRouteIndex = i / 2;
-              selectLaneIndex = i % 2;
+              selectRouteIndex = i / nLanes;
+              selectLaneIndex = i % nLanes;
               break;
             }
         }
-        std::cout << "******************************************" << std::endl;
-        // std::cout << "Random number: " << randInt << std::endl;
-        std::cout << "selectRouteIndex = " << selectRouteIndex << std::endl;
-        std::cout << "selectLaneIndex = " << selectLaneIndex << std::endl;
+        NS_LOG_LOGIC ("selectRouteIndex = " << selectRouteIndex << " selectLaneIndex = " << selectLaneIndex);
       }
       else
-      // if (flagTag.GetFlagTag () == false)
+      // if (metaTag.GetFlag () == false)
       {
         NS_LOG_LOGIC ("Select optimal route with highest probability");
         uint32_t flag = 0;
-        for (uint32_t i = 0; i < goodRoutes.size () * (internalNqueue - 1); i ++)
+        for (uint32_t i = 0; i < weight.size (); i ++)
         {
           if (weight[i] > weight[flag])
           {
             flag = i;
           }
         }      
-        selectRouteIndex = flag / 2;
-        selectLaneIndex = flag % 2;
+        selectRouteIndex = flag / nLanes;
+        selectLaneIndex = flag % nLanes;
       }
 
       
-      Ipv4DSRRoutingTableEntry* route;
-      route = goodRoutes.at (selectRouteIndex);
-      PriorityTag priorityTag;
-      p->RemovePacketTag (priorityTag);
-      priorityTag.SetPriority (selectLaneIndex);
-      p->AddPacketTag (priorityTag);
+      uint32_t route = goodRoutes.at (selectRouteIndex);
+      lane = selectLaneIndex;
+      if (useFlowCache)
+        {
+          CacheFlowDecision (dest, budget, route, lane,
+                             GetInterfaceInfo (m_table->GetInterface (route)).laneCapacity[lane]);
+        }
+      EndDecision (DsrForwardingDecision::NOT_DROPPED, route, lane, record);
       
-      // create a Ipv4Route object from the selected routing table entry
-      rtentry = Create<Ipv4Route> ();
-      rtentry->SetDestination (route->GetDest ());
-      /// \todo handle multi-address case
-      rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
-      rtentry->SetGateway (route->GetGateway ());
-      uint32_t interfaceIdx = route->GetInterface ();
-      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
+      // get the Ipv4Route object of the selected routing table entry
+      rtentry = GetIpv4Route (route);
 
       return rtentry;
     }
   else 
     {
+      EndDecision (DsrForwardingDecision::DROP_NO_ROUTE, DsrRoutingTable::NO_ROUTE, 0, record);
       return 0;
     }
 }
 
-uint32_t 
-Ipv4DSRRouting::GetNRoutes (void) const
+void
+Ipv4DSRRouting::BeginDecision (Ipv4Address dest, Ptr<const Packet> p, const DsrMetaTag &metaTag)
 {
-  NS_LOG_FUNCTION (this);
-  uint32_t n = 0;
-  n += m_hostRoutes.size ();
-  n += m_networkRoutes.size ();
-  n += m_ASexternalRoutes.size ();
-  return n;
+  DsrForwardingDecision &decision = m_decision;
+  decision.time = 0;
+  decision.node = m_ipv4->GetObject<Node> ()->GetId ();
+  decision.destination = dest.Get ();
+  decision.packetSize = p->GetSize ();
+  decision.budget = 0;
+  decision.flag = metaTag.GetFlag () ? 1 : 0;
+  decision.dropReason = DsrForwardingDecision::NOT_DROPPED;
+  decision.fromFlowCache = 0;
+  decision.lane = 0;
+  decision.gateway = 0;
+  decision.interface = 0;
+  decision.nRoutes = 0;
+  decision.nFineRoutes = 0;
+  decision.nCandidates = 0;
 }
 
-Ipv4DSRRoutingTableEntry *
-Ipv4DSRRouting::GetRoute (uint32_t index) const
+void
+Ipv4DSRRouting::EndDecision (uint8_t dropReason, uint32_t route, uint32_t lane,
+                             bool record)
 {
-  NS_LOG_FUNCTION (this << index);
-  if (index < m_hostRoutes.size ())
+  m_drops[dropReason]++;
+  if (route != DsrRoutingTable::NO_ROUTE)
     {
-      uint32_t tmp = 0;
-      for (HostRoutesCI i = m_hostRoutes.begin (); 
-           i != m_hostRoutes.end (); 
-           i++) 
-        {
-          if (tmp  == index)
-            {
-              return *i;
-            }
-          tmp++;
-        }
+      m_laneHistogram[std::min<size_t> (lane, m_laneHistogram.size () - 1)]++;
     }
-  index -= m_hostRoutes.size ();
-  uint32_t tmp = 0;
-  if (index < m_networkRoutes.size ())
+  if (m_latencySampled)
     {
-      for (NetworkRoutesCI j = m_networkRoutes.begin (); 
-           j != m_networkRoutes.end ();
-           j++)
+      int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+          (std::chrono::steady_clock::now () - m_lookupStart).count ();
+      uint32_t bin = 0;
+      while (ns > 1 && bin + 1 < m_latencyHistogram.size ())
         {
-          if (tmp == index)
-            {
-              return *j;
-            }
-          tmp++;
+          ns >>= 1;
+          bin++;
         }
+      m_latencyHistogram[bin]++;
     }
-  index -= m_networkRoutes.size ();
-  tmp = 0;
-  for (ASExternalRoutesCI k = m_ASexternalRoutes.begin (); 
-       k != m_ASexternalRoutes.end (); 
-       k++) 
+  if (!record)
     {
-      if (tmp == index)
-        {
-          return *k;
-        }
-      tmp++;
+      return;
     }
-  NS_ASSERT (false);
-  // quiet compiler.
-  return 0;
+
+  DsrForwardingDecision &decision = m_decision;
+  decision.time = Simulator::Now ().GetNanoSeconds ();
+  decision.dropReason = dropReason;
+  if (route != DsrRoutingTable::NO_ROUTE)
+    {
+      decision.lane = lane;
+      decision.gateway = m_table->GetGateway (route).Get ();
+      decision.interface = m_table->GetInterface (route);
+    }
+  m_forwardingDecisionTrace (decision);
+}
+
+uint32_t 
+Ipv4DSRRouting::GetNRoutes (void) const
+{
+  NS_LOG_FUNCTION (this);
+  SealTable ();
+  return m_table->GetNRoutes ();
 }
+
+Ipv4DSRRoutingTableEntry
+Ipv4DSRRouting::GetRoute (uint32_t index) const
+{
+  NS_LOG_FUNCTION (this << index);
+  SealTable ();
+  return m_table->GetRoute (index);
+}
+
 void 
 Ipv4DSRRouting::RemoveRoute (uint32_t index)
 {
   NS_LOG_FUNCTION (this << index);
-  if (index < m_hostRoutes.size ())
-    {
-      uint32_t tmp = 0;
-      for (HostRoutesI i = m_hostRoutes.begin (); 
-           i != m_hostRoutes.end (); 
-           i++) 
-        {
-          if (tmp  == index)
-            {
-              NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_hostRoutes.size ());
-              delete *i;
-              m_hostRoutes.erase (i);
-              NS_LOG_LOGIC ("Done removing host route " << index << "; host route remaining size = " << m_hostRoutes.size ());
-              return;
-            }
-          tmp++;
-        }
-    }
-  index -= m_hostRoutes.size ();
-  uint32_t tmp = 0;
-  for (NetworkRoutesI j = m_networkRoutes.begin (); 
-       j != m_networkRoutes.end (); 
-       j++) 
-    {
-      if (tmp == index)
-        {
-          NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_networkRoutes.size ());
-          delete *j;
-          m_networkRoutes.erase (j);
-          NS_LOG_LOGIC ("Done removing network route " << index << "; network route remaining size = " << m_networkRoutes.size ());
-          return;
-        }
-      tmp++;
-    }
-  index -= m_networkRoutes.size ();
-  tmp = 0;
-  for (ASExternalRoutesI k = m_ASexternalRoutes.begin (); 
-       k != m_ASexternalRoutes.end ();
-       k++)
-    {
-      if (tmp == index)
-        {
-          NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_ASexternalRoutes.size ());
-          delete *k;
-          m_ASexternalRoutes.erase (k);
-          NS_LOG_LOGIC ("Done removing network route " << index << "; network route remaining size = " << m_networkRoutes.size ());
-          return;
-        }
-      tmp++;
-    }
-  NS_ASSERT (false);
+  SealTable ();
+  m_table->RemoveRoute (index);
+  TableChanged ();
 }
 
 int64_t
@@ -778,24 +1313,11 @@ void
 Ipv4DSRRouting::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
-  for (HostRoutesI i = m_hostRoutes.begin (); 
-       i != m_hostRoutes.end (); 
-       i = m_hostRoutes.erase (i)) 
-    {
-      delete (*i);
-    }
-  for (NetworkRoutesI j = m_networkRoutes.begin (); 
-       j != m_networkRoutes.end (); 
-       j = m_networkRoutes.erase (j)) 
-    {
-      delete (*j);
-    }
-  for (ASExternalRoutesI l = m_ASexternalRoutes.begin (); 
-       l != m_ASexternalRoutes.end ();
-       l = m_ASexternalRoutes.erase (l))
-    {
-      delete (*l);
-    }
+  m_table->Clear ();
+  m_nextTable->Clear ();
+  m_interfaceCache.clear ();
+  m_ipv4RouteCache.clear ();
+  m_flowCache.clear ();
 
   Ipv4RoutingProtocol::DoDispose ();
 }
@@ -887,10 +1409,14 @@ Ipv4DSRRouting::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDev
   Ptr<Ipv4Route> rtentry;
   if (p != nullptr && p->GetSize () != 0)
     { 
-      TimestampTag txTimeTag;
-      bool getTx = p->PeekPacketTag (txTimeTag);
-      std::cout << getTx << "txtime : " << txTimeTag.GetTimestamp ().GetNanoSeconds () << std::endl;
-      rtentry = LookupDSRRoute (header.GetDestination (), p, oif);
+      DsrMetaTag metaTag;
+      metaTag.PeekFrom (p);
+      uint32_t lane = metaTag.GetLane ();
+      rtentry = LookupDSRRoute (header.GetDestination (), p, metaTag, lane, oif);
+      if (rtentry != 0 && lane != metaTag.GetLane ())
+        {
+          metaTag.UpdateLane (p, lane);
+        }
     }
   else
   {
@@ -914,11 +1440,6 @@ Ipv4DSRRouting::RouteInput  (Ptr<const Packet> p, const Ipv4Header &header, Ptr<
                                 UnicastForwardCallback ucb, MulticastForwardCallback mcb,
                                 LocalDeliverCallback lcb, ErrorCallback ecb)
 { 
-  /**
-   * \author Pu Yang
-   * \brief make a copy of p, and process p_copy
-  */
-  Ptr <Packet> p_copy = p->Copy();
   NS_LOG_FUNCTION (this << p << header << header.GetSource () << header.GetDestination () << idev << &lcb << &ecb);
   // Check if input device supports IP
   NS_ASSERT (m_ipv4->GetInterfaceForDevice (idev) >= 0);
@@ -955,11 +1476,13 @@ Ipv4DSRRouting::RouteInput  (Ptr<const Packet> p, const Ipv4Header &header, Ptr<
   // Next, try to find a route
   NS_LOG_LOGIC ("Unicast destination- looking up global route");
   Ptr<Ipv4Route> rtentry; 
-  BudgetTag budgetTag;
+  DsrMetaTag metaTag;
+  bool dsrPacket = metaTag.PeekFrom (p);
+  uint32_t lane = metaTag.GetLane ();
   
-  if (p->PeekPacketTag (budgetTag))
+  if (dsrPacket)
   {
-    rtentry = LookupDSRRoute (header.GetDestination (), p_copy); 
+    rtentry = LookupDSRRoute (header.GetDestination (), p, metaTag, lane); 
   }
   else
   {
@@ -967,9 +1490,18 @@ Ipv4DSRRouting::RouteInput  (Ptr<const Packet> p, const Ipv4Header &header, Ptr<
   }
   if (rtentry != 0)
     {
-      const Ptr <Packet> p_c = p_copy->Copy();
       NS_LOG_LOGIC ("Found unicast destination- calling unicast callback");
-      ucb (rtentry, p_c, header);
+      if (dsrPacket && lane != metaTag.GetLane ())
+        {
+          // only a packet whose lane changes needs a writable copy
+          Ptr<Packet> p_copy = p->Copy ();
+          metaTag.UpdateLane (p_copy, lane);
+          ucb (rtentry, p_copy, header);
+        }
+      else
+        {
+          ucb (rtentry, p, header);
+        }
       return true; 
     }
   else
@@ -984,50 +1516,51 @@ void
 Ipv4DSRRouting::NotifyInterfaceUp (uint32_t i)
 {
   NS_LOG_FUNCTION (this << i);
-  if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
-    {
-      DSRRouteManager::DeleteDSRRoutes ();
-      DSRRouteManager::BuildDSRRoutingDatabase ();
-      DSRRouteManager::InitializeRoutes ();
-    }
+  InvalidateInterfaceCache ();
+  TriggerRouteUpdate (i);
 }
 
 void 
 Ipv4DSRRouting::NotifyInterfaceDown (uint32_t i)
 {
   NS_LOG_FUNCTION (this << i);
-  if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
-    {
-      DSRRouteManager::DeleteDSRRoutes ();
-      DSRRouteManager::BuildDSRRoutingDatabase ();
-      DSRRouteManager::InitializeRoutes ();
-    }
+  InvalidateInterfaceCache ();
+  TriggerRouteUpdate (i);
 }
 
 void 
 Ipv4DSRRouting::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << interface << address);
-  if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
-    {
-      DSRRouteManager::DeleteDSRRoutes ();
-      DSRRouteManager::BuildDSRRoutingDatabase ();
-      DSRRouteManager::InitializeRoutes ();
-    }
+  InvalidateInterfaceCache ();
+  TriggerRouteUpdate (interface);
 }
 
 void 
 Ipv4DSRRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << interface << address);
+  InvalidateInterfaceCache ();
+  TriggerRouteUpdate (interface);
+}
+
+void
+Ipv4DSRRouting::TriggerRouteUpdate (uint32_t interface)
+{
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      DSRRouteManager::DeleteDSRRoutes ();
-      DSRRouteManager::BuildDSRRoutingDatabase ();
-      DSRRouteManager::InitializeRoutes ();
+      m_routeUpdateTriggerTrace (interface);
+      DSRRouteManager::ScheduleUpdate (m_ipv4->GetObject<Node> (), m_spfDelay, m_spfHoldTime);
     }
 }
 
+void
+Ipv4DSRRouting::NotifyRouteUpdate (uint32_t triggers, uint32_t nodes)
+{
+  NS_LOG_FUNCTION (this << triggers << nodes);
+  m_routeUpdateTrace (triggers, nodes);
+}
+
 void 
 Ipv4DSRRouting::SetIpv4 (Ptr<Ipv4> ipv4)
 {
@@ -24,6 +24,9 @@
 #define IPV4_DSR_ROUTING_H
 
 #include <list>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
 #include <stdint.h>
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv4-header.h"
@@ -31,8 +34,12 @@
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/random-variable-stream.h"
+#include "ns3/queue-disc.h"
+#include "ns3/traced-callback.h"
 #include "dsr-route-manager-impl.h"
 #include "ipv4-dsr-routing-table-entry.h"
+#include "dsr-prefix-trie.h"
+#include "dsr-routing-table.h"
 
 namespace ns3 {
 
@@ -43,7 +50,62 @@ class Ipv4Address;
 class Ipv4Header;
 class Ipv4DSRRoutingTableEntry;
 class Ipv4MulticastRoutingTableEntry;
+class DsrMetaTag;
+class DsrVirtualQueueDisc;
 class Node;
+class OutputStreamWrapper;
+
+/**
+ * \brief One budget-aware forwarding decision, as reported by the
+ * "ForwardingDecision" trace source of Ipv4DSRRouting.
+ *
+ * Plain data of fixed size, so a trace sink may copy it.  Only the first
+ * MAX_CANDIDATES good routes, and their first MAX_LANES budget-aware
+ * lanes, are described; the candidates past nCandidates are left over from
+ * earlier decisions.  DsrDecisionTraceHelper writes it out field by field.
+ */
+struct DsrForwardingDecision
+{
+  /// why the packet was dropped
+  enum DropReason
+  {
+    NOT_DROPPED = 0,     //!< a route and a lane were selected
+    DROP_NO_ROUTE,       //!< no route towards the destination
+    DROP_TIMEOUT,        //!< the delay budget was already exhausted
+    DROP_NO_FINE_ROUTE,  //!< every route costs more than the remaining budget
+    DROP_CONGESTED,      //!< every budget-aware lane of a next hop is full
+    DROP_ZERO_WEIGHT,    //!< no next hop can meet the budget
+    DROP_REASONS         //!< number of values, including NOT_DROPPED
+  };
+  static const uint32_t MAX_CANDIDATES = 8; //!< candidates described by a record
+  static const uint32_t MAX_LANES = 4;      //!< budget-aware lanes described per candidate
+
+  /// a good route considered by the decision
+  struct Candidate
+  {
+    uint32_t gateway;                 //!< next hop address
+    uint32_t interface;               //!< output interface
+    uint32_t distance;                //!< route cost, in microseconds
+    uint32_t queueLength[MAX_LANES];  //!< lane lengths, in packets
+    double weight[MAX_LANES];         //!< lane weights, before normalization
+  };
+
+  int64_t time;               //!< simulation time, in nanoseconds
+  uint32_t node;              //!< node identifier
+  uint32_t destination;       //!< destination address
+  uint32_t packetSize;        //!< packet size, in bytes
+  uint32_t budget;            //!< remaining budget, in microseconds
+  uint8_t flag;               //!< the packet belongs to the inspected flow
+  uint8_t dropReason;         //!< a DropReason
+  uint8_t fromFlowCache;      //!< the decision was reused from the flow cache
+  uint8_t lane;               //!< selected lane
+  uint32_t gateway;           //!< selected next hop address
+  uint32_t interface;         //!< selected output interface
+  uint32_t nRoutes;           //!< routes of the longest match
+  uint32_t nFineRoutes;       //!< routes within the budget
+  uint32_t nCandidates;       //!< good routes, possibly more than MAX_CANDIDATES
+  Candidate candidates[MAX_CANDIDATES]; //!< the first good routes
+};
 
 /**
  * \ingroup ipv4
@@ -91,6 +153,14 @@ public:
   Ipv4DSRRouting ();
   virtual ~Ipv4DSRRouting ();
 
+  /// how the delay of a packet through a lane of a next hop is estimated
+  enum DelayEstimator
+  {
+    MODEL,          //!< queued packets of the size of this one, served at the lane share
+    MEASURED,       //!< moving average of the sojourn time measured by the queue disc
+    MEASURED_MAX    //!< windowed max of the sojourn time measured by the queue disc
+  };
+
   // These methods inherited from base class
   virtual Ptr<Ipv4Route> RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr);
 
@@ -211,13 +281,13 @@ public:
    *
    * \param i The index (into the routing table) of the route to retrieve.  If
    * the default route has been set, it will occupy index zero.
-   * \return If route is set, a pointer to that Ipv4RoutingTableEntry is returned, otherwise
-   * a zero pointer is returned.
+   * \return a copy of the route; the routes are stored in arrays, not as
+   * Ipv4DSRRoutingTableEntry objects
    *
    * \see Ipv4RoutingTableEntry
    * \see Ipv4GlobalRouting::RemoveRoute
    */
-  Ipv4DSRRoutingTableEntry *GetRoute (uint32_t i) const;
+  Ipv4DSRRoutingTableEntry GetRoute (uint32_t i) const;
 
   /**
    * \brief Remove a route from the global unicast routing table.
@@ -237,6 +307,68 @@ public:
    */
   void RemoveRoute (uint32_t i);
 
+  /**
+   * \brief Start rebuilding the routing table in place.
+   *
+   * Until EndRouteUpdate, the Add*RouteTo methods fill a new table off to
+   * the side and the lookups keep using the current routes.
+   */
+  void BeginRouteUpdate (void);
+
+  /**
+   * \brief Replace the routing table with the routes added since
+   * BeginRouteUpdate, if they differ.
+   *
+   * When no route changed, the current table, and the Ipv4Route objects
+   * cached for it, are kept.  Otherwise the cached Ipv4Route objects of the
+   * routes in the common head of the two tables survive, and so do the flow
+   * cache decisions on them when no destination came or went.
+   *
+   * \return the number of routes removed or added
+   */
+  uint32_t EndRouteUpdate (void);
+
+  /**
+   * \brief Start building a new routing table off to the side.
+   *
+   * Until CommitRouteTable, the Add*RouteTo methods fill an empty table
+   * that the lookups do not see; they keep using the current routes.
+   */
+  void BeginRouteTable (void);
+
+  /**
+   * \brief Replace the routing table with the one built since
+   * BeginRouteTable.
+   *
+   * The two tables are swapped, which costs the same whatever their size,
+   * and the old routes are then released in one go.
+   *
+   * \return the number of routes of the new table
+   */
+  uint32_t CommitRouteTable (void);
+
+  /**
+   * \brief Remove every route of the routing table in one go.
+   */
+  void ClearRoutes (void);
+
+  /**
+   * \brief Map an address to the router owning it.
+   *
+   * The map is shared by every Ipv4DSRRouting.  A destination without host
+   * routes of its own is looked up again as the router ID it maps to, so
+   * one host route per destination router stands for all its addresses.
+   *
+   * \param address an interface address
+   * \param routerId the router ID of the node owning the address
+   */
+  static void AddRouterAddress (Ipv4Address address, Ipv4Address routerId);
+
+  /**
+   * \brief Forget every address added by AddRouterAddress.
+   */
+  static void ClearRouterAddresses (void);
+
 
   /**
    * @brief Build the routing database by gathering Link State Advertisements
@@ -254,6 +386,99 @@ public:
    */
   int64_t AssignStreams (int64_t stream);
 
+  /**
+   * \brief Refresh the cached link rate and queues of an interface.
+   *
+   * The forwarding path caches the "DataRate" attribute of every device.
+   * Point-to-point devices do not trace changes of this attribute, so call
+   * this method after changing it (or the root queue disc) at run time.
+   *
+   * \param interface the interface index
+   */
+  void NotifyDataRateChange (uint32_t interface);
+
+  /**
+   * \return the number of budget-aware lookups answered by the flow cache
+   */
+  uint64_t GetFlowCacheHits (void) const;
+  /**
+   * \return the number of budget-aware lookups the flow cache could not answer
+   */
+  uint64_t GetFlowCacheMisses (void) const;
+
+  /**
+   * \param reason a DsrForwardingDecision::DropReason
+   * \return the number of budget-aware lookups that ended with this reason;
+   * NOT_DROPPED counts the forwarded packets
+   */
+  uint64_t GetDrops (uint8_t reason) const;
+  /// \return the number of packets dropped for lack of a route
+  uint64_t GetDropsNoRoute (void) const;
+  /// \return the number of packets dropped with an exhausted budget
+  uint64_t GetDropsTimeout (void) const;
+  /// \return the number of packets dropped because every route costs more than the budget
+  uint64_t GetDropsNoFineRoute (void) const;
+  /// \return the number of packets dropped because both lanes of a next hop were full
+  uint64_t GetDropsCongested (void) const;
+  /// \return the number of packets dropped because every weight was zero
+  uint64_t GetDropsZeroWeight (void) const;
+  /**
+   * \return the number of budget-aware lookups by number of routes of the
+   * longest match; the last bin counts 16 routes or more
+   */
+  const std::vector<uint64_t> &GetCandidateHistogram (void) const;
+  /// \return the number of forwarded packets by selected lane
+  const std::vector<uint64_t> &GetLaneHistogram (void) const;
+  /**
+   * \return the sampled lookups by wall-clock duration; bin i counts the
+   * durations below 2^(i+1) nanoseconds not counted by a lower bin
+   */
+  const std::vector<uint64_t> &GetLatencyHistogram (void) const;
+  /**
+   * \brief Zero every forwarding counter and histogram, the flow cache
+   * counters included.
+   */
+  void ResetForwardingStats (void);
+  /**
+   * \brief Print the forwarding counters and histograms.
+   * \param stream the output stream
+   */
+  void PrintForwardingStats (Ptr<OutputStreamWrapper> stream) const;
+
+  /**
+   * TracedCallback signature for forwarding decisions.
+   *
+   * \param [in] decision the decision record
+   */
+  typedef void (* ForwardingDecisionTracedCallback)(const DsrForwardingDecision &decision);
+
+  /**
+   * TracedCallback signature for the interface events triggering a route
+   * update.
+   *
+   * \param [in] interface the interface of the event
+   */
+  typedef void (* RouteUpdateTriggerTracedCallback)(uint32_t interface);
+
+  /**
+   * TracedCallback signature for the route updates.
+   *
+   * \param [in] triggers the number of events the update serves
+   * \param [in] nodes the number of nodes those events happened on
+   */
+  typedef void (* RouteUpdateTracedCallback)(uint32_t triggers, uint32_t nodes);
+
+  /**
+   * \brief Fire the "RouteUpdate" trace source.
+   *
+   * Called by the route manager when it runs the update scheduled by an
+   * event of this router.
+   *
+   * \param triggers the number of events the update serves
+   * \param nodes the number of nodes those events happened on
+   */
+  void NotifyRouteUpdate (uint32_t triggers, uint32_t nodes);
+
   // static bool CompareRouteCost(Ipv4DSRRoutingTableEntry* route1, Ipv4DSRRoutingTableEntry* route2);
 
 protected:
@@ -264,29 +489,190 @@ private:
   bool m_randomEcmpRouting;
   /// Set to true if this interface should respond to interface events by globallly recomputing routes 
   bool m_respondToInterfaceEvents;
+  Time m_spfDelay;                    //!< wait between an interface event and the route update
+  Time m_spfHoldTime;                 //!< minimum time between two route updates
   /// A uniform random number generator for randomly routing packets among ECMP 
   Ptr<UniformRandomVariable> m_rand;
 
-  /// container of Ipv4RoutingTableEntry (routes to hosts)
-  typedef std::list<Ipv4DSRRoutingTableEntry *> HostRoutes;
-  /// const iterator of container of Ipv4RoutingTableEntry (routes to hosts)
-  typedef std::list<Ipv4DSRRoutingTableEntry *>::const_iterator HostRoutesCI;
-  /// iterator of container of Ipv4RoutingTableEntry (routes to hosts)
-  typedef std::list<Ipv4DSRRoutingTableEntry *>::iterator HostRoutesI;
+  bool m_flowCacheEnabled;            //!< reuse decisions of non-flagged traffic
+  Time m_flowCacheTimeout;            //!< lifetime of a cached decision
+  uint32_t m_flowCacheMaxPackets;     //!< packets a cached decision may serve
+  uint32_t m_flowCacheBudgetBucket;   //!< width of a budget bucket, in microseconds
+  double m_flowCacheOccupancy;        //!< lane occupancy, as a fraction of the lane buffer, invalidating a decision
+  uint64_t m_flowCacheHits;           //!< lookups answered by the flow cache
+  uint64_t m_flowCacheMisses;         //!< lookups not answered by the flow cache
+  DelayEstimator m_delayEstimator;    //!< how the delay through a lane is estimated
 
-  /// container of Ipv4RoutingTableEntry (routes to networks)
-  typedef std::list<Ipv4DSRRoutingTableEntry *> NetworkRoutes;
-  /// const iterator of container of Ipv4RoutingTableEntry (routes to networks)
-  typedef std::list<Ipv4DSRRoutingTableEntry *>::const_iterator NetworkRoutesCI;
-  /// iterator of container of Ipv4RoutingTableEntry (routes to networks)
-  typedef std::list<Ipv4DSRRoutingTableEntry *>::iterator NetworkRoutesI;
+  uint32_t m_latencySampleInterval;   //!< lookups per latency sample, 0 to disable
+  bool m_latencySampled;              //!< the running lookup is timed
+  std::chrono::steady_clock::time_point m_lookupStart; //!< start of the timed lookup
+  uint64_t m_lookups;                 //!< budget-aware lookups
+  uint64_t m_drops[DsrForwardingDecision::DROP_REASONS]; //!< lookup outcomes by drop reason
+  std::vector<uint64_t> m_candidateHistogram; //!< lookups by number of candidate routes
+  std::vector<uint64_t> m_laneHistogram;      //!< forwarded packets by lane
+  std::vector<uint64_t> m_latencyHistogram;   //!< sampled lookups by log2 of the duration in ns
 
-  /// container of Ipv4RoutingTableEntry (routes to external AS)
-  typedef std::list<Ipv4DSRRoutingTableEntry *> ASExternalRoutes;
-  /// const iterator of container of Ipv4RoutingTableEntry (routes to external AS)
-  typedef std::list<Ipv4DSRRoutingTableEntry *>::const_iterator ASExternalRoutesCI;
-  /// iterator of container of Ipv4RoutingTableEntry (routes to external AS)
-  typedef std::list<Ipv4DSRRoutingTableEntry *>::iterator ASExternalRoutesI;
+  /**
+   * \brief Install a host route, or add it to the table being built.
+   * \param route the route
+   */
+  void InsertHostRoute (const Ipv4DSRRoutingTableEntry &route);
+  /**
+   * \brief Install a network route, or add it to the table being built.
+   * \param route the route
+   */
+  void InsertNetworkRoute (const Ipv4DSRRoutingTableEntry &route);
+  /**
+   * \brief Install an external route, or add it to the table being built.
+   * \param route the route
+   */
+  void InsertASExternalRoute (const Ipv4DSRRoutingTableEntry &route);
+  /**
+   * \brief Drop what is cached about the routes after the table changed.
+   * \param head the number of leading routes left unchanged
+   * \param sameDestinations true if no destination was added or removed
+   */
+  void TableChanged (uint32_t head = 0, bool sameDestinations = false);
+  /**
+   * \brief Seal the routes added outside a route build, on first use.
+   *
+   * The Add*RouteTo methods only log their route, so that installing many
+   * static routes rebuilds the table once; every reader of the table calls
+   * this first.
+   */
+  void SealTable (void) const;
+  /// container of candidate routes for one forwarding decision
+  typedef DsrRoutingTable::RouteIds RouteVec_t;
+  /// Ipv4Route objects handed out, by route identifier
+  typedef std::vector<Ptr<Ipv4Route> > Ipv4RouteCache;
+
+  /// a forwarding decision reused by the packets of one flow cache key
+  struct FlowCacheEntry
+  {
+    uint32_t route;                  //!< the selected route
+    uint32_t lane;                   //!< the selected lane
+    Time expires;                    //!< end of validity
+    uint32_t packetsLeft;            //!< packets that may still reuse the decision
+    uint32_t occupancyLimit;         //!< lane occupancy, in packets, invalidating the decision
+  };
+  /// cached decisions keyed by (destination, budget bucket)
+  typedef std::unordered_map<uint64_t, FlowCacheEntry> FlowCache;
+
+  /**
+   * \brief Look for a reusable decision in the flow cache.
+   * \param dest destination address
+   * \param budget remaining budget of the packet, in microseconds
+   * \param lane set to the cached lane on a hit
+   * \return the cached route, or DsrRoutingTable::NO_ROUTE on a miss
+   */
+  uint32_t LookupFlowCache (Ipv4Address dest, uint32_t budget, uint32_t &lane);
+  /**
+   * \brief Remember a decision in the flow cache.
+   * \param dest destination address
+   * \param budget remaining budget of the packet, in microseconds
+   * \param route the selected route
+   * \param lane the selected lane
+   * \param laneBuffer buffer size of the selected lane, in packets
+   */
+  void CacheFlowDecision (Ipv4Address dest, uint32_t budget, uint32_t route,
+                          uint32_t lane, uint32_t laneBuffer);
+  /**
+   * \brief Drop every cached decision.
+   */
+  void FlushFlowCache (void);
+
+  /**
+   * \brief Get the Ipv4Route describing a table entry.
+   *
+   * The object is created on first use and shared by later decisions
+   * using the same entry, like the nix-vector route cache does.
+   *
+   * \param route the routing table entry
+   * \return the Ipv4Route
+   */
+  Ptr<Ipv4Route> GetIpv4Route (uint32_t route);
+
+  /**
+   * \brief Find the shortest host route towards a destination.
+   *
+   * The answer is maintained as host routes are added and removed, so this
+   * costs one hash lookup and one array load, plus the router resolution
+   * of LookupHostRoutes when the destination has no host route.
+   *
+   * \param dest destination address
+   * \return the first host route of minimum distance, or
+   * DsrRoutingTable::NO_ROUTE if there is none
+   */
+  uint32_t FindBestHostRoute (Ipv4Address dest) const;
+  /**
+   * \brief Append the host routes towards a destination to a vector.
+   *
+   * When the destination has none, the host routes towards the router it
+   * maps to, if any, are appended instead; see AddRouterAddress.
+   *
+   * \param dest destination address
+   * \param oif output interface if any (put 0 otherwise)
+   * \param routes the vector receiving the route identifiers
+   * \return the number of routes appended
+   */
+  uint32_t LookupHostRoutes (Ipv4Address dest, Ptr<NetDevice> oif, RouteVec_t &routes) const;
+  /**
+   * \brief Find the router owning an address.
+   * \param dest an address
+   * \param routerId set to the router ID of the owner
+   * \return true if the address was mapped to a router ID other than itself
+   */
+  static bool GetRouterOf (Ipv4Address dest, Ipv4Address &routerId);
+  /**
+   * \brief Map an output device to the interface filter of the prefix tries.
+   * \param oif output interface if any (put 0 otherwise)
+   * \return -1 when oif is 0, otherwise its interface index
+   */
+  int32_t OutputInterface (Ptr<NetDevice> oif) const;
+
+  /**
+   * \brief What the forwarding path needs to know about an output interface.
+   *
+   * Built on first use and dropped on every interface notification, so the
+   * per-packet path reads queue lengths and link rates without object
+   * aggregation or string-keyed attribute lookups.
+   */
+  struct InterfaceInfo
+  {
+    InterfaceInfo ();
+    bool valid;                 //!< the descriptor has been built
+    Ptr<NetDevice> device;      //!< the output device
+    uint64_t bitRate;           //!< link rate in bit/s, 0 if unknown
+    std::vector<Ptr<QueueDisc::InternalQueue> > lanes; //!< internal queues of the root queue disc
+    std::vector<uint32_t> laneCapacity; //!< packets each lane accepts
+    std::vector<double> laneShare;      //!< link share of each lane
+    Ptr<DsrVirtualQueueDisc> dsrQdisc;  //!< the root queue disc if it measures its lanes, 0 otherwise
+  };
+
+  /**
+   * \brief Get the descriptor of an interface, building it if needed.
+   * \param interface the interface index
+   * \return the descriptor
+   */
+  const InterfaceInfo &GetInterfaceInfo (uint32_t interface);
+  /**
+   * \brief Drop every interface descriptor.
+   */
+  void InvalidateInterfaceCache (void);
+  /**
+   * \brief Estimate the delay of a packet through a lane of a next hop.
+   *
+   * The MEASURED estimators take the sojourn time measured by the queue
+   * disc while the lane is backlogged, but never less than the delay of the
+   * bytes actually queued; they fall back to MODEL when the queue disc is
+   * not a DsrVirtualQueueDisc.
+   *
+   * \param info the interface of the next hop
+   * \param lane the lane
+   * \param packetTime transmission time of the packet at the link rate, in milliseconds
+   * \return the delay, in milliseconds
+   */
+  double EstimateLaneDelay (const InterfaceInfo &info, uint32_t lane, double packetTime) const;
 
   /**
    * \brief Lookup in the forwarding table for destination.
@@ -295,13 +681,72 @@ private:
    * \return Ipv4Route to route the packet to reach dest address
    */
   Ptr<Ipv4Route> LookupDSRRoute (Ipv4Address dest, Ptr<NetDevice> oif = 0);
-  Ptr<Ipv4Route> LookupDSRRoute (Ipv4Address dest, Ptr<Packet> p, Ptr<NetDevice> oif = 0);
+  /**
+   * \brief Budget-aware lookup in the forwarding table for destination.
+   *
+   * The packet is not modified; the caller stores the selected lane.
+   *
+   * \param dest destination address
+   * \param p the packet to forward
+   * \param metaTag the DSR metadata of the packet
+   * \param lane set to the lane selected for the packet
+   * \param oif output interface if any (put 0 otherwise)
+   * \return Ipv4Route to route the packet to reach dest address
+   */
+  Ptr<Ipv4Route> LookupDSRRoute (Ipv4Address dest, Ptr<const Packet> p, const DsrMetaTag &metaTag,
+                                 uint32_t &lane, Ptr<NetDevice> oif = 0);
 
-  HostRoutes m_hostRoutes;             //!< Routes to hosts
-  NetworkRoutes m_networkRoutes;       //!< Routes to networks
-  ASExternalRoutes m_ASexternalRoutes; //!< External routes imported
+  DsrRoutingTable *m_table;            //!< Routes used by the lookups
+  DsrRoutingTable *m_nextTable;        //!< Routes being built, see BeginRouteTable and BeginRouteUpdate
+  bool m_buildingTable;                //!< m_nextTable is being built
+  bool m_routeUpdate;                  //!< m_nextTable holds a route update, see BeginRouteUpdate
 
   Ptr<Ipv4> m_ipv4; //!< associated IPv4 instance
+  std::vector<InterfaceInfo> m_interfaceCache; //!< descriptors indexed by interface
+  Ipv4RouteCache m_ipv4RouteCache;     //!< Ipv4Route objects by route identifier
+  FlowCache m_flowCache;               //!< Decisions reused by non-flagged traffic
+
+  // Scratch space of LookupDSRRoute, kept across calls so that the
+  // forwarding decision does not allocate once the capacity is reached.
+  RouteVec_t m_allRoutes;              //!< candidates of the longest match
+  RouteVec_t m_fineRoutes;             //!< candidates within the budget
+  RouteVec_t m_goodRoutes;             //!< candidates close to the average cost
+  std::vector<double> m_weights;       //!< per route and lane weights
+
+  /**
+   * \brief Start the decision record of a budget-aware lookup.
+   * \param dest destination address
+   * \param p the packet to forward
+   * \param metaTag the DSR metadata of the packet
+   */
+  void BeginDecision (Ipv4Address dest, Ptr<const Packet> p, const DsrMetaTag &metaTag);
+  /**
+   * \brief Account for the outcome of a budget-aware lookup, and complete
+   * the decision record and fire the trace source if it is recorded.
+   * \param dropReason a DsrForwardingDecision::DropReason
+   * \param route the selected route, or DsrRoutingTable::NO_ROUTE if the
+   * packet is dropped
+   * \param lane the selected lane
+   * \param record the decision record was started by BeginDecision
+   */
+  void EndDecision (uint8_t dropReason, uint32_t route, uint32_t lane,
+                    bool record);
+
+  DsrForwardingDecision m_decision;    //!< decision being recorded
+  /// Trace source fired at the end of every budget-aware lookup
+  TracedCallback<const DsrForwardingDecision &> m_forwardingDecisionTrace;
+
+  /**
+   * \brief Schedule a route update after an interface event, if this router
+   * responds to them.
+   * \param interface the interface of the event
+   */
+  void TriggerRouteUpdate (uint32_t interface);
+
+  /// Trace source fired by every interface event scheduling a route update
+  TracedCallback<uint32_t> m_routeUpdateTriggerTrace;
+  /// Trace source fired when the route update scheduled by this router runs
+  TracedCallback<uint32_t, uint32_t> m_routeUpdateTrace;
 
   // DSRRouteManagerNSDB* m_nsdb;
 };
@@ -0,0 +1,1634 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <list>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include "ns3/test.h"
+#include "ns3/ptr.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/config.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/integer.h"
+#include "ns3/double.h"
+#include "ns3/nstime.h"
+#include "ns3/string.h"
+#include "ns3/simulator.h"
+#include "ns3/enum.h"
+#include "ns3/packet.h"
+#include "ns3/queue-disc.h"
+#include "ns3/node-container.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+#include "ns3/ipv4-dsr-routing-helper.h"
+#include "ns3/ipv4-dsr-routing.h"
+#include "ns3/dsr-router-interface.h"
+#include "ns3/dsr-route-manager.h"
+#include "ns3/dsr-candidate-queue.h"
+#include "ns3/dsr-routing-table.h"
+#include "ns3/ipv4-dsr-routing-table-entry.h"
+#include "ns3/dsr-route-manager-impl.h"
+#include "ns3/dsr-meta-tag.h"
+#include "ns3/dsr-virtual-queue-disc.h"
+#include "ns3/dsr-edf-queue.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check the pop order of DsrCandidateQueue against the sorted list
+ * it replaced.
+ *
+ * The list inserted a pushed vertex after the queued vertices of equal
+ * rank, and the SPF re-sorted it, stably, after lowering the distance of a
+ * queued vertex.  The routes the SPF installs follow the pop order, so the
+ * heap must pop the vertices in exactly the same order on random sequences
+ * of push, decrease-key and pop.
+ */
+class DsrCandidateQueueOrderTestCase : public TestCase
+{
+public:
+  DsrCandidateQueueOrderTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * \brief The order of the sorted list: distance, then network vertices
+   * before router vertices.
+   * \param v1 first vertex
+   * \param v2 second vertex
+   * \return true if v1 ranks before v2
+   */
+  static bool Before (const DSRVertex *v1, const DSRVertex *v2);
+};
+
+DsrCandidateQueueOrderTestCase::DsrCandidateQueueOrderTestCase ()
+  : TestCase ("DsrCandidateQueue pops in the order of the sorted candidate list")
+{
+}
+
+bool
+DsrCandidateQueueOrderTestCase::Before (const DSRVertex *v1, const DSRVertex *v2)
+{
+  if (v1->GetDistanceFromRoot () != v2->GetDistanceFromRoot ())
+    {
+      return v1->GetDistanceFromRoot () < v2->GetDistanceFromRoot ();
+    }
+  return v1->GetVertexType () == DSRVertex::VertexNetwork
+         && v2->GetVertexType () == DSRVertex::VertexRouter;
+}
+
+void
+DsrCandidateQueueOrderTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  random->SetStream (1);
+
+  for (uint32_t run = 0; run < 50; run++)
+    {
+      DsrCandidateQueue candidates;
+      std::list<DSRVertex *> reference;
+      uint32_t nextId = 1;
+      for (uint32_t op = 0; op < 1000; op++)
+        {
+          uint32_t draw = random->GetInteger (0, 9);
+          if (draw < 5 || reference.empty ())
+            {
+              // few distances, so that most vertices tie with others
+              DSRVertex *v = new DSRVertex ();
+              v->SetVertexId (Ipv4Address (nextId++));
+              v->SetVertexType (random->GetInteger (0, 1) ? DSRVertex::VertexRouter
+                                                          : DSRVertex::VertexNetwork);
+              v->SetDistanceFromRoot (random->GetInteger (0, 19));
+              candidates.Push (v);
+              reference.insert (std::upper_bound (reference.begin (), reference.end (), v, &Before), v);
+            }
+          else if (draw < 7)
+            {
+              std::list<DSRVertex *>::iterator i = reference.begin ();
+              std::advance (i, random->GetInteger (0, reference.size () - 1));
+              DSRVertex *v = *i;
+              if (v->GetDistanceFromRoot () == 0)
+                {
+                  continue;
+                }
+              v->SetDistanceFromRoot (random->GetInteger (0, v->GetDistanceFromRoot () - 1));
+              NS_TEST_ASSERT_MSG_EQ (candidates.Find (v->GetVertexId ()), v,
+                                     "Find does not return the queued vertex");
+              candidates.DecreaseKey (v);
+              reference.sort (&Before);
+            }
+          else
+            {
+              DSRVertex *v = candidates.Pop ();
+              NS_TEST_ASSERT_MSG_EQ (v, reference.front (),
+                                     "Run " << run << ", operation " << op << ": wrong vertex popped");
+              reference.pop_front ();
+              delete v;
+            }
+        }
+      while (!reference.empty ())
+        {
+          DSRVertex *v = candidates.Pop ();
+          NS_TEST_ASSERT_MSG_EQ (v, reference.front (), "Run " << run << ": wrong vertex drained");
+          reference.pop_front ();
+          delete v;
+        }
+      NS_TEST_ASSERT_MSG_EQ (candidates.Empty (), true, "Vertices left in the queue");
+    }
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check the lookups of DsrRoutingTable as host, network and AS
+ * external routes are added, sealed and removed, and the comparison of two
+ * sealed tables.
+ */
+class DsrRoutingTableTestCase : public TestCase
+{
+public:
+  DsrRoutingTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * \param table a table
+   * \param dest a destination
+   * \param interface the required outgoing interface, or -1 for any
+   * \return the host routes found, as identifiers separated by spaces
+   */
+  static std::string HostRoutes (const DsrRoutingTable &table, Ipv4Address dest, int32_t interface);
+  /**
+   * \param table a table
+   * \param dest a destination
+   * \param interface the required outgoing interface, or -1 for any
+   * \return the network routes found, as identifiers separated by spaces
+   */
+  static std::string NetworkRoutes (const DsrRoutingTable &table, Ipv4Address dest, int32_t interface);
+  /**
+   * \param table a table
+   * \param dest a destination
+   * \param interface the required outgoing interface, or -1 for any
+   * \return the AS external routes found, as identifiers separated by spaces
+   */
+  static std::string ExternalRoutes (const DsrRoutingTable &table, Ipv4Address dest, int32_t interface);
+  /**
+   * \param routes route identifiers
+   * \return the identifiers separated by spaces
+   */
+  static std::string Ids (const DsrRoutingTable::RouteIds &routes);
+  /**
+   * \brief Add the routes the tables compared by the test start with.
+   * \param table the table
+   * \param h2Distance the distance of the route to the second host
+   */
+  static void AddCommonRoutes (DsrRoutingTable &table, uint32_t h2Distance);
+};
+
+DsrRoutingTableTestCase::DsrRoutingTableTestCase ()
+  : TestCase ("DsrRoutingTable lookups through adds, seals and removes")
+{
+}
+
+std::string
+DsrRoutingTableTestCase::Ids (const DsrRoutingTable::RouteIds &routes)
+{
+  std::ostringstream os;
+  for (uint32_t i = 0; i < routes.size (); i++)
+    {
+      os << (i == 0 ? "" : " ") << routes[i];
+    }
+  return os.str ();
+}
+
+std::string
+DsrRoutingTableTestCase::HostRoutes (const DsrRoutingTable &table, Ipv4Address dest, int32_t interface)
+{
+  DsrRoutingTable::RouteIds routes;
+  table.LookupHostRoutes (dest, interface, routes);
+  return Ids (routes);
+}
+
+std::string
+DsrRoutingTableTestCase::NetworkRoutes (const DsrRoutingTable &table, Ipv4Address dest, int32_t interface)
+{
+  DsrRoutingTable::RouteIds routes;
+  table.LookupNetworkRoutes (dest, interface, routes);
+  return Ids (routes);
+}
+
+std::string
+DsrRoutingTableTestCase::ExternalRoutes (const DsrRoutingTable &table, Ipv4Address dest, int32_t interface)
+{
+  DsrRoutingTable::RouteIds routes;
+  table.LookupASExternalRoutes (dest, interface, routes);
+  return Ids (routes);
+}
+
+void
+DsrRoutingTableTestCase::AddCommonRoutes (DsrRoutingTable &table, uint32_t h2Distance)
+{
+  table.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (Ipv4Address ("10.0.1.1"), Ipv4Address ("10.0.0.2"), 1, 20));
+  table.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (Ipv4Address ("10.0.1.1"), Ipv4Address ("10.0.0.6"), 2, 10));
+  table.AddNetworkRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("10.0.0.0"), Ipv4Mask ("255.0.0.0"),
+                                                                         Ipv4Address ("10.0.0.2"), 1));
+  table.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (Ipv4Address ("10.0.2.2"), Ipv4Address ("10.0.0.6"), 2, h2Distance));
+}
+
+void
+DsrRoutingTableTestCase::DoRun (void)
+{
+  Ipv4Address h1 ("10.0.1.1");
+  Ipv4Address h2 ("10.0.2.2");
+  Ipv4Address gw1 ("10.0.0.2");
+  Ipv4Address gw2 ("10.0.0.6");
+  Ipv4Address gw3 ("10.0.0.10");
+
+  // routes 0 and 1 go to h1, 2 to 4 to nested networks, 5 and 6 are
+  // external, 7 goes to h2
+  DsrRoutingTable table;
+  table.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (h1, gw1, 1, 20));
+  table.AddNetworkRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("10.0.0.0"), Ipv4Mask ("255.0.0.0"), gw1, 1));
+  table.AddNetworkRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("10.1.0.0"), Ipv4Mask ("255.255.0.0"), gw2, 2));
+  table.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (h1, gw2, 2, 10));
+  table.AddNetworkRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("10.1.2.0"), Ipv4Mask ("255.255.255.0"), gw1, 1));
+  table.AddASExternalRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("0.0.0.0"), Ipv4Mask ("0.0.0.0"), gw2, 2));
+  table.AddASExternalRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("192.168.0.0"), Ipv4Mask ("255.255.0.0"), gw1, 1));
+  table.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (h2, gw2, 2, 30));
+  NS_TEST_ASSERT_MSG_EQ (table.IsSealed (), false, "Added routes are only logged");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNRoutes (), 0, "Logged routes counted before Seal");
+
+  table.Seal ();
+  NS_TEST_ASSERT_MSG_EQ (table.IsSealed (), true, "Seal left logged routes");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNRoutes (), 8, "Wrong number of routes");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNHostRoutes (), 3, "Wrong number of host routes");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNNetworkRoutes (), 3, "Wrong number of network routes");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNASExternalRoutes (), 2, "Wrong number of external routes");
+  NS_TEST_ASSERT_MSG_EQ (table.GetGateway (1), gw2, "The routes of h1 are not grouped in their order");
+  NS_TEST_ASSERT_MSG_EQ (table.GetDest (7), h2, "Wrong destination of the last route");
+  NS_TEST_ASSERT_MSG_EQ (table.GetDistance (7), 30, "Wrong distance of the last route");
+  NS_TEST_ASSERT_MSG_EQ (HostRoutes (table, h1, -1), "0 1", "Wrong host routes to h1");
+  NS_TEST_ASSERT_MSG_EQ (HostRoutes (table, h1, 2), "1", "Wrong host routes to h1 through interface 2");
+  NS_TEST_ASSERT_MSG_EQ (HostRoutes (table, h1, 3), "", "Host route to h1 through interface 3");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h1), 1, "Wrong best host route to h1");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h2), 7, "Wrong best host route to h2");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (Ipv4Address ("10.0.3.3")), DsrRoutingTable::NO_ROUTE,
+                         "Best host route to an unknown host");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.2.3"), -1), "4", "The /24 is the longest match");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.2.3"), 2), "3",
+                         "The /16 is the longest match with a route through interface 2");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.2.3"), 3), "", "Network route through interface 3");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.3.3"), -1), "3", "The /16 is the longest match");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.2.0.1"), -1), "2", "The /8 is the longest match");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("11.0.0.1"), -1), "", "Network route outside 10/8");
+  NS_TEST_ASSERT_MSG_EQ (ExternalRoutes (table, Ipv4Address ("192.168.1.1"), -1), "6", "The /16 is the longest match");
+  NS_TEST_ASSERT_MSG_EQ (ExternalRoutes (table, Ipv4Address ("192.168.1.1"), 2), "5",
+                         "The default route is the only match through interface 2");
+  NS_TEST_ASSERT_MSG_EQ (ExternalRoutes (table, Ipv4Address ("8.8.8.8"), -1), "5", "The default route matches anything");
+
+  // routes to known destinations join the group of their destination
+  table.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (h1, gw3, 3, 5));
+  table.AddNetworkRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("10.1.2.0"), Ipv4Mask ("255.255.255.0"), gw2, 2));
+  NS_TEST_ASSERT_MSG_EQ (table.IsSealed (), false, "Added routes are only logged");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNRoutes (), 8, "Logged routes counted before Seal");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h1), 1, "Logged route used before Seal");
+  table.Seal ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetNRoutes (), 10, "Wrong number of routes after the second Seal");
+  NS_TEST_ASSERT_MSG_EQ (HostRoutes (table, h1, -1), "0 1 2", "Wrong host routes to h1 after the second Seal");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h1), 2, "Wrong best host route to h1 after the second Seal");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h2), 9, "Wrong best host route to h2 after the second Seal");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.2.3"), -1), "5 6", "Wrong routes of the /24");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.2.3"), 2), "6", "Wrong route of the /24 through interface 2");
+
+  // the routes after a removed one shift down
+  table.RemoveRoute (2);
+  NS_TEST_ASSERT_MSG_EQ (table.GetNRoutes (), 9, "Wrong number of routes after a removal");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNHostRoutes (), 3, "Wrong number of host routes after a removal");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h1), 1, "Best host route to h1 not updated by the removal");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h2), 8, "Best host route to h2 not shifted by the removal");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.2.3"), -1), "4 5", "Routes of the /24 not shifted");
+  table.RemoveRoute (8);
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h2), DsrRoutingTable::NO_ROUTE, "Best host route to a removed host");
+  NS_TEST_ASSERT_MSG_EQ (HostRoutes (table, h2, -1), "", "Host route to a removed host");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNHostRoutes (), 2, "Wrong number of host routes after removing h2");
+  table.RemoveRoute (6);
+  NS_TEST_ASSERT_MSG_EQ (ExternalRoutes (table, Ipv4Address ("8.8.8.8"), -1), "", "The removed default route matches");
+  NS_TEST_ASSERT_MSG_EQ (ExternalRoutes (table, Ipv4Address ("192.168.1.1"), -1), "6", "External route not shifted");
+  NS_TEST_ASSERT_MSG_EQ (ExternalRoutes (table, Ipv4Address ("192.168.1.1"), 2), "", "External route through interface 2");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNASExternalRoutes (), 1, "Wrong number of external routes after a removal");
+  table.RemoveRoute (4);
+  table.RemoveRoute (4);
+  NS_TEST_ASSERT_MSG_EQ (table.GetNRoutes (), 5, "Wrong number of routes after the removals");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.2.3"), -1), "3",
+                         "The emptied /24 is still the longest match");
+  NS_TEST_ASSERT_MSG_EQ (ExternalRoutes (table, Ipv4Address ("192.168.1.1"), -1), "4", "External route not shifted");
+
+  // an emptied destination gets routes again
+  table.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (h2, gw1, 1, 15));
+  table.Seal ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetNRoutes (), 6, "Wrong number of routes after the last Seal");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNHostRoutes (), 3, "Wrong number of host routes after the last Seal");
+  NS_TEST_ASSERT_MSG_EQ (table.FindBestHostRoute (h2), 5, "Wrong best host route to h2 after the last Seal");
+  NS_TEST_ASSERT_MSG_EQ (table.GetGateway (5), gw1, "Wrong gateway of the new route to h2");
+  NS_TEST_ASSERT_MSG_EQ (NetworkRoutes (table, Ipv4Address ("10.1.2.3"), -1), "3",
+                         "The emptied /24 matches after the last Seal");
+
+  // routes 0 to 2 of a go to h1 and 10/8, route 3 to h2
+  DsrRoutingTable a;
+  AddCommonRoutes (a, 30);
+  a.Seal ();
+  NS_TEST_ASSERT_MSG_EQ (a.CountChanges (a), 0, "A table differs from itself");
+  NS_TEST_ASSERT_MSG_EQ (a.GetCommonHead (a), 4, "A table shares all its routes with itself");
+  NS_TEST_ASSERT_MSG_EQ (a.SameDestinations (a), true, "A table has its own destinations");
+
+  DsrRoutingTable b;
+  AddCommonRoutes (b, 40);
+  b.Seal ();
+  NS_TEST_ASSERT_MSG_EQ (a.CountChanges (b), 2, "One route of h2 changed distance");
+  NS_TEST_ASSERT_MSG_EQ (a.GetCommonHead (b), 3, "The head stops at h2");
+  NS_TEST_ASSERT_MSG_EQ (b.GetCommonHead (a), 3, "The head stops at h2");
+  NS_TEST_ASSERT_MSG_EQ (a.SameDestinations (b), true, "No destination came or went");
+
+  // a third route to h1 shifts every later route
+  DsrRoutingTable c;
+  AddCommonRoutes (c, 30);
+  c.AddHostRoute (Ipv4DSRRoutingTableEntry::CreateHostRouteTo (h1, gw3, 3, 5));
+  c.Seal ();
+  NS_TEST_ASSERT_MSG_EQ (a.CountChanges (c), 1, "One route added to h1");
+  NS_TEST_ASSERT_MSG_EQ (a.GetCommonHead (c), 0, "The head cut h1, whose routes changed");
+  NS_TEST_ASSERT_MSG_EQ (a.SameDestinations (c), true, "No destination came or went");
+
+  // a new destination comes after the others
+  DsrRoutingTable d;
+  AddCommonRoutes (d, 30);
+  d.AddNetworkRoute (Ipv4DSRRoutingTableEntry::CreateNetworkRouteTo (Ipv4Address ("10.1.0.0"), Ipv4Mask ("255.255.0.0"), gw2, 2));
+  d.Seal ();
+  NS_TEST_ASSERT_MSG_EQ (a.CountChanges (d), 1, "One network route added");
+  NS_TEST_ASSERT_MSG_EQ (a.GetCommonHead (d), 4, "The routes of a all keep their identifiers");
+  NS_TEST_ASSERT_MSG_EQ (a.SameDestinations (d), false, "A destination was added");
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Base of the test cases checking that two ways of building the DSR
+ * routes install the same routes, in the same order, on every node.
+ *
+ * The topology is a 3x3 grid of point-to-point links with a stub router
+ * hanging off a corner.  Most metrics are equal, so most destinations have
+ * several equal-cost routes, whose order follows the order in which the
+ * SPF meets the candidates.
+ */
+class DsrRouteBuildTestCase : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param name the name of the test case
+   */
+  DsrRouteBuildTestCase (std::string name);
+
+protected:
+  /// the routes of every node, in table order, one line per route
+  typedef std::vector<std::string> Routes;
+
+  /**
+   * \brief Create the routers, the links and the addresses.
+   */
+  void BuildTopology (void);
+  /**
+   * \brief Build the routes of every router from scratch.
+   */
+  static void RebuildRoutes (void);
+  /**
+   * \brief Collect the routes of every router.
+   * \param routes the routes
+   */
+  void GetRoutes (Routes &routes) const;
+  /**
+   * \brief Check that two builds installed the same routes.
+   * \param expected the routes of the reference build
+   * \param actual the routes of the build under test
+   * \param what the build under test
+   */
+  void CheckSameRoutes (const Routes &expected, const Routes &actual, std::string what);
+
+  NodeContainer m_nodes;  //!< the routers
+
+private:
+  virtual void DoTeardown (void);
+  /**
+   * \brief Connect two routers.
+   * \param a a router
+   * \param b a router
+   * \param metric the metric of the link, both ways
+   */
+  void Link (uint32_t a, uint32_t b, uint16_t metric);
+
+  PointToPointHelper m_p2p;     //!< creates the links
+  Ipv4AddressHelper m_address;  //!< numbers the links
+};
+
+DsrRouteBuildTestCase::DsrRouteBuildTestCase (std::string name)
+  : TestCase (name)
+{
+}
+
+void
+DsrRouteBuildTestCase::BuildTopology (void)
+{
+  m_nodes.Create (10);
+  Ipv4DSRRoutingHelper dsr;
+  Ipv4ListRoutingHelper list;
+  list.Add (dsr, 10);
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (list);
+  internet.Install (m_nodes);
+
+  m_p2p.SetDeviceAttribute ("DataRate", StringValue ("10Mbps"));
+  m_p2p.SetChannelAttribute ("Delay", StringValue ("1ms"));
+  m_address.SetBase ("10.1.1.0", "255.255.255.0");
+  //
+  //   n0 - n1 - n2
+  //   |    |    |
+  //   n3 - n4 = n5       (= has metric 20, the other links 10)
+  //   |    |    |
+  //   n6 - n7 - n8 - n9
+  //
+  Link (0, 1, 10);
+  Link (1, 2, 10);
+  Link (3, 4, 10);
+  Link (4, 5, 20);
+  Link (6, 7, 10);
+  Link (7, 8, 10);
+  Link (0, 3, 10);
+  Link (3, 6, 10);
+  Link (1, 4, 10);
+  Link (4, 7, 10);
+  Link (2, 5, 10);
+  Link (5, 8, 10);
+  Link (8, 9, 10);
+}
+
+void
+DsrRouteBuildTestCase::Link (uint32_t a, uint32_t b, uint16_t metric)
+{
+  NetDeviceContainer devices = m_p2p.Install (m_nodes.Get (a), m_nodes.Get (b));
+  Ipv4InterfaceContainer interfaces = m_address.Assign (devices);
+  interfaces.SetMetric (0, metric);
+  interfaces.SetMetric (1, metric);
+  m_address.NewNetwork ();
+}
+
+void
+DsrRouteBuildTestCase::RebuildRoutes (void)
+{
+  DSRRouteManager::DeleteDSRRoutes ();
+  DSRRouteManager::BuildDSRRoutingDatabase ();
+  DSRRouteManager::InitializeRoutes ();
+}
+
+void
+DsrRouteBuildTestCase::GetRoutes (Routes &routes) const
+{
+  routes.clear ();
+  for (uint32_t n = 0; n < m_nodes.GetN (); n++)
+    {
+      Ptr<Ipv4DSRRouting> routing = m_nodes.Get (n)->GetObject<DSRRouter> ()->GetRoutingProtocol ();
+      for (uint32_t i = 0; i < routing->GetNRoutes (); i++)
+        {
+          Ipv4DSRRoutingTableEntry route = routing->GetRoute (i);
+          std::ostringstream os;
+          os << "node " << n << " route " << i << ": " << route.GetDestNetwork ()
+             << "/" << route.GetDestNetworkMask () << " via " << route.GetGateway ()
+             << " interface " << route.GetInterface () << " distance " << route.GetDistance ();
+          routes.push_back (os.str ());
+        }
+    }
+}
+
+void
+DsrRouteBuildTestCase::CheckSameRoutes (const Routes &expected, const Routes &actual, std::string what)
+{
+  NS_TEST_ASSERT_MSG_NE (expected.size (), 0, "The reference build installed no route");
+  NS_TEST_ASSERT_MSG_EQ (actual.size (), expected.size (),
+                         what << " installed " << actual.size () << " routes instead of " << expected.size ());
+  for (uint32_t i = 0; i < expected.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (actual[i], expected[i], what << " installed a different route");
+    }
+}
+
+void
+DsrRouteBuildTestCase::DoTeardown (void)
+{
+  DSRRouteManager::DeleteDSRRoutes ();
+  // the address map is shared by every router of the process
+  Ipv4DSRRouting::ClearRouterAddresses ();
+  Config::SetGlobal ("DsrSpfGraph", BooleanValue (false));
+  Config::SetGlobal ("DsrSpfPerRouter", BooleanValue (false));
+  Config::SetGlobal ("DsrSpfThreads", UintegerValue (1));
+  Config::SetGlobal ("DsrRouterRoutes", BooleanValue (false));
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check that the SPF over the DsrSpfGraph snapshot installs the
+ * routes of the SPF over DSRVertex trees, in both route build modes.
+ */
+class DsrSpfGraphTestCase : public DsrRouteBuildTestCase
+{
+public:
+  DsrSpfGraphTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DsrSpfGraphTestCase::DsrSpfGraphTestCase ()
+  : DsrRouteBuildTestCase ("DsrSpfGraph installs the routes of the DSRVertex SPF")
+{
+}
+
+void
+DsrSpfGraphTestCase::DoRun (void)
+{
+  BuildTopology ();
+  for (uint32_t perRouter = 0; perRouter < 2; perRouter++)
+    {
+      Config::SetGlobal ("DsrSpfPerRouter", BooleanValue (perRouter == 1));
+      Config::SetGlobal ("DsrSpfGraph", BooleanValue (false));
+      RebuildRoutes ();
+      Routes vertexRoutes;
+      GetRoutes (vertexRoutes);
+
+      Config::SetGlobal ("DsrSpfGraph", BooleanValue (true));
+      RebuildRoutes ();
+      Routes graphRoutes;
+      GetRoutes (graphRoutes);
+      CheckSameRoutes (vertexRoutes, graphRoutes,
+                       perRouter == 1 ? "DsrSpfGraph with DsrSpfPerRouter" : "DsrSpfGraph");
+    }
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check that the SPF trees computed on worker threads give the
+ * routes of the serial route build, in both route build modes.
+ */
+class DsrSpfThreadsTestCase : public DsrRouteBuildTestCase
+{
+public:
+  DsrSpfThreadsTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DsrSpfThreadsTestCase::DsrSpfThreadsTestCase ()
+  : DsrRouteBuildTestCase ("DsrSpfThreads installs the routes of the serial build")
+{
+}
+
+void
+DsrSpfThreadsTestCase::DoRun (void)
+{
+  BuildTopology ();
+  Config::SetGlobal ("DsrSpfGraph", BooleanValue (true));
+  for (uint32_t perRouter = 0; perRouter < 2; perRouter++)
+    {
+      Config::SetGlobal ("DsrSpfPerRouter", BooleanValue (perRouter == 1));
+      Config::SetGlobal ("DsrSpfThreads", UintegerValue (1));
+      RebuildRoutes ();
+      Routes serialRoutes;
+      GetRoutes (serialRoutes);
+
+      Config::SetGlobal ("DsrSpfThreads", UintegerValue (4));
+      RebuildRoutes ();
+      Routes parallelRoutes;
+      GetRoutes (parallelRoutes);
+      CheckSameRoutes (serialRoutes, parallelRoutes,
+                       perRouter == 1 ? "DsrSpfThreads with DsrSpfPerRouter" : "DsrSpfThreads");
+    }
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check that the incremental route updates triggered by interface
+ * events install the routes of a build from scratch.
+ *
+ * Each link of the test brings one interface down, then up again; the
+ * first link is on many shortest paths, the second on none.  After each
+ * event the routes are compared with those of DeleteDSRRoutes,
+ * BuildDSRRoutingDatabase and InitializeRoutes.
+ */
+class DsrIncrementalUpdateTestCase : public DsrRouteBuildTestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param perRouter the value of DsrSpfPerRouter
+   */
+  DsrIncrementalUpdateTestCase (bool perRouter);
+
+private:
+  virtual void DoRun (void);
+  /**
+   * \brief Bring an interface up or down.
+   * \param node the router
+   * \param interface the interface
+   * \param up true to bring it up, false to bring it down
+   */
+  void SetInterface (uint32_t node, uint32_t interface, bool up);
+  /**
+   * \brief Compare the routes left by the update with a build from scratch.
+   * \param what the event the update served
+   */
+  void CheckUpdate (std::string what);
+
+  bool m_perRouter;  //!< value of DsrSpfPerRouter
+};
+
+DsrIncrementalUpdateTestCase::DsrIncrementalUpdateTestCase (bool perRouter)
+  : DsrRouteBuildTestCase (perRouter ? "Incremental route updates with DsrSpfPerRouter match a full build"
+                                     : "Incremental route updates match a full build"),
+    m_perRouter (perRouter)
+{
+}
+
+void
+DsrIncrementalUpdateTestCase::SetInterface (uint32_t node, uint32_t interface, bool up)
+{
+  Ptr<Ipv4> ipv4 = m_nodes.Get (node)->GetObject<Ipv4> ();
+  if (up)
+    {
+      ipv4->SetUp (interface);
+    }
+  else
+    {
+      ipv4->SetDown (interface);
+    }
+}
+
+void
+DsrIncrementalUpdateTestCase::CheckUpdate (std::string what)
+{
+  Routes updated;
+  GetRoutes (updated);
+  RebuildRoutes ();
+  Routes rebuilt;
+  GetRoutes (rebuilt);
+  CheckSameRoutes (rebuilt, updated, what);
+}
+
+void
+DsrIncrementalUpdateTestCase::DoRun (void)
+{
+  BuildTopology ();
+  // the incremental updates run over the SPF graph snapshot
+  Config::SetGlobal ("DsrSpfGraph", BooleanValue (true));
+  Config::SetGlobal ("DsrSpfPerRouter", BooleanValue (m_perRouter));
+  for (uint32_t n = 0; n < m_nodes.GetN (); n++)
+    {
+      Ptr<Ipv4DSRRouting> routing = m_nodes.Get (n)->GetObject<DSRRouter> ()->GetRoutingProtocol ();
+      routing->SetAttribute ("RespondToInterfaceEvents", BooleanValue (true));
+    }
+  RebuildRoutes ();
+  uint64_t updates = DSRRouteManager::GetNUpdates ();
+
+  // interface 3 of n1 leads to n4, interface 2 of n4 to n5
+  Simulator::Schedule (Seconds (1), &DsrIncrementalUpdateTestCase::SetInterface, this, 1, 3, false);
+  Simulator::Schedule (Seconds (2), &DsrIncrementalUpdateTestCase::CheckUpdate, this,
+                       std::string ("Update after n1-n4 went down"));
+  Simulator::Schedule (Seconds (3), &DsrIncrementalUpdateTestCase::SetInterface, this, 1, 3, true);
+  Simulator::Schedule (Seconds (4), &DsrIncrementalUpdateTestCase::CheckUpdate, this,
+                       std::string ("Update after n1-n4 came back up"));
+  Simulator::Schedule (Seconds (5), &DsrIncrementalUpdateTestCase::SetInterface, this, 4, 2, false);
+  Simulator::Schedule (Seconds (6), &DsrIncrementalUpdateTestCase::CheckUpdate, this,
+                       std::string ("Update after n4-n5 went down"));
+  Simulator::Schedule (Seconds (7), &DsrIncrementalUpdateTestCase::SetInterface, this, 4, 2, true);
+  Simulator::Schedule (Seconds (8), &DsrIncrementalUpdateTestCase::CheckUpdate, this,
+                       std::string ("Update after n4-n5 came back up"));
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (DSRRouteManager::GetNUpdates () - updates, 4u,
+                         "Every interface event should have run one route update");
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check that one host route per destination router gives every
+ * address of the router the next hops of its own host routes.
+ *
+ * With "DsrRouterRoutes" the addresses resolve to their router through a
+ * map shared by every Ipv4DSRRouting; the test also checks that the map
+ * is the only way to them, and that a later build without the option does
+ * not depend on it.
+ */
+class DsrRouterRoutesTestCase : public DsrRouteBuildTestCase
+{
+public:
+  DsrRouterRoutesTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * \brief Look up the next hop of every router towards every address of
+   * the other routers, through any interface and through each interface.
+   * \param lookups the next hops, one line per lookup
+   */
+  void GetLookups (Routes &lookups) const;
+  /**
+   * \brief Look up the route of a router towards an address.
+   * \param node the router
+   * \param dest the address
+   * \return the route, or 0 if none
+   */
+  Ptr<Ipv4Route> Lookup (uint32_t node, Ipv4Address dest) const;
+};
+
+DsrRouterRoutesTestCase::DsrRouterRoutesTestCase ()
+  : DsrRouteBuildTestCase ("DsrRouterRoutes gives the next hops of per-address host routes")
+{
+}
+
+Ptr<Ipv4Route>
+DsrRouterRoutesTestCase::Lookup (uint32_t node, Ipv4Address dest) const
+{
+  Ptr<Ipv4DSRRouting> routing = m_nodes.Get (node)->GetObject<DSRRouter> ()->GetRoutingProtocol ();
+  Ipv4Header header;
+  header.SetDestination (dest);
+  Socket::SocketErrno sockerr;
+  return routing->RouteOutput (Ptr<Packet> (), header, Ptr<NetDevice> (), sockerr);
+}
+
+void
+DsrRouterRoutesTestCase::GetLookups (Routes &lookups) const
+{
+  lookups.clear ();
+  for (uint32_t n = 0; n < m_nodes.GetN (); n++)
+    {
+      Ptr<Ipv4> ipv4 = m_nodes.Get (n)->GetObject<Ipv4> ();
+      Ptr<Ipv4DSRRouting> routing = m_nodes.Get (n)->GetObject<DSRRouter> ()->GetRoutingProtocol ();
+      for (uint32_t m = 0; m < m_nodes.GetN (); m++)
+        {
+          Ptr<Ipv4> remote = m_nodes.Get (m)->GetObject<Ipv4> ();
+          for (uint32_t j = 1; m != n && j < remote->GetNInterfaces (); j++)
+            {
+              Ipv4Address dest = remote->GetAddress (j, 0).GetLocal ();
+              // interface 0, the loopback, stands for any interface
+              for (uint32_t oif = 0; oif < ipv4->GetNInterfaces (); oif++)
+                {
+                  Ipv4Header header;
+                  header.SetDestination (dest);
+                  Socket::SocketErrno sockerr;
+                  Ptr<NetDevice> device = oif == 0 ? Ptr<NetDevice> () : ipv4->GetNetDevice (oif);
+                  Ptr<Ipv4Route> route = routing->RouteOutput (Ptr<Packet> (), header, device, sockerr);
+                  std::ostringstream os;
+                  os << "node " << n << " to " << dest << " through interface " << oif << ": ";
+                  if (route == 0)
+                    {
+                      os << "no route";
+                    }
+                  else
+                    {
+                      os << "via " << route->GetGateway () << " interface "
+                         << ipv4->GetInterfaceForDevice (route->GetOutputDevice ());
+                    }
+                  lookups.push_back (os.str ());
+                }
+            }
+        }
+    }
+}
+
+void
+DsrRouterRoutesTestCase::DoRun (void)
+{
+  BuildTopology ();
+  Config::SetGlobal ("DsrRouterRoutes", BooleanValue (false));
+  RebuildRoutes ();
+  Routes addressRoutes;
+  GetRoutes (addressRoutes);
+  Routes addressLookups;
+  GetLookups (addressLookups);
+
+  Config::SetGlobal ("DsrRouterRoutes", BooleanValue (true));
+  RebuildRoutes ();
+  Routes routerRoutes;
+  GetRoutes (routerRoutes);
+  NS_TEST_ASSERT_MSG_LT (routerRoutes.size (), addressRoutes.size (),
+                         "One host route per router should take fewer routes than one per address");
+  Routes routerLookups;
+  GetLookups (routerLookups);
+  CheckSameRoutes (addressLookups, routerLookups, "DsrRouterRoutes");
+
+  // n9 has a single address, reached through the map
+  Ipv4Address n9 = m_nodes.Get (9)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  Ipv4Address n9RouterId = m_nodes.Get (9)->GetObject<DSRRouter> ()->GetRouterId ();
+  Ptr<Ipv4Route> route = Lookup (0, n9);
+  NS_TEST_ASSERT_MSG_NE (route, 0, "No route to the address of n9");
+  NS_TEST_ASSERT_MSG_EQ (route->GetDestination (), n9RouterId, "The address of n9 did not resolve to its router");
+  Ipv4DSRRouting::ClearRouterAddresses ();
+  route = Lookup (0, n9);
+  NS_TEST_ASSERT_MSG_EQ (route == 0 || route->GetDestination () != n9RouterId, true,
+                         "The address of n9 resolved to its router without the map");
+
+  // the next builds fill the map again, or leave it empty
+  RebuildRoutes ();
+  GetLookups (routerLookups);
+  CheckSameRoutes (addressLookups, routerLookups, "DsrRouterRoutes after ClearRouterAddresses");
+  Config::SetGlobal ("DsrRouterRoutes", BooleanValue (false));
+  RebuildRoutes ();
+  Routes rebuiltRoutes;
+  GetRoutes (rebuiltRoutes);
+  CheckSameRoutes (addressRoutes, rebuiltRoutes, "A build after DsrRouterRoutes");
+  Routes rebuiltLookups;
+  GetLookups (rebuiltLookups);
+  CheckSameRoutes (addressLookups, rebuiltLookups, "A build after DsrRouterRoutes");
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief A queue disc item without a network header, for the tests that
+ * drive the queues of the module directly.
+ */
+class DsrTestQueueDiscItem : public QueueDiscItem
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param p the packet
+   */
+  DsrTestQueueDiscItem (Ptr<Packet> p);
+  virtual void AddHeader (void);
+  virtual bool Mark (void);
+
+  /**
+   * \brief Create an item whose packet carries DSR metadata.
+   * \param size the packet size, in bytes
+   * \param lane the lane of the packet
+   * \param budget the delay budget, in microseconds from now
+   * \return the item
+   */
+  static Ptr<DsrTestQueueDiscItem> CreateTagged (uint32_t size, uint32_t lane, uint32_t budget);
+};
+
+DsrTestQueueDiscItem::DsrTestQueueDiscItem (Ptr<Packet> p)
+  : QueueDiscItem (p, Address (), 0)
+{
+}
+
+void
+DsrTestQueueDiscItem::AddHeader (void)
+{
+}
+
+bool
+DsrTestQueueDiscItem::Mark (void)
+{
+  return false;
+}
+
+Ptr<DsrTestQueueDiscItem>
+DsrTestQueueDiscItem::CreateTagged (uint32_t size, uint32_t lane, uint32_t budget)
+{
+  Ptr<Packet> p = ns3::Create<Packet> (size);
+  DsrMetaTag tag;
+  tag.SetTimestamp (Simulator::Now ());
+  tag.SetBudget (budget);
+  tag.SetLane (lane);
+  tag.AddTo (p, false);
+  return ns3::Create<DsrTestQueueDiscItem> (p);
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check that the DRR scheduler of DsrVirtualQueueDisc serves the
+ * backlogged lanes in proportion to their shares, in bytes.
+ *
+ * The lanes send packets of different sizes, so a packet count would not
+ * do.  A lane that empties leaves the round: when it comes back it starts
+ * over with one quantum, whatever deficit it had left.
+ */
+class DsrDrrSchedulerTestCase : public TestCase
+{
+public:
+  DsrDrrSchedulerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DsrDrrSchedulerTestCase::DsrDrrSchedulerTestCase ()
+  : TestCase ("DRR serves the lanes of DsrVirtualQueueDisc in proportion to their shares")
+{
+}
+
+void
+DsrDrrSchedulerTestCase::DoRun (void)
+{
+  const uint32_t nLanes = 3;
+  const double shares[nLanes] = { 0.5, 0.3, 0.2 };
+  const uint32_t sizes[nLanes] = { 1500, 1000, 600 };
+  const uint32_t roundSize = 15000;
+  const uint32_t rounds = 10;
+  // lane 1 empties in the middle of its turn of the round after them
+  const uint32_t lane1Packets = 47;
+
+  Ptr<DsrVirtualQueueDisc> qdisc = CreateObject<DsrVirtualQueueDisc> ();
+  qdisc->SetAttribute ("Scheduler", EnumValue (DsrVirtualQueueDisc::DRR));
+  qdisc->SetAttribute ("LaneCapacities", StringValue ("100 100 100"));
+  qdisc->SetAttribute ("LaneShares", StringValue ("0.5 0.3 0.2"));
+  qdisc->SetAttribute ("DrrRoundSize", UintegerValue (roundSize));
+  qdisc->Initialize ();
+
+  for (uint32_t lane = 0; lane < nLanes; lane++)
+    {
+      uint32_t n = lane == 1 ? lane1Packets : 100;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          NS_TEST_ASSERT_MSG_EQ (qdisc->Enqueue (DsrTestQueueDiscItem::CreateTagged (sizes[lane], lane, 0)), true,
+                                 "Could not enqueue in lane " << lane);
+        }
+    }
+
+  // the lanes tell apart by the size of their packets
+  uint64_t bytes[nLanes] = { 0, 0, 0 };
+  uint64_t total = 0;
+  while (total < rounds * roundSize)
+    {
+      Ptr<QueueDiscItem> item = qdisc->Dequeue ();
+      NS_TEST_ASSERT_MSG_NE (item, 0, "A backlogged queue disc returned no packet");
+      uint32_t lane = std::find (sizes, sizes + nLanes, item->GetSize ()) - sizes;
+      NS_TEST_ASSERT_MSG_LT (lane, nLanes, "Unexpected packet size " << item->GetSize ());
+      bytes[lane] += item->GetSize ();
+      total += item->GetSize ();
+    }
+  NS_TEST_ASSERT_MSG_EQ (total, rounds * roundSize, "The rounds did not end on a packet boundary");
+  for (uint32_t lane = 0; lane < nLanes; lane++)
+    {
+      // DRR keeps every lane within a packet of its share
+      NS_TEST_ASSERT_MSG_EQ_TOL (static_cast<double> (bytes[lane]), shares[lane] * total, sizes[lane],
+                                 "Lane " << lane << " was not served at its share");
+    }
+
+  // drain lane 1, which leaves the round with a deficit left
+  uint32_t lane1Sent = bytes[1] / sizes[1];
+  while (lane1Sent < lane1Packets)
+    {
+      Ptr<QueueDiscItem> item = qdisc->Dequeue ();
+      NS_TEST_ASSERT_MSG_NE (item, 0, "A backlogged queue disc returned no packet");
+      if (item->GetSize () == sizes[1])
+        {
+          lane1Sent++;
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (qdisc->GetInternalQueue (1)->IsEmpty (), true, "Lane 1 did not empty");
+
+  // back in the round, lane 1 sends one quantum, and a packet past it
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      qdisc->Enqueue (DsrTestQueueDiscItem::CreateTagged (sizes[1], 1, 0));
+    }
+  uint32_t turn = 0;
+  while (true)
+    {
+      Ptr<QueueDiscItem> item = qdisc->Dequeue ();
+      NS_TEST_ASSERT_MSG_NE (item, 0, "A backlogged queue disc returned no packet");
+      if (item->GetSize () == sizes[1])
+        {
+          turn++;
+        }
+      else if (turn > 0)
+        {
+          break;
+        }
+    }
+  uint32_t quantum = static_cast<uint32_t> (shares[1] * roundSize + 0.5);
+  NS_TEST_ASSERT_MSG_EQ (turn, (quantum + sizes[1] - 1) / sizes[1],
+                         "Lane 1 did not come back with a fresh quantum");
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check the "DropExpired" option of DsrVirtualQueueDisc, with both
+ * schedulers.
+ *
+ * A packet whose budget has run out is dropped at the head of its lane,
+ * counted in "ExpiredDrops", reported with EXPIRED_DROP, and its link time
+ * goes back to its lane: the WRR credit or the DRR deficit it used is
+ * refunded, which shows in the order of the packets after it.  Peek drops
+ * it too, so that it shows the packet the next Dequeue returns.
+ */
+class DsrExpiredDropTestCase : public TestCase
+{
+public:
+  DsrExpiredDropTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * \brief Create a queue disc of two lanes that drops the expired packets.
+   * \param scheduler the scheduler
+   * \return the queue disc
+   */
+  Ptr<DsrVirtualQueueDisc> CreateQueueDisc (DsrVirtualQueueDisc::Scheduler scheduler);
+  /**
+   * \brief Check that the expired packet is dropped, and the order of the
+   * packets left.
+   * \param qdisc the queue disc
+   * \param order the packets, in the expected order of service
+   * \param what the scheduler
+   */
+  void CheckService (Ptr<DsrVirtualQueueDisc> qdisc, std::vector<Ptr<QueueDiscItem> > order, std::string what);
+  /**
+   * \brief Sink of the "DropAfterDequeue" trace source.
+   * \param item the dropped packet
+   * \param reason the reason of the drop
+   */
+  void RecordDrop (Ptr<const QueueDiscItem> item, const char *reason);
+
+  std::vector<std::string> m_reasons;  //!< reasons of the drops after dequeue
+};
+
+DsrExpiredDropTestCase::DsrExpiredDropTestCase ()
+  : TestCase ("DsrVirtualQueueDisc drops the expired packets and refunds their lane")
+{
+}
+
+Ptr<DsrVirtualQueueDisc>
+DsrExpiredDropTestCase::CreateQueueDisc (DsrVirtualQueueDisc::Scheduler scheduler)
+{
+  Ptr<DsrVirtualQueueDisc> qdisc = CreateObject<DsrVirtualQueueDisc> ();
+  qdisc->SetAttribute ("Scheduler", EnumValue (scheduler));
+  qdisc->SetAttribute ("LaneCapacities", StringValue ("100 100"));
+  qdisc->SetAttribute ("LaneShares", StringValue ("0.5 0.5"));
+  qdisc->SetAttribute ("LaneWeights", StringValue ("2 1"));
+  qdisc->SetAttribute ("DrrRoundSize", UintegerValue (2000));
+  qdisc->SetAttribute ("DropExpired", BooleanValue (true));
+  qdisc->Initialize ();
+  qdisc->TraceConnectWithoutContext ("DropAfterDequeue", MakeCallback (&DsrExpiredDropTestCase::RecordDrop, this));
+  return qdisc;
+}
+
+void
+DsrExpiredDropTestCase::RecordDrop (Ptr<const QueueDiscItem> item, const char *reason)
+{
+  m_reasons.push_back (reason);
+}
+
+void
+DsrExpiredDropTestCase::CheckService (Ptr<DsrVirtualQueueDisc> qdisc, std::vector<Ptr<QueueDiscItem> > order,
+                                      std::string what)
+{
+  m_reasons.clear ();
+  NS_TEST_ASSERT_MSG_EQ (qdisc->GetExpiredDrops (), 0, what << ": dropped a packet before the dequeue");
+  Ptr<const QueueDiscItem> peeked = qdisc->Peek ();
+  NS_TEST_ASSERT_MSG_EQ (peeked, order[0], what << ": Peek showed the expired packet");
+  NS_TEST_ASSERT_MSG_EQ (qdisc->GetExpiredDrops (), 1, what << ": the expired packet was not counted");
+  UintegerValue expiredDrops;
+  qdisc->GetAttribute ("ExpiredDrops", expiredDrops);
+  NS_TEST_ASSERT_MSG_EQ (expiredDrops.Get (), 1, what << ": wrong \"ExpiredDrops\" attribute");
+  NS_TEST_ASSERT_MSG_EQ (m_reasons.size (), 1, what << ": the expired packet was not reported");
+  NS_TEST_ASSERT_MSG_EQ (m_reasons[0], DsrVirtualQueueDisc::EXPIRED_DROP, what << ": wrong drop reason");
+
+  // the refund lets the lane of the expired packet send one more packet
+  // before the other lane
+  for (uint32_t i = 0; i < order.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (qdisc->Dequeue (), order[i], what << ": packet " << i << " out of order");
+    }
+  NS_TEST_ASSERT_MSG_EQ (qdisc->Dequeue (), 0, what << ": packets left after the last one");
+  NS_TEST_ASSERT_MSG_EQ (qdisc->GetExpiredDrops (), 1, what << ": a live packet was dropped");
+}
+
+void
+DsrExpiredDropTestCase::DoRun (void)
+{
+  // the first packet of lane 0 expires after 100 us, the others after 1 s
+  Ptr<DsrVirtualQueueDisc> wrr = CreateQueueDisc (DsrVirtualQueueDisc::WRR);
+  Ptr<QueueDiscItem> expired = DsrTestQueueDiscItem::CreateTagged (1000, 0, 100);
+  std::vector<Ptr<QueueDiscItem> > lane0;
+  std::vector<Ptr<QueueDiscItem> > lane1;
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      lane0.push_back (DsrTestQueueDiscItem::CreateTagged (1000, 0, 1000000));
+    }
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      lane1.push_back (DsrTestQueueDiscItem::CreateTagged (1000, 1, 1000000));
+    }
+  wrr->Enqueue (expired);
+  for (uint32_t i = 0; i < lane0.size (); i++)
+    {
+      wrr->Enqueue (lane0[i]);
+    }
+  for (uint32_t i = 0; i < lane1.size (); i++)
+    {
+      wrr->Enqueue (lane1[i]);
+    }
+  // two packets of lane 0 per round, one of lane 1
+  std::vector<Ptr<QueueDiscItem> > wrrOrder;
+  wrrOrder.push_back (lane0[0]);
+  wrrOrder.push_back (lane0[1]);
+  wrrOrder.push_back (lane1[0]);
+  wrrOrder.push_back (lane0[2]);
+  wrrOrder.push_back (lane1[1]);
+  Simulator::Schedule (MilliSeconds (1), &DsrExpiredDropTestCase::CheckService, this,
+                       wrr, wrrOrder, std::string ("WRR"));
+
+  // one packet of each lane per round
+  Ptr<DsrVirtualQueueDisc> drr = CreateQueueDisc (DsrVirtualQueueDisc::DRR);
+  expired = DsrTestQueueDiscItem::CreateTagged (1000, 0, 100);
+  drr->Enqueue (expired);
+  lane0.resize (2);
+  lane1.resize (1);
+  for (uint32_t i = 0; i < lane0.size (); i++)
+    {
+      lane0[i] = DsrTestQueueDiscItem::CreateTagged (1000, 0, 1000000);
+      drr->Enqueue (lane0[i]);
+    }
+  lane1[0] = DsrTestQueueDiscItem::CreateTagged (1000, 1, 1000000);
+  drr->Enqueue (lane1[0]);
+  std::vector<Ptr<QueueDiscItem> > drrOrder;
+  drrOrder.push_back (lane0[0]);
+  drrOrder.push_back (lane1[0]);
+  drrOrder.push_back (lane0[1]);
+  Simulator::Schedule (MilliSeconds (2), &DsrExpiredDropTestCase::CheckService, this,
+                       drr, drrOrder, std::string ("DRR"));
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check the sojourn times measured by DsrVirtualQueueDisc: the
+ * moving average of a known sequence, and the rollover of the windowed
+ * maximum.
+ *
+ * The maximum of a window is reported until the end of the next window,
+ * and forgotten after a whole window without any packet.
+ */
+class DsrSojournTestCase : public TestCase
+{
+public:
+  DsrSojournTestCase ();
+
+private:
+  virtual void DoRun (void);
+  /**
+   * \brief Enqueue a packet in the best-effort lane.
+   */
+  void Enqueue (void);
+  /**
+   * \brief Dequeue the packet of the best-effort lane.
+   */
+  void Dequeue (void);
+  /**
+   * \brief Check the sojourn times of the best-effort lane.
+   * \param average the expected moving average
+   * \param max the expected windowed maximum
+   */
+  void CheckSojourn (Time average, Time max);
+
+  Ptr<DsrVirtualQueueDisc> m_qdisc;  //!< the queue disc
+};
+
+DsrSojournTestCase::DsrSojournTestCase ()
+  : TestCase ("DsrVirtualQueueDisc measures the sojourn time of its lanes")
+{
+}
+
+void
+DsrSojournTestCase::Enqueue (void)
+{
+  // without metadata, the packet goes to the best-effort lane
+  m_qdisc->Enqueue (Create<DsrTestQueueDiscItem> (Create<Packet> (1000)));
+}
+
+void
+DsrSojournTestCase::Dequeue (void)
+{
+  NS_TEST_ASSERT_MSG_NE (m_qdisc->Dequeue (), 0, "No packet at " << Simulator::Now ().GetMilliSeconds () << " ms");
+}
+
+void
+DsrSojournTestCase::CheckSojourn (Time average, Time max)
+{
+  uint32_t lane = m_qdisc->GetNLanes () - 1;
+  NS_TEST_ASSERT_MSG_EQ (m_qdisc->GetLaneSojourn (lane), average,
+                         "Wrong average at " << Simulator::Now ().GetMilliSeconds () << " ms");
+  NS_TEST_ASSERT_MSG_EQ (m_qdisc->GetLaneMaxSojourn (lane), max,
+                         "Wrong maximum at " << Simulator::Now ().GetMilliSeconds () << " ms");
+  NS_TEST_ASSERT_MSG_EQ (m_qdisc->GetLaneSojourn (0), Time (), "A lane without packets has a sojourn time");
+}
+
+void
+DsrSojournTestCase::DoRun (void)
+{
+  m_qdisc = CreateObject<DsrVirtualQueueDisc> ();
+  m_qdisc->SetAttribute ("SojournEwmaWeight", DoubleValue (0.5));
+  m_qdisc->SetAttribute ("SojournWindow", TimeValue (MilliSeconds (100)));
+  m_qdisc->Initialize ();
+
+  // samples of 10, 30 and 10 ms in the first window
+  Simulator::Schedule (MilliSeconds (0), &DsrSojournTestCase::Enqueue, this);
+  Simulator::Schedule (MilliSeconds (10), &DsrSojournTestCase::Dequeue, this);
+  Simulator::Schedule (MilliSeconds (10), &DsrSojournTestCase::CheckSojourn, this,
+                       MilliSeconds (10), MilliSeconds (10));
+  Simulator::Schedule (MilliSeconds (20), &DsrSojournTestCase::Enqueue, this);
+  Simulator::Schedule (MilliSeconds (50), &DsrSojournTestCase::Dequeue, this);
+  Simulator::Schedule (MilliSeconds (50), &DsrSojournTestCase::CheckSojourn, this,
+                       MilliSeconds (20), MilliSeconds (30));
+  Simulator::Schedule (MilliSeconds (60), &DsrSojournTestCase::Enqueue, this);
+  Simulator::Schedule (MilliSeconds (70), &DsrSojournTestCase::Dequeue, this);
+  Simulator::Schedule (MilliSeconds (70), &DsrSojournTestCase::CheckSojourn, this,
+                       MilliSeconds (15), MilliSeconds (30));
+  // the first window has ended, and is still reported
+  Simulator::Schedule (MilliSeconds (150), &DsrSojournTestCase::CheckSojourn, this,
+                       MilliSeconds (15), MilliSeconds (30));
+  // a sample of 5 ms starts the second window, at 160 ms
+  Simulator::Schedule (MilliSeconds (155), &DsrSojournTestCase::Enqueue, this);
+  Simulator::Schedule (MilliSeconds (160), &DsrSojournTestCase::Dequeue, this);
+  Simulator::Schedule (MilliSeconds (160), &DsrSojournTestCase::CheckSojourn, this,
+                       MilliSeconds (10), MilliSeconds (30));
+  // the second window has ended: the first one is forgotten
+  Simulator::Schedule (MilliSeconds (270), &DsrSojournTestCase::CheckSojourn, this,
+                       MilliSeconds (10), MilliSeconds (5));
+  // a whole window without packets: nothing is left of the maximum
+  Simulator::Schedule (MilliSeconds (400), &DsrSojournTestCase::CheckSojourn, this,
+                       MilliSeconds (10), Time ());
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+  m_qdisc = 0;
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check the service order of DsrEdfQueue.
+ *
+ * The packets leave by deadline, in arrival order for equal deadlines,
+ * and the packets without DSR metadata after every packet with one.  Peek
+ * must show the packet the next Dequeue returns, and a packet dropped for
+ * MaxSize must leave no entry in the heap.
+ */
+class DsrEdfQueueTestCase : public TestCase
+{
+public:
+  DsrEdfQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DsrEdfQueueTestCase::DsrEdfQueueTestCase ()
+  : TestCase ("DsrEdfQueue serves the earliest deadline first")
+{
+}
+
+void
+DsrEdfQueueTestCase::DoRun (void)
+{
+  Ptr<DsrEdfQueue> queue = CreateObject<DsrEdfQueue> ();
+  queue->SetAttribute ("MaxSize", QueueSizeValue (QueueSize ("6p")));
+
+  // budgets in microseconds, all sent now; 0 stands for no metadata
+  const uint32_t budgets[] = { 500, 0, 100, 300, 100, 0 };
+  std::vector<Ptr<QueueDiscItem> > items;
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      if (budgets[i] == 0)
+        {
+          items.push_back (Create<DsrTestQueueDiscItem> (Create<Packet> (1000)));
+        }
+      else
+        {
+          items.push_back (DsrTestQueueDiscItem::CreateTagged (1000, 0, budgets[i]));
+        }
+      NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (items[i]), true, "Could not enqueue packet " << i);
+    }
+
+  // a full queue refuses even the earliest deadline, and forgets it
+  Ptr<QueueDiscItem> early = DsrTestQueueDiscItem::CreateTagged (1000, 0, 50);
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (early), false, "A full queue accepted a packet");
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (Create<DsrTestQueueDiscItem> (Create<Packet> (1000))), false,
+                         "A full queue accepted a packet without metadata");
+  NS_TEST_ASSERT_MSG_EQ (queue->GetNPackets (), 6, "The refused packets were queued");
+  NS_TEST_ASSERT_MSG_EQ (queue->GetTotalDroppedPackets (), 2, "The refused packets were not dropped");
+
+  // the two packets due at 100 us, in arrival order
+  const uint32_t head[] = { 2, 4 };
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<const QueueDiscItem> peeked = queue->Peek ();
+      Ptr<QueueDiscItem> item = queue->Dequeue ();
+      NS_TEST_ASSERT_MSG_EQ (peeked, item, "Peek does not show the next packet");
+      NS_TEST_ASSERT_MSG_EQ (item, items[head[i]], "Dequeue " << i << " returned the wrong packet");
+    }
+
+  // a packet arriving later still overtakes the later deadlines
+  items.push_back (DsrTestQueueDiscItem::CreateTagged (1000, 0, 200));
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (items.back ()), true, "Could not enqueue packet 6");
+  const uint32_t tail[] = { 6, 3, 0, 1, 5 };
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      Ptr<const QueueDiscItem> peeked = queue->Peek ();
+      Ptr<QueueDiscItem> item = queue->Dequeue ();
+      NS_TEST_ASSERT_MSG_EQ (peeked, item, "Peek does not show the next packet");
+      NS_TEST_ASSERT_MSG_EQ (item, items[tail[i]], "Dequeue " << i + 2 << " returned the wrong packet");
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue->Peek (), 0, "Peek on an empty queue returned a packet");
+  NS_TEST_ASSERT_MSG_EQ (queue->Dequeue (), 0, "Dequeue on an empty queue returned a packet");
+  NS_TEST_ASSERT_MSG_EQ (queue->IsEmpty (), true, "The queue is not empty");
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief Check a DsrVirtualQueueDisc of five lanes, and the routing over it.
+ *
+ * The lane attributes are parsed into one lane per capacity, and rejected
+ * when they disagree.  The routing must take the capacity and the share of
+ * the budget-aware lanes from the queue disc: the weights of a flagged
+ * lookup over idle lanes follow from them alone, and differ from those of
+ * the fallback on the size of the internal queues and equal shares.
+ */
+class DsrLaneConfigTestCase : public TestCase
+{
+public:
+  DsrLaneConfigTestCase ();
+
+private:
+  virtual void DoRun (void);
+  virtual void DoTeardown (void);
+  /**
+   * \brief Check that a lane configuration is rejected.
+   * \param capacities the "LaneCapacities" attribute
+   * \param shares the "LaneShares" attribute
+   * \param weights the "LaneWeights" attribute
+   * \param edfLane the "EdfLane" attribute
+   * \param what the mistake in the configuration
+   */
+  void CheckRejected (std::string capacities, std::string shares, std::string weights,
+                      int32_t edfLane, std::string what);
+  /**
+   * \brief Look up routes for flagged packets with a large budget.
+   */
+  void SendLookups (void);
+  /**
+   * \brief Sink of the "ForwardingDecision" trace source.
+   * \param decision the decision
+   */
+  void RecordDecision (const DsrForwardingDecision &decision);
+
+  NodeContainer m_nodes;                           //!< the two routers
+  Ipv4Address m_destination;                       //!< the address of n1
+  std::vector<DsrForwardingDecision> m_decisions;  //!< the recorded decisions
+};
+
+DsrLaneConfigTestCase::DsrLaneConfigTestCase ()
+  : TestCase ("DsrVirtualQueueDisc configures N lanes and the routing follows them")
+{
+}
+
+void
+DsrLaneConfigTestCase::CheckRejected (std::string capacities, std::string shares, std::string weights,
+                                      int32_t edfLane, std::string what)
+{
+  Ptr<DsrVirtualQueueDisc> qdisc = CreateObject<DsrVirtualQueueDisc> ();
+  qdisc->SetAttribute ("LaneCapacities", StringValue (capacities));
+  qdisc->SetAttribute ("LaneShares", StringValue (shares));
+  qdisc->SetAttribute ("LaneWeights", StringValue (weights));
+  qdisc->SetAttribute ("EdfLane", IntegerValue (edfLane));
+  // Initialize would abort on the rejected configuration
+  NS_TEST_ASSERT_MSG_EQ (qdisc->CheckConfig (), false, "Accepted " << what);
+}
+
+void
+DsrLaneConfigTestCase::SendLookups (void)
+{
+  Ptr<Ipv4DSRRouting> routing = m_nodes.Get (0)->GetObject<DSRRouter> ()->GetRoutingProtocol ();
+  Ipv4Header header;
+  header.SetDestination (m_destination);
+  for (uint32_t i = 0; i < 400; i++)
+    {
+      Ptr<Packet> p = Create<Packet> (1000);
+      DsrMetaTag tag;
+      tag.SetTimestamp (Simulator::Now ());
+      tag.SetBudget (1000000);
+      tag.SetFlag (true);
+      tag.AddTo (p, false);
+      Socket::SocketErrno sockerr;
+      routing->RouteOutput (p, header, Ptr<NetDevice> (), sockerr);
+    }
+}
+
+void
+DsrLaneConfigTestCase::RecordDecision (const DsrForwardingDecision &decision)
+{
+  m_decisions.push_back (decision);
+}
+
+void
+DsrLaneConfigTestCase::DoRun (void)
+{
+  const uint32_t nLanes = 5;
+  const uint32_t capacities[nLanes] = { 10, 20, 30, 40, 100 };
+  const double shares[nLanes] = { 0.4, 0.2, 0.15, 0.1, 0.15 };
+  const uint32_t weights[nLanes] = { 4, 3, 2, 1, 1 };
+
+  Ptr<DsrVirtualQueueDisc> qdisc = CreateObject<DsrVirtualQueueDisc> ();
+  qdisc->SetAttribute ("LaneCapacities", StringValue ("10 20 30 40 100"));
+  qdisc->SetAttribute ("LaneShares", StringValue ("0.4 0.2 0.15 0.1 0.15"));
+  qdisc->SetAttribute ("LaneWeights", StringValue ("4 3 2 1 1"));
+  qdisc->Initialize ();
+  NS_TEST_ASSERT_MSG_EQ (qdisc->GetNLanes (), nLanes, "Wrong number of lanes");
+  NS_TEST_ASSERT_MSG_EQ (qdisc->GetNInternalQueues (), nLanes, "Wrong number of internal queues");
+  for (uint32_t lane = 0; lane < nLanes; lane++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (qdisc->GetLaneCapacity (lane), capacities[lane], "Wrong capacity of lane " << lane);
+      NS_TEST_ASSERT_MSG_EQ_TOL (qdisc->GetLaneShare (lane), shares[lane], 1e-9, "Wrong share of lane " << lane);
+      for (uint32_t i = 0; i < capacities[0]; i++)
+        {
+          qdisc->Enqueue (DsrTestQueueDiscItem::CreateTagged (1000, lane, 0));
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (qdisc->Enqueue (DsrTestQueueDiscItem::CreateTagged (1000, 0, 0)), false,
+                         "Lane 0 accepted more packets than its capacity");
+  // one WRR round serves its weight of packets from each lane, in lane order
+  for (uint32_t lane = 0; lane < nLanes; lane++)
+    {
+      for (uint32_t i = 0; i < weights[lane]; i++)
+        {
+          Ptr<QueueDiscItem> item = qdisc->Dequeue ();
+          NS_TEST_ASSERT_MSG_NE (item, 0, "A backlogged queue disc returned no packet");
+          DsrMetaTag tag;
+          tag.PeekFrom (item->GetPacket ());
+          NS_TEST_ASSERT_MSG_EQ (tag.GetLane (), lane, "Packet " << i << " of the round came from the wrong lane");
+        }
+    }
+
+  CheckRejected ("10 20 30", "0.5 0.3", "10 3 2", -1, "fewer shares than lanes");
+  CheckRejected ("10 20 30", "0.5 0.3 0.2", "10 3 2 1", -1, "more weights than lanes");
+  CheckRejected ("10 20 30", "0.5 0 0.2", "10 3 2", -1, "a lane without a share");
+  CheckRejected ("10 0 30", "0.5 0.3 0.2", "10 3 2", -1, "a lane without a capacity");
+  CheckRejected ("10 20 30", "0.5 0.4 0.3", "10 3 2", -1, "shares above the link rate");
+  CheckRejected ("100", "1", "1", -1, "a single lane");
+  CheckRejected ("10 twenty 30", "0.5 0.3 0.2", "10 3 2", -1, "a capacity that is not a number");
+  CheckRejected ("10 20 30", "0.5 0.3 0.2", "10 3 2", 3, "an EDF lane past the last lane");
+
+  // two routers over a link with the five lanes
+  m_nodes.Create (2);
+  Ipv4DSRRoutingHelper dsr;
+  Ipv4ListRoutingHelper list;
+  list.Add (dsr, 10);
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (list);
+  internet.Install (m_nodes);
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute ("DataRate", StringValue ("10Mbps"));
+  p2p.SetChannelAttribute ("Delay", StringValue ("1ms"));
+  NetDeviceContainer devices = p2p.Install (m_nodes.Get (0), m_nodes.Get (1));
+  TrafficControlHelper tch;
+  tch.SetRootQueueDisc ("ns3::DsrVirtualQueueDisc",
+                        "LaneCapacities", StringValue ("10 20 30 40 100"),
+                        "LaneShares", StringValue ("0.4 0.2 0.15 0.1 0.15"),
+                        "LaneWeights", StringValue ("4 3 2 1 1"));
+  tch.Install (devices);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+  m_destination = interfaces.GetAddress (1);
+  DSRRouteManager::BuildDSRRoutingDatabase ();
+  DSRRouteManager::InitializeRoutes ();
+
+  Ptr<Ipv4DSRRouting> routing = m_nodes.Get (0)->GetObject<DSRRouter> ()->GetRoutingProtocol ();
+  routing->TraceConnectWithoutContext ("ForwardingDecision",
+                                       MakeCallback (&DsrLaneConfigTestCase::RecordDecision, this));
+  // the queue discs are initialized with the nodes, when the simulation starts
+  Simulator::Schedule (Seconds (1), &DsrLaneConfigTestCase::SendLookups, this);
+  Simulator::Stop (Seconds (2));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_decisions.size (), 400, "Not every lookup was recorded");
+  // a 1000-byte packet takes 0.8 ms at the link rate; over idle lanes the
+  // large budget is clamped to the largest delay bound of a full lane
+  double packetTime = 1000 * 8 * 1000.0 / 10e6;
+  double boundMax = 0;
+  for (uint32_t lane = 0; lane + 1 < nLanes; lane++)
+    {
+      boundMax = std::max (boundMax, capacities[lane] * packetTime / shares[lane]);
+    }
+  std::vector<uint32_t> selected (nLanes, 0);
+  for (uint32_t i = 0; i < m_decisions.size (); i++)
+    {
+      const DsrForwardingDecision &decision = m_decisions[i];
+      NS_TEST_ASSERT_MSG_EQ (static_cast<uint32_t> (decision.dropReason),
+                             static_cast<uint32_t> (DsrForwardingDecision::NOT_DROPPED), "Lookup " << i << " dropped");
+      NS_TEST_ASSERT_MSG_EQ (decision.nCandidates, 1, "The link is the only route");
+      for (uint32_t lane = 0; lane + 1 < nLanes; lane++)
+        {
+          double expected = (boundMax - packetTime / shares[lane]) * 0.1;
+          NS_TEST_ASSERT_MSG_EQ_TOL (decision.candidates[0].weight[lane], expected, 1e-9,
+                                     "The weight of lane " << lane << " does not follow the queue disc");
+        }
+      selected[decision.lane]++;
+    }
+  // the weights are close, so every budget-aware lane takes about a quarter
+  for (uint32_t lane = 0; lane + 1 < nLanes; lane++)
+    {
+      NS_TEST_ASSERT_MSG_GT (selected[lane], m_decisions.size () / 8,
+                             "Lane " << lane << " was selected " << selected[lane] << " times");
+    }
+  NS_TEST_ASSERT_MSG_EQ (selected[nLanes - 1], 0, "A flagged packet was sent to the best-effort lane");
+}
+
+void
+DsrLaneConfigTestCase::DoTeardown (void)
+{
+  DSRRouteManager::DeleteDSRRoutes ();
+  Ipv4DSRRouting::ClearRouterAddresses ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup dsr
+ * \ingroup tests
+ *
+ * \brief DSR routing TestSuite
+ */
+class DsrRoutingTestSuite : public TestSuite
+{
+public:
+  DsrRoutingTestSuite ();
+};
+
+DsrRoutingTestSuite::DsrRoutingTestSuite ()
+  : TestSuite ("dsr-routing", UNIT)
+{
+  AddTestCase (new DsrCandidateQueueOrderTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrRoutingTableTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrSpfGraphTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrSpfThreadsTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrIncrementalUpdateTestCase (false), TestCase::QUICK);
+  AddTestCase (new DsrIncrementalUpdateTestCase (true), TestCase::QUICK);
+  AddTestCase (new DsrRouterRoutesTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrDrrSchedulerTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrExpiredDropTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrSojournTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrEdfQueueTestCase (), TestCase::QUICK);
+  AddTestCase (new DsrLaneConfigTestCase (), TestCase::QUICK);
+}
+
+static DsrRoutingTestSuite g_dsrRoutingTestSuite; //!< Static variable for test initialization